@@ -85,6 +85,26 @@ namespace chiori
 		return { lower, upper };
 	}
 
+	// 1 / translation for RayIntersectsAABB. Axis aligned rays get a huge value instead of infinity, so the slab test never computes 0 * inf
+	inline cVec2 RayInvTranslation(const cVec2& translation)
+	{
+		const float huge = 1e30f;
+		return { translation.x != 0.0f ? 1.0f / translation.x : huge, translation.y != 0.0f ? 1.0f / translation.y : huge };
+	}
+
+	// slab test, true if origin + t * translation is inside the AABB for some t in [0, maxFraction]
+	inline bool RayIntersectsAABB(const cVec2& origin, const cVec2& invTranslation, float maxFraction, const cAABB& aabb)
+	{
+		float t1x = (aabb.min.x - origin.x) * invTranslation.x;
+		float t2x = (aabb.max.x - origin.x) * invTranslation.x;
+		float t1y = (aabb.min.y - origin.y) * invTranslation.y;
+		float t2y = (aabb.max.y - origin.y) * invTranslation.y;
+
+		float tNear = c_max(c_max(c_min(t1x, t2x), c_min(t1y, t2y)), 0.0f);
+		float tFar = c_min(c_min(c_max(t1x, t2x), c_max(t1y, t2y)), maxFraction);
+		return tNear <= tFar;
+	}
+
 	inline cAABB CreateAABB(float hx, float hy)
 	{
 		cVec2 halfExtents = { hx / 2, hy / 2 };
@@ -23,6 +23,12 @@ namespace chiori
 		m_freeList = 0;
 		m_path = 0;
 		m_insertionCount = 0;
+
+		m_aabbMargin = commons::AABB_FATTEN_FACTOR;
+		m_rebuildThreshold = commons::CTREE_REBUILD_THRESHOLD;
+		m_builtAreaRatio = 0.0f;
+		m_insertionsSinceCheck = 0;
+		m_version = 0;
 	}
 
 	cDynamicTree::~cDynamicTree()
@@ -78,17 +84,22 @@ namespace chiori
 	}
 	
 	int cDynamicTree::InsertProxy(const cAABB& aabb, void* userData)
+	{
+		int pID = AllocateProxy(aabb, userData);
+		InsertLeaf(pID);
+		return pID;
+	}
+
+	int cDynamicTree::AllocateProxy(const cAABB& aabb, void* userData)
 	{
 		int pID = AllocateNode();
-		
-		cVec2 fat{ commons::AABB_FATTEN_FACTOR, commons::AABB_FATTEN_FACTOR };
+
+		cVec2 fat{ m_aabbMargin, m_aabbMargin };
 		m_nodes[pID].aabb.min = aabb.min - fat;
 		m_nodes[pID].aabb.max = aabb.max + fat;
 		m_nodes[pID].userData = userData;
 		m_nodes[pID].height = 0;
 
-		InsertLeaf(pID);
-
 		return pID;
 	}
 
@@ -96,7 +107,11 @@ namespace chiori
 	{
 		cassert(0 <= proxyID && proxyID < m_nodeCapacity);
 		cassert(m_nodes[proxyID].IsLeaf());
-		RemoveLeaf(proxyID);
+		// a proxy from AllocateProxy may not have been inserted yet
+		if (m_nodes[proxyID].parent != null_node || proxyID == m_root)
+		{
+			RemoveLeaf(proxyID);
+		}
 		FreeNode(proxyID);
 		return proxyID;
 	}
@@ -106,20 +121,14 @@ namespace chiori
 		cassert(0 <= proxyID && proxyID < m_nodeCapacity);
 
 		cassert(m_nodes[proxyID].IsLeaf());
-		
-		if (m_nodes[proxyID].aabb.contains(aabb))
-		{
-			return false;
-		}
 
-		RemoveLeaf(proxyID);
-		
-		cVec2 fat{ commons::AABB_FATTEN_FACTOR, commons::AABB_FATTEN_FACTOR };
+		// The fat AABB with the margin and the predicted displacement
+		cVec2 fat{ m_aabbMargin, m_aabbMargin };
 		cAABB b = aabb;
 		b.min = b.min - fat;
 		b.max = b.max + fat;
 
-		cVec2 pdisp = disp * 2.0f;
+		cVec2 pdisp = disp * CTREE_DISPLACEMENT_MULTIPLIER;
 
 		if (pdisp.x < 0.0f)
 		{
@@ -139,15 +148,42 @@ namespace chiori
 			b.max.y += pdisp.y;
 		}
 
+		const cAABB& treeAABB = m_nodes[proxyID].aabb;
+		if (treeAABB.contains(aabb))
+		{
+			// The tree AABB still contains the proxy, but it might be much larger than it needs to be,
+			// e.g. a fast proxy that has slowed down. Keep it unless it reaches past the huge AABB
+			cVec2 huge = fat * CTREE_HUGE_MARGIN_MULTIPLIER;
+			cAABB hugeAABB;
+			hugeAABB.min = b.min - huge;
+			hugeAABB.max = b.max + huge;
+			if (hugeAABB.contains(treeAABB))
+			{
+				return false;
+			}
+		}
+
+		// a proxy from AllocateProxy only gets its AABB updated until it is inserted
+		bool inserted = m_nodes[proxyID].parent != null_node || proxyID == m_root;
+		if (inserted)
+		{
+			RemoveLeaf(proxyID);
+		}
+
 		m_nodes[proxyID].aabb = b;
 
-		InsertLeaf(proxyID);
+		if (inserted)
+		{
+			InsertLeaf(proxyID);
+		}
 		return true;
 	}
 
 	void cDynamicTree::InsertLeaf(int leaf)
 	{
 		++m_insertionCount;
+		++m_insertionsSinceCheck;
+		++m_version;
 		
 		if (m_root == null_node)
 		{
@@ -272,6 +308,7 @@ namespace chiori
 
 	void cDynamicTree::RemoveLeaf(int leaf)
 	{
+		++m_version;
 		if (leaf == m_root)
 		{
 			m_root = null_node;
@@ -280,6 +317,7 @@ namespace chiori
 
 		int parent = m_nodes[leaf].parent;
 		int grandParent = m_nodes[parent].parent;
+		m_nodes[leaf].parent = null_node;
 		int sibling;
 		if (m_nodes[parent].child1 == leaf)
 		{
@@ -468,6 +506,315 @@ namespace chiori
 		return iA;
 	}
 
+	#define CTREE_SAH_BINS 16 // centroid bins per split of the SAH build
+
+	int cDynamicTree::PartitionSAH(int* leaves, int count) const
+	{
+		// Split along the longest axis of the leaf centers
+		cVec2 centerMin = m_nodes[leaves[0]].aabb.getCenter();
+		cVec2 centerMax = centerMin;
+		for (int i = 1; i < count; ++i)
+		{
+			cVec2 center = m_nodes[leaves[i]].aabb.getCenter();
+			centerMin = cVec2::vmin(centerMin, center);
+			centerMax = cVec2::vmax(centerMax, center);
+		}
+
+		cVec2 extent = centerMax - centerMin;
+		int axis = (extent.x >= extent.y) ? 0 : 1;
+		float axisMin = axis == 0 ? centerMin.x : centerMin.y;
+		float axisExtent = axis == 0 ? extent.x : extent.y;
+		if (axisExtent <= 0.0f)
+		{
+			// all centers are the same, any split is as good as another
+			return count / 2;
+		}
+
+		float binScale = CTREE_SAH_BINS / axisExtent;
+		auto binIndex = [&](int leaf) -> int
+			{
+				cVec2 center = m_nodes[leaf].aabb.getCenter();
+				int bin = static_cast<int>(((axis == 0 ? center.x : center.y) - axisMin) * binScale);
+				return c_min(bin, CTREE_SAH_BINS - 1);
+			};
+
+		cAABB binAABBs[CTREE_SAH_BINS];
+		int binCounts[CTREE_SAH_BINS] = {};
+		for (int i = 0; i < count; ++i)
+		{
+			int bin = binIndex(leaves[i]);
+			if (binCounts[bin] == 0)
+				binAABBs[bin] = m_nodes[leaves[i]].aabb;
+			else
+				binAABBs[bin].merge(m_nodes[leaves[i]].aabb);
+			binCounts[bin] += 1;
+		}
+
+		// rightCosts[i] is the cost of the bins [i, CTREE_SAH_BINS) as one child
+		float rightCosts[CTREE_SAH_BINS] = {};
+		cAABB right;
+		int rightCount = 0;
+		for (int i = CTREE_SAH_BINS - 1; i > 0; --i)
+		{
+			if (binCounts[i] > 0)
+			{
+				if (rightCount == 0)
+					right = binAABBs[i];
+				else
+					right.merge(binAABBs[i]);
+				rightCount += binCounts[i];
+			}
+			rightCosts[i] = rightCount > 0 ? rightCount * right.perimeter() : 0.0f;
+		}
+
+		// The first and the last bin are never empty, so there is always a split with leaves on both sides
+		cAABB left;
+		int leftCount = 0;
+		int bestBin = 0;
+		float bestCost = FLT_MAX;
+		for (int i = 0; i < CTREE_SAH_BINS - 1; ++i)
+		{
+			if (binCounts[i] > 0)
+			{
+				if (leftCount == 0)
+					left = binAABBs[i];
+				else
+					left.merge(binAABBs[i]);
+				leftCount += binCounts[i];
+			}
+
+			if (leftCount == 0 || leftCount == count)
+				continue;
+
+			float cost = leftCount * left.perimeter() + rightCosts[i + 1];
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestBin = i;
+			}
+		}
+
+		int* split = std::partition(leaves, leaves + count, [&](int leaf) { return binIndex(leaf) <= bestBin; });
+		int splitIndex = static_cast<int>(split - leaves);
+		cassert(0 < splitIndex && splitIndex < count);
+		return splitIndex;
+	}
+
+	int cDynamicTree::BuildSAH(int* leaves, int count)
+	{
+		cassert(count > 0);
+
+		// a range of leaves still to be split, and where its node goes
+		struct BuildRange
+		{
+			int begin;
+			int end;
+			int parent;
+			bool isChild1;
+		};
+
+		BuildRange* stack = new BuildRange[count];
+		int stackCount = 0;
+		int* internalNodes = new int[count];
+		int internalCount = 0;
+
+		int root = null_node;
+		stack[stackCount++] = { 0, count, null_node, true };
+		while (stackCount > 0)
+		{
+			BuildRange range = stack[--stackCount];
+
+			int nodeID;
+			if (range.end - range.begin == 1)
+			{
+				nodeID = leaves[range.begin];
+			}
+			else
+			{
+				int split = range.begin + PartitionSAH(leaves + range.begin, range.end - range.begin);
+				nodeID = AllocateNode();
+				internalNodes[internalCount++] = nodeID;
+				stack[stackCount++] = { split, range.end, nodeID, false };
+				stack[stackCount++] = { range.begin, split, nodeID, true };
+			}
+
+			m_nodes[nodeID].parent = range.parent;
+			if (range.parent == null_node)
+				root = nodeID;
+			else if (range.isChild1)
+				m_nodes[range.parent].child1 = nodeID;
+			else
+				m_nodes[range.parent].child2 = nodeID;
+		}
+
+		// Parents were allocated before their children, so fix the AABBs and heights in reverse
+		for (int i = internalCount - 1; i >= 0; --i)
+		{
+			cTreeNode* node = m_nodes + internalNodes[i];
+			const cTreeNode* child1 = m_nodes + node->child1;
+			const cTreeNode* child2 = m_nodes + node->child2;
+			node->aabb.merge(child1->aabb, child2->aabb);
+			node->height = 1 + c_max(child1->height, child2->height);
+		}
+
+		delete[] internalNodes;
+		delete[] stack;
+		return root;
+	}
+
+	void cDynamicTree::InsertProxies(const int* proxyIDs, int count)
+	{
+		if (count <= 0)
+			return;
+
+		int* leaves = new int[count];
+		memcpy(leaves, proxyIDs, count * sizeof(int));
+		bool wasEmpty = (m_root == null_node);
+
+		int subtree = BuildSAH(leaves, count);
+		delete[] leaves;
+
+		if (wasEmpty)
+		{
+			++m_version;
+			m_root = subtree;
+			m_builtAreaRatio = GetAreaRatio();
+			m_insertionsSinceCheck = 0;
+		}
+		else
+		{
+			InsertLeaf(subtree);
+		}
+	}
+
+	void cDynamicTree::RebuildProxies(const int* proxyIDs, int count)
+	{
+		for (int i = 0; i < count; ++i)
+		{
+			cassert(m_nodes[proxyIDs[i]].IsLeaf());
+			RemoveLeaf(proxyIDs[i]);
+		}
+		InsertProxies(proxyIDs, count);
+	}
+
+	void cDynamicTree::Rebuild()
+	{
+		if (m_root == null_node)
+			return;
+
+		// Gather the leaves in the tree and free the internal nodes. Proxies that were
+		// allocated but not inserted have no parent, they stay out of the tree
+		int* leaves = new int[m_nodeCount];
+		int leafCount = 0;
+		for (int i = 0; i < m_nodeCapacity; ++i)
+		{
+			const cTreeNode* node = m_nodes + i;
+			if (node->height < 0)
+				continue; // Free node in pool
+
+			if (node->IsLeaf())
+			{
+				if (node->parent != null_node || i == m_root)
+					leaves[leafCount++] = i;
+			}
+			else
+			{
+				FreeNode(i);
+			}
+		}
+
+		m_root = null_node;
+		InsertProxies(leaves, leafCount);
+		delete[] leaves;
+	}
+
+	void cDynamicTree::Compact(int* remap)
+	{
+		for (int i = 0; i < m_nodeCapacity; ++i)
+			remap[i] = null_node;
+
+		// Number the tree depth first, child1 before child2
+		int nodeCount = 0;
+		if (m_root != null_node)
+		{
+			cTreeStack<CTREE_STACK_SIZE> stack;
+			stack.push(m_root);
+			while (!stack.empty())
+			{
+				int nodeID = stack.pop();
+				remap[nodeID] = nodeCount++;
+				if (!m_nodes[nodeID].IsLeaf())
+				{
+					stack.push(m_nodes[nodeID].child2);
+					stack.push(m_nodes[nodeID].child1);
+				}
+			}
+		}
+
+		// proxies from AllocateProxy that are not inserted yet go after the tree
+		for (int i = 0; i < m_nodeCapacity; ++i)
+		{
+			if (m_nodes[i].height >= 0 && remap[i] == null_node)
+				remap[i] = nodeCount++;
+		}
+		cassert(nodeCount == m_nodeCount);
+
+		int capacity = commons::CTREE_START_CAPACITY;
+		while (capacity < m_nodeCount)
+			capacity *= 2;
+
+		cTreeNode* nodes = new cTreeNode[capacity]();
+		for (int i = 0; i < m_nodeCapacity; ++i)
+		{
+			if (remap[i] == null_node)
+				continue;
+
+			cTreeNode& node = nodes[remap[i]];
+			node = m_nodes[i];
+			if (node.parent != null_node)
+				node.parent = remap[node.parent];
+			if (!node.IsLeaf())
+			{
+				node.child1 = remap[node.child1];
+				node.child2 = remap[node.child2];
+			}
+		}
+
+		// Set the free list (next points to the next free node)
+		for (int i = m_nodeCount; i < capacity; ++i)
+		{
+			nodes[i].next = i + 1 < capacity ? i + 1 : null_node;
+			nodes[i].height = -1;
+		}
+
+		delete[] m_nodes;
+		m_nodes = nodes;
+		m_nodeCapacity = capacity;
+		m_freeList = m_nodeCount < capacity ? m_nodeCount : null_node;
+		if (m_root != null_node)
+			m_root = remap[m_root];
+		++m_version;
+	}
+
+	bool cDynamicTree::RebuildIfDegraded()
+	{
+		if (m_rebuildThreshold <= 0.0f || m_root == null_node)
+			return false;
+
+		// measuring the tree walks all nodes, only do it once a good part of the leaves moved
+		int leafCount = (m_nodeCount + 1) / 2;
+		if (m_insertionsSinceCheck < c_max(32, leafCount / 4))
+			return false;
+		m_insertionsSinceCheck = 0;
+
+		// a tree that was never built always gets a first build, which sets the reference ratio
+		if (m_builtAreaRatio > 0.0f && GetAreaRatio() <= m_rebuildThreshold * m_builtAreaRatio)
+			return false;
+
+		Rebuild();
+		return true;
+	}
+
 	int cDynamicTree::GetHeight() const
 	{
 		if (m_root == null_node)
@@ -548,6 +895,7 @@ namespace chiori
 
 	void cDynamicTree::ShiftOrigin(const cVec2& newOrigin)
 	{
+		++m_version;
 		// Build array of leaves. Free the rest.
 		for (int i = 0; i < m_nodeCapacity; ++i)
 		{
@@ -563,13 +911,12 @@ namespace chiori
 			return;
 		}
 
-		std::stack<int> nodeStack;
+		cTreeStack<CTREE_STACK_SIZE> nodeStack;
 		nodeStack.push(m_root);
 
 		while (!nodeStack.empty())
 		{
-			int nodeId = nodeStack.top();
-			nodeStack.pop();
+			int nodeId = nodeStack.pop();
 
 			const cTreeNode& node = m_nodes[nodeId];
 
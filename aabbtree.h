@@ -1,12 +1,77 @@
 #pragma once
 
 #include "aabb.h"
-#include <stack>
+#include "geom.h"
+#include "chioriSIMD.h"
 
 namespace chiori
 {
 	static constexpr int null_node = -1;
 	using QueryCallback = std::function<bool(unsigned int)>; //bool (*)(unsigned int);
+
+	#define CTREE_STACK_SIZE 256 // nodes a tree traversal keeps on the call stack, deeper traversals move the stack to the heap
+	#define CTREE_DISPLACEMENT_MULTIPLIER 2.0f // MoveProxy extends the fat AABB by this many predicted displacements
+	#define CTREE_HUGE_MARGIN_MULTIPLIER 4.0f // a fat AABB larger than the new fat AABB plus this many margins is shrunk by MoveProxy
+	#define CTREE_RAY_PACKET_SIZE 32 // rays traversed together by RayCastPacket, one bit each in a 32 bit mask
+
+	// The traversal stack of a tree query. It lives on the call stack and only allocates
+	// if the traversal needs more than N entries, which only happens for badly unbalanced trees
+	template <int N>
+	class cTreeStack
+	{
+	public:
+		cTreeStack() : m_data{ m_fixed }, m_count{ 0 }, m_capacity{ N } {}
+		~cTreeStack()
+		{
+			if (m_data != m_fixed)
+				delete[] m_data;
+		}
+
+		cTreeStack(const cTreeStack&) = delete;
+		cTreeStack& operator=(const cTreeStack&) = delete;
+
+		void push(int inNode)
+		{
+			if (m_count == m_capacity)
+			{
+				int* oldData = m_data;
+				m_capacity *= 2;
+				m_data = new int[m_capacity];
+				memcpy(m_data, oldData, m_count * sizeof(int));
+				if (oldData != m_fixed)
+					delete[] oldData;
+			}
+			m_data[m_count++] = inNode;
+		}
+
+		int pop() { return m_data[--m_count]; }
+		bool empty() const { return m_count == 0; }
+
+	private:
+		int m_fixed[N];
+		int* m_data;
+		int m_count;
+		int m_capacity;
+	};
+
+	// grows buffer to at least requiredCapacity, keeping the first count items. Used by the broadphase structures for their arrays
+	template <typename T>
+	inline void GrowBuffer(T*& buffer, int& capacity, int count, int requiredCapacity)
+	{
+		if (requiredCapacity <= capacity)
+			return;
+
+		int newCapacity = c_max(16, capacity);
+		while (newCapacity < requiredCapacity)
+			newCapacity *= 2;
+
+		T* oldBuffer = buffer;
+		buffer = new T[newCapacity];
+		if (count > 0)
+			std::copy(oldBuffer, oldBuffer + count, buffer);
+		delete[] oldBuffer;
+		capacity = newCapacity;
+	}
 	
 	struct cTreeNode
 	{
@@ -35,13 +100,66 @@ namespace chiori
 		
 		int InsertProxy(const cAABB& inAABB, void* inUserData);
 		int DestroyProxy(int inProxyID);
+		// Reinserts the proxy if inAABB left its fat AABB, or if the fat AABB has become much larger than needed.
+		// The new fat AABB is extended in the direction of inDisplacement, pass the expected movement over the next step.
+		// Returns true if the proxy was reinserted
 		bool MoveProxy(int inProxyID, const cAABB& inAABB, const cVec2& inDisplacement);
 
+		// The margin added around the proxy AABBs, defaults to commons::AABB_FATTEN_FACTOR.
+		// Proxies get the new margin the next time they are created or reinserted
+		void SetAABBMargin(float inMargin) { m_aabbMargin = inMargin; }
+		float GetAABBMargin() const { return m_aabbMargin; }
+
+		// Bulk insertion: AllocateProxy creates a proxy that is not in the tree yet, queries do not find it
+		// until InsertProxies adds a batch of them at once as a binned SAH subtree
+		int AllocateProxy(const cAABB& inAABB, void* inUserData);
+		void InsertProxies(const int* inProxyIDs, int inCount);
+
+		// Rebuilds the whole tree top down with a binned SAH build. Proxy ids and AABBs do not change
+		void Rebuild();
+		// Takes the given proxies out of the tree and inserts them back as a binned SAH subtree
+		void RebuildProxies(const int* inProxyIDs, int inCount);
+		// Rebuilds the tree if GetAreaRatio has grown past the rebuild threshold times its value after the last rebuild.
+		// The ratio is only measured once enough proxies have been inserted or moved since the last check. Returns true if the tree was rebuilt
+		bool RebuildIfDegraded();
+		void SetRebuildThreshold(float inThreshold) { m_rebuildThreshold = inThreshold; } // 0 disables RebuildIfDegraded
+		float GetRebuildThreshold() const { return m_rebuildThreshold; }
+		// Renumbers the nodes in depth first order, so that traversals walk m_nodes forward instead of jumping around it,
+		// and shrinks the node array to the nodes in use. The proxy ids change: outRemap needs GetProxyCapacity() entries,
+		// on return outRemap[oldID] is the new id of every node, null_node for the free ones
+		void Compact(int* outRemap);
+
 		void* GetUserData(int inProxyID) const;
 		
 		const cAABB& GetFattenedAABB(int inProxyID) const;
 
-		void Query(const cAABB& inAABB, QueryCallback callback) const;
+		int GetProxyCapacity() const { return m_nodeCapacity; } // every proxy id is below this
+
+		// calls callback(proxyID) for every proxy whose fat AABB overlaps inAABB, the query stops when the callback returns false.
+		// Any callable taking the proxy id works, it is called directly and nothing is allocated
+		template <typename T>
+		void Query(const cAABB& inAABB, T&& callback) const;
+
+		// Casts a ray through the tree, calls callback(const cRayCastInput& input, int proxyID) for every proxy whose fat AABB the ray
+		// hits, input.maxFraction is the ray's current max fraction. The callback returns the new max fraction of the ray:
+		// 0 stops the cast, a value in (0, input.maxFraction) clips the ray, anything else (e.g. -1) continues unchanged
+		template <typename T>
+		void RayCast(const cRayCastInput& inInput, T&& callback) const;
+
+		// Sweeps inAABB along inInput.translation, inInput.origin is ignored. Calls callback(const cRayCastInput& input, int proxyID)
+		// for every proxy whose fat AABB the swept box touches, input is the ray of the box center. Returns work like RayCast
+		template <typename T>
+		void BoxCast(const cAABB& inAABB, const cRayCastInput& inInput, T&& callback) const;
+
+		// Casts up to CTREE_RAY_PACKET_SIZE rays with one traversal, every node is visited once for all the rays that hit it and
+		// tested against them SIMD_WIDTH rays at a time. Coherent rays (a burst of rays from one point) share most of their nodes.
+		// Calls callback(const cRayCastInput& input, int rayIndex, int proxyID) with the same return values as RayCast
+		template <typename T>
+		void RayCastPacket(const cRayCastInput* inInputs, int inCount, T&& callback) const;
+
+		int GetRoot() const { return m_root; }
+		unsigned GetVersion() const { return m_version; } // changes whenever a proxy is inserted, removed or shifted, see cWideTree
+		const cTreeNode& GetNode(int inNodeID) const { return m_nodes[inNodeID]; } // no range check, for custom traversals
 
 		int GetHeight() const;
 		int GetMaxBalance() const;
@@ -61,9 +179,17 @@ namespace chiori
 
 		int Balance(int index);
 
+		// builds a subtree over the detached leaves and returns its root, reorders inLeaves
+		int BuildSAH(int* inLeaves, int inCount);
+		int PartitionSAH(int* inLeaves, int inCount) const;
+
 		int ComputeHeight() const;
 		int ComputeHeight(int nodeId) const;
 
+		// RayCast and BoxCast, the node AABBs are grown by inExtents before the ray test
+		template <typename T>
+		void CastAABB(const cRayCastInput& inInput, const cVec2& inExtents, T&& callback) const;
+
 		int m_root;
 		cTreeNode* m_nodes;
 		int m_nodeCount;
@@ -72,6 +198,12 @@ namespace chiori
 		/// This is used to incrementally traverse the tree for re-balancing.
 		unsigned m_path;
 		int m_insertionCount;
+
+		float m_aabbMargin;
+		float m_rebuildThreshold;
+		float m_builtAreaRatio;			// GetAreaRatio right after the last full build, 0 if the tree was never built
+		int m_insertionsSinceCheck;		// leaf insertions since RebuildIfDegraded last measured the tree
+		unsigned m_version;
 	};
 
 	inline void* cDynamicTree::GetUserData(int proxyId) const
@@ -92,15 +224,15 @@ namespace chiori
 		throw std::out_of_range("Index out of range for tree");
 	}
 
-	inline void cDynamicTree::Query(const cAABB& inAABB, QueryCallback callback) const
+	template <typename T>
+	inline void cDynamicTree::Query(const cAABB& inAABB, T&& callback) const
 	{
-		std::stack<int> stack;
+		cTreeStack<CTREE_STACK_SIZE> stack;
 		stack.push(m_root);
 
-		while (stack.size() > 0)
+		while (!stack.empty())
 		{
-			int nodeID = stack.top();
-			stack.pop();
+			int nodeID = stack.pop();
 			if (nodeID == null_node)
 				continue;
 
@@ -122,4 +254,154 @@ namespace chiori
 
 		}
 	}
+
+	template <typename T>
+	inline void cDynamicTree::RayCast(const cRayCastInput& inInput, T&& callback) const
+	{
+		CastAABB(inInput, cVec2::zero, callback);
+	}
+
+	template <typename T>
+	inline void cDynamicTree::BoxCast(const cAABB& inAABB, const cRayCastInput& inInput, T&& callback) const
+	{
+		cRayCastInput centerInput = inInput;
+		centerInput.origin = inAABB.getCenter();
+		CastAABB(centerInput, inAABB.getExtents(), callback);
+	}
+
+	template <typename T>
+	inline void cDynamicTree::CastAABB(const cRayCastInput& inInput, const cVec2& inExtents, T&& callback) const
+	{
+		cRayCastInput subInput = inInput;
+		cVec2 invTranslation = RayInvTranslation(inInput.translation);
+
+		cTreeStack<CTREE_STACK_SIZE> stack;
+		stack.push(m_root);
+
+		while (!stack.empty())
+		{
+			int nodeID = stack.pop();
+			if (nodeID == null_node)
+				continue;
+
+			const cTreeNode* node = m_nodes + nodeID;
+			cAABB nodeAABB{ node->aabb.min - inExtents, node->aabb.max + inExtents };
+			if (!RayIntersectsAABB(subInput.origin, invTranslation, subInput.maxFraction, nodeAABB))
+				continue;
+
+			if (node->IsLeaf())
+			{
+				float value = callback(static_cast<const cRayCastInput&>(subInput), nodeID);
+				if (value == 0.0f)
+					return; // the client has terminated the ray cast
+
+				if (0.0f < value && value < subInput.maxFraction)
+					subInput.maxFraction = value; // the client found a closer hit, skip everything past it
+			}
+			else
+			{
+				stack.push(node->child1);
+				stack.push(node->child2);
+			}
+		}
+	}
+
+	template <typename T>
+	inline void cDynamicTree::RayCastPacket(const cRayCastInput* inInputs, int inCount, T&& callback) const
+	{
+		cassert(0 <= inCount && inCount <= CTREE_RAY_PACKET_SIZE);
+		static_assert(CTREE_RAY_PACKET_SIZE % SIMD_WIDTH == 0, "the ray packet must be a multiple of the SIMD width");
+
+		// the packet in SoA form, unused lanes get a negative max fraction so that they never hit anything
+		struct alignas(SIMD_ALIGNMENT) RayPacket
+		{
+			float originX[CTREE_RAY_PACKET_SIZE];
+			float originY[CTREE_RAY_PACKET_SIZE];
+			float invX[CTREE_RAY_PACKET_SIZE];
+			float invY[CTREE_RAY_PACKET_SIZE];
+			float maxFraction[CTREE_RAY_PACKET_SIZE];
+		} packet;
+
+		for (int i = 0; i < CTREE_RAY_PACKET_SIZE; ++i)
+		{
+			if (i < inCount)
+			{
+				cVec2 invTranslation = RayInvTranslation(inInputs[i].translation);
+				packet.originX[i] = inInputs[i].origin.x;
+				packet.originY[i] = inInputs[i].origin.y;
+				packet.invX[i] = invTranslation.x;
+				packet.invY[i] = invTranslation.y;
+				packet.maxFraction[i] = inInputs[i].maxFraction;
+			}
+			else
+			{
+				packet.originX[i] = packet.originY[i] = packet.invX[i] = packet.invY[i] = 0.0f;
+				packet.maxFraction[i] = -1.0f;
+			}
+		}
+
+		const unsigned laneBits = (1u << SIMD_WIDTH) - 1u;
+		unsigned activeRays = inCount == CTREE_RAY_PACKET_SIZE ? ~0u : (1u << inCount) - 1u;
+
+		// every entry is a node and the rays that hit its parent
+		cTreeStack<2 * CTREE_STACK_SIZE> stack;
+		stack.push(static_cast<int>(activeRays));
+		stack.push(m_root);
+
+		while (!stack.empty())
+		{
+			int nodeID = stack.pop();
+			unsigned rays = static_cast<unsigned>(stack.pop());
+			if (nodeID == null_node)
+				continue;
+
+			const cTreeNode* node = m_nodes + nodeID;
+			cFloatW minX = wSplat(node->aabb.min.x), minY = wSplat(node->aabb.min.y);
+			cFloatW maxX = wSplat(node->aabb.max.x), maxY = wSplat(node->aabb.max.y);
+			cFloatW zero = wZero();
+
+			unsigned hits = 0;
+			for (int first = 0; first < CTREE_RAY_PACKET_SIZE; first += SIMD_WIDTH)
+			{
+				if (((rays >> first) & laneBits) == 0)
+					continue;
+
+				cFloatW originX = wLoad(packet.originX + first), originY = wLoad(packet.originY + first);
+				cFloatW invX = wLoad(packet.invX + first), invY = wLoad(packet.invY + first);
+				cFloatW t1x = (minX - originX) * invX, t2x = (maxX - originX) * invX;
+				cFloatW t1y = (minY - originY) * invY, t2y = (maxY - originY) * invY;
+				cFloatW tNear = wMax(wMax(wMin(t1x, t2x), wMin(t1y, t2y)), zero);
+				cFloatW tFar = wMin(wMin(wMax(t1x, t2x), wMax(t1y, t2y)), wLoad(packet.maxFraction + first));
+				unsigned misses = static_cast<unsigned>(wMoveMask(wGreater(tNear, tFar)));
+				hits |= (~misses & laneBits) << first;
+			}
+			hits &= rays;
+			if (hits == 0)
+				continue;
+
+			if (node->IsLeaf())
+			{
+				for (int i = 0; i < inCount; ++i)
+				{
+					if ((hits & (1u << i)) == 0)
+						continue;
+
+					cRayCastInput subInput = inInputs[i];
+					subInput.maxFraction = packet.maxFraction[i];
+					float value = callback(static_cast<const cRayCastInput&>(subInput), i, nodeID);
+					if (value == 0.0f)
+						packet.maxFraction[i] = -1.0f; // the client has terminated this ray
+					else if (0.0f < value && value < packet.maxFraction[i])
+						packet.maxFraction[i] = value;
+				}
+			}
+			else
+			{
+				stack.push(static_cast<int>(hits));
+				stack.push(node->child1);
+				stack.push(static_cast<int>(hits));
+				stack.push(node->child2);
+			}
+		}
+	}
 }
\ No newline at end of file
@@ -0,0 +1,395 @@
+// Headless benchmark runner
+// Loads one of the built-in scenes (see scenes.h) or a .phys file into a cFractureWorld,
+// runs f_step for a fixed number of steps as fast as possible and reports timings
+// and body/contact counts. It does not need CProcessing or a window.
+//
+// Build (from the repository root):
+//   g++ -std=c++17 -O2 -pthread -I. bench/*.cpp aabbtree.cpp broadphase.cpp chioriTasks.cpp contact.cpp
+//       fracture.cpp fractureWorld.cpp geom.cpp gjk.cpp island.cpp manifold.cpp physicsWorld.cpp scenes.cpp
+//       solver.cpp solverWide.cpp sweepAndPrune.cpp hashGrid.cpp voronoi.cpp wideTree.cpp -o chioriBench
+//   add -mavx2 to run the wide solver 8 lanes at a time instead of 4 (and collapse the wide trees into 8 wide nodes)
+//
+// Usage:
+//   chioriBench [--scene <name> | --file <scene.phys> [--vdf <folder>]] [--steps N] [--warmup N]
+//               [--dt seconds] [--iterations primary secondary] [--basic | --wide] [--no-warmstart] [--no-sleep]
+//               [--threads N] [--margin M] [--broadphase tree|sap|grid] [--wide-tree] [--csv <path>] [--profile] [--list]
+//
+// --profile prints the mean per phase breakdown from cStepProfile and the breakdown of the slowest step,
+// the CSV always contains the per phase columns. Both need the library built with CHIORI_PROFILE enabled.
+#include "pch.h"
+#include "fractureWorld.h"
+#include "scenes.h"
+#include "parser.hpp"
+#include <chrono>
+
+using namespace chiori;
+
+struct BenchSettings
+{
+	std::string sceneName{ "StackScene" };
+	std::string scenePath;		// a .phys file, overrides sceneName when set
+	std::string vdfFolder;		// where the .phys VDF list is looked up, defaults to the scene's folder
+	std::string csvPath;		// optional per step dump
+	int steps{ 1000 };
+	int warmupSteps{ 0 };		// steps run before measuring, not included in any stats
+	float dt{ 0.0167f };
+	int primaryIterations{ 4 };
+	int secondaryIterations{ 2 };
+	bool runBasicSolver{ false };
+	bool runWideSolver{ false };
+	bool warmStart{ true };
+	bool enableSleep{ true };
+	bool printProfile{ false };
+	int threads{ 1 };			// workers of the world's task system, including the main thread. 1 runs the step serially, 0 uses all hardware threads
+	float aabbMargin{ commons::AABB_FATTEN_FACTOR };	// broadphase fat AABB margin
+	cBroadphaseType broadphaseType{ TREE_BROADPHASE };	// what holds the dynamic proxies, see cPhysicsWorld::SetBroadphaseType
+	bool wideTreeQueries{ false };	// see cPhysicsWorld::SetWideTreeQueries
+};
+
+struct StepSample
+{
+	double time;	// microseconds
+	int bodies;
+	int contacts;
+	int touching;	// contacts with at least one manifold point
+	cStepProfile profile;
+};
+
+static void PrintUsage()
+{
+	std::cout <<
+		"usage: chioriBench [--scene <name> | --file <scene.phys> [--vdf <folder>]] [--steps N] [--warmup N]\n"
+		"                   [--dt seconds] [--iterations primary secondary] [--basic | --wide] [--no-warmstart] [--no-sleep]\n"
+		"                   [--threads N] [--margin M] [--broadphase tree|sap|grid] [--wide-tree] [--csv <path>] [--profile] [--list]\n";
+}
+
+static void PrintScenes()
+{
+	std::cout << "available scenes:\n";
+	for (const SceneEntry& entry : GetSceneEntries())
+		std::cout << "  " << entry.name << "\n";
+}
+
+// returns false if the arguments are invalid or the program should exit
+static bool ParseArgs(int argc, char** argv, BenchSettings& settings)
+{
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		bool hasNext = i + 1 < argc;
+		if (arg == "--scene" && hasNext) settings.sceneName = argv[++i];
+		else if (arg == "--file" && hasNext) settings.scenePath = argv[++i];
+		else if (arg == "--vdf" && hasNext) settings.vdfFolder = argv[++i];
+		else if (arg == "--csv" && hasNext) settings.csvPath = argv[++i];
+		else if (arg == "--steps" && hasNext) settings.steps = std::stoi(argv[++i]);
+		else if (arg == "--warmup" && hasNext) settings.warmupSteps = std::stoi(argv[++i]);
+		else if (arg == "--threads" && hasNext) settings.threads = std::stoi(argv[++i]);
+		else if (arg == "--dt" && hasNext) settings.dt = std::stof(argv[++i]);
+		else if (arg == "--margin" && hasNext) settings.aabbMargin = std::stof(argv[++i]);
+		else if (arg == "--broadphase" && hasNext)
+		{
+			std::string type = argv[++i];
+			if (type == "tree") settings.broadphaseType = TREE_BROADPHASE;
+			else if (type == "sap") settings.broadphaseType = SAP_BROADPHASE;
+			else if (type == "grid") settings.broadphaseType = GRID_BROADPHASE;
+			else
+			{
+				std::cerr << "unknown broadphase: " << type << "\n";
+				PrintUsage();
+				return false;
+			}
+		}
+		else if (arg == "--iterations" && i + 2 < argc)
+		{
+			settings.primaryIterations = std::stoi(argv[++i]);
+			settings.secondaryIterations = std::stoi(argv[++i]);
+		}
+		else if (arg == "--basic") settings.runBasicSolver = true;
+		else if (arg == "--wide") settings.runWideSolver = true;
+		else if (arg == "--wide-tree") settings.wideTreeQueries = true;
+		else if (arg == "--no-warmstart") settings.warmStart = false;
+		else if (arg == "--no-sleep") settings.enableSleep = false;
+		else if (arg == "--profile") settings.printProfile = true;
+		else if (arg == "--list")
+		{
+			PrintScenes();
+			return false;
+		}
+		else
+		{
+			std::cerr << "unknown or incomplete argument: " << arg << "\n";
+			PrintUsage();
+			return false;
+		}
+	}
+
+	if (settings.steps <= 0)
+	{
+		std::cerr << "--steps must be greater than 0\n";
+		return false;
+	}
+	return true;
+}
+
+static bool LoadScene(cFractureWorld& world, const BenchSettings& settings)
+{
+	if (!settings.scenePath.empty())
+	{
+		std::string vdfFolder = settings.vdfFolder;
+		if (vdfFolder.empty())
+			vdfFolder = fs::absolute(settings.scenePath).parent_path().string();
+
+		SceneParser parser(&world);
+		parser.loadFromPath(settings.scenePath, vdfFolder);
+		return true;
+	}
+
+	SceneBuilder build = FindSceneBuilder(settings.sceneName.c_str());
+	if (!build)
+	{
+		std::cerr << "unknown scene: " << settings.sceneName << "\n";
+		PrintScenes();
+		return false;
+	}
+	build(&world);
+	return true;
+}
+
+static int CountTouchingContacts(cPhysicsWorld& world)
+{
+	int touching = 0;
+	for (const cContact* contact : world.p_contacts)
+	{
+		if (contact->manifold.pointCount > 0)
+			++touching;
+	}
+	return touching;
+}
+
+static void AddProfile(cStepProfile& sum, const cStepProfile& p)
+{
+	sum.step += p.step;
+	sum.updateTransforms += p.updateTransforms;
+	sum.updatePairs += p.updatePairs;
+	sum.updateContacts += p.updateContacts;
+	sum.solve += p.solve;
+	sum.continuous += p.continuous;
+	sum.updateSleep += p.updateSleep;
+	sum.prepareConstraints += p.prepareConstraints;
+	sum.integrateVelocities += p.integrateVelocities;
+	sum.prepareContacts += p.prepareContacts;
+	sum.warmStart += p.warmStart;
+	sum.integratePositions += p.integratePositions;
+	sum.storeImpulses += p.storeImpulses;
+	for (int i = 0; i < p.solverPassCount; ++i)
+		sum.solverPasses[i] += p.solverPasses[i];
+	sum.solverPassCount = c_max(sum.solverPassCount, p.solverPassCount);
+	sum.fractureStep += p.fractureStep;
+	sum.fractureDetect += p.fractureDetect;
+	sum.fractureClip += p.fractureClip;
+	sum.fractureCreate += p.fractureCreate;
+	sum.fractureRemove += p.fractureRemove;
+	sum.awakeProxies += p.awakeProxies;
+	sum.movedProxies += p.movedProxies;
+	sum.treeRebuilds += p.treeRebuilds;
+	sum.pairsGenerated += p.pairsGenerated;
+	sum.pairsFiltered += p.pairsFiltered;
+	sum.contactsCreated += p.contactsCreated;
+	sum.contactsDestroyed += p.contactsDestroyed;
+	sum.gjkCalls += p.gjkCalls;
+	sum.gjkIterations += p.gjkIterations;
+	sum.awakeIslands += p.awakeIslands;
+	sum.awakeActors += p.awakeActors;
+	sum.continuousActors += p.continuousActors;
+	sum.continuousHits += p.continuousHits;
+	sum.solverColors += p.solverColors;
+	sum.overflowConstraints += p.overflowConstraints;
+	sum.fracturedActors += p.fracturedActors;
+	sum.fragmentsSpawned += p.fragmentsSpawned;
+}
+
+// prints the profile scaled by 1/divisor, times are printed in microseconds
+static void PrintProfile(const cStepProfile& p, double divisor)
+{
+	auto us = [divisor](float ms) { return ms * 1000.0 / divisor; };
+	auto count = [divisor](int n) { return n / divisor; };
+
+	std::cout << "  f_step                 " << us(p.fractureStep) << "\n";
+	std::cout << "    step                 " << us(p.step) << "\n";
+	std::cout << "      transforms/aabbs   " << us(p.updateTransforms) << "\n";
+	std::cout << "      update pairs       " << us(p.updatePairs) << "\n";
+	std::cout << "      update contacts    " << us(p.updateContacts) << "\n";
+	std::cout << "      solve              " << us(p.solve) << "\n";
+	std::cout << "        prepare          " << us(p.prepareConstraints) << "\n";
+	std::cout << "        integrate vel    " << us(p.integrateVelocities) << "\n";
+	std::cout << "        prepare contacts " << us(p.prepareContacts) << "\n";
+	std::cout << "        warm start       " << us(p.warmStart) << "\n";
+	for (int i = 0; i < p.solverPassCount; ++i)
+		std::cout << "        pass " << std::setw(2) << i << "          " << us(p.solverPasses[i]) << "\n";
+	std::cout << "        integrate pos    " << us(p.integratePositions) << "\n";
+	std::cout << "        store impulses   " << us(p.storeImpulses) << "\n";
+	std::cout << "      continuous         " << us(p.continuous) << "\n";
+	std::cout << "      update sleep       " << us(p.updateSleep) << "\n";
+	std::cout << "    fracture detect      " << us(p.fractureDetect) << "\n";
+	std::cout << "    fracture clip        " << us(p.fractureClip) << "\n";
+	std::cout << "    fracture create      " << us(p.fractureCreate) << "\n";
+	std::cout << "    fracture remove      " << us(p.fractureRemove) << "\n";
+	std::cout << "  awake proxies          " << count(p.awakeProxies) << "\n";
+	std::cout << "  moved proxies          " << count(p.movedProxies) << "\n";
+	std::cout << "  tree rebuilds          " << count(p.treeRebuilds) << "\n";
+	std::cout << "  pairs generated        " << count(p.pairsGenerated) << "\n";
+	std::cout << "  pairs filtered         " << count(p.pairsFiltered) << "\n";
+	std::cout << "  contacts created       " << count(p.contactsCreated) << "\n";
+	std::cout << "  contacts destroyed     " << count(p.contactsDestroyed) << "\n";
+	std::cout << "  gjk calls              " << count(p.gjkCalls) << "\n";
+	std::cout << "  gjk iterations         " << count(p.gjkIterations) << "\n";
+	std::cout << "  awake islands          " << count(p.awakeIslands) << "\n";
+	std::cout << "  awake actors           " << count(p.awakeActors) << "\n";
+	std::cout << "  continuous actors      " << count(p.continuousActors) << "\n";
+	std::cout << "  continuous hits        " << count(p.continuousHits) << "\n";
+	std::cout << "  solver colors          " << count(p.solverColors) << "\n";
+	std::cout << "  overflow constraints   " << count(p.overflowConstraints) << "\n";
+	std::cout << "  fractured actors       " << count(p.fracturedActors) << "\n";
+	std::cout << "  fragments spawned      " << count(p.fragmentsSpawned) << "\n";
+}
+
+static const char* BroadphaseName(cBroadphaseType type)
+{
+	switch (type)
+	{
+	case SAP_BROADPHASE: return "sweep and prune";
+	case GRID_BROADPHASE: return "hash grid";
+	default: return "dynamic tree";
+	}
+}
+
+// nearest rank percentile of an already sorted array
+static double Percentile(const std::vector<double>& sorted, double q)
+{
+	size_t rank = static_cast<size_t>(q * (sorted.size() - 1) + 0.5);
+	return sorted[c_min(rank, sorted.size() - 1)];
+}
+
+int main(int argc, char** argv)
+{
+	BenchSettings settings;
+	if (!ParseArgs(argc, argv, settings))
+		return 1;
+
+	cFractureWorld world;
+	world.runBasicSolver = settings.runBasicSolver;
+	world.runWideSolver = settings.runWideSolver;
+	world.enableSleep = settings.enableSleep;
+	world.SetAABBMargin(settings.aabbMargin);
+	world.SetBroadphaseType(settings.broadphaseType);
+	world.SetWideTreeQueries(settings.wideTreeQueries);
+	std::unique_ptr<cThreadPool> threadPool;
+	if (settings.threads != 1)
+	{
+		threadPool = std::make_unique<cThreadPool>(settings.threads);
+		world.taskSystem = threadPool.get();
+	}
+	if (!LoadScene(world, settings))
+		return 1;
+
+	const char* sceneLabel = settings.scenePath.empty() ? settings.sceneName.c_str() : settings.scenePath.c_str();
+	int startBodies = static_cast<int>(world.p_actors.size());
+
+	for (int i = 0; i < settings.warmupSteps; ++i)
+	{
+		world.f_step(settings.dt, settings.primaryIterations, settings.secondaryIterations, settings.warmStart);
+	}
+
+	using clock = std::chrono::steady_clock;
+	std::vector<StepSample> samples;
+	samples.reserve(settings.steps);
+
+	clock::time_point runStart = clock::now();
+	for (int i = 0; i < settings.steps; ++i)
+	{
+		clock::time_point stepStart = clock::now();
+		world.f_step(settings.dt, settings.primaryIterations, settings.secondaryIterations, settings.warmStart);
+		clock::time_point stepEnd = clock::now();
+
+		StepSample sample;
+		sample.time = std::chrono::duration<double, std::micro>(stepEnd - stepStart).count();
+		sample.bodies = static_cast<int>(world.p_actors.size());
+		sample.contacts = static_cast<int>(world.p_contacts.size());
+		sample.touching = CountTouchingContacts(world);
+		sample.profile = world.GetProfile();
+		samples.push_back(sample);
+	}
+	double totalTime = std::chrono::duration<double>(clock::now() - runStart).count();
+
+	std::vector<double> times;
+	times.reserve(samples.size());
+	double timeSum = 0.0;
+	int peakBodies = 0, peakContacts = 0;
+	cStepProfile profileSum;
+	const StepSample* slowest = &samples.front();
+	for (const StepSample& sample : samples)
+	{
+		AddProfile(profileSum, sample.profile);
+		if (sample.time > slowest->time)
+			slowest = &sample;
+		times.push_back(sample.time);
+		timeSum += sample.time;
+		peakBodies = c_max(peakBodies, sample.bodies);
+		peakContacts = c_max(peakContacts, sample.contacts);
+	}
+	std::sort(times.begin(), times.end());
+	const StepSample& last = samples.back();
+
+	// the totalTime includes the per step bookkeeping above, steps/sec only counts the steps themselves
+	std::cout << std::fixed << std::setprecision(2);
+	std::cout << "scene:         " << sceneLabel << "\n";
+	std::cout << "solver:        " << (settings.runBasicSolver ? "PGS Basic" : settings.runWideSolver ? "PGS Soft Wide" : "PGS Soft")
+		<< " (" << settings.primaryIterations << "/" << settings.secondaryIterations << " iterations"
+		<< (settings.warmStart ? ", warm started" : "") << (settings.enableSleep ? "" : ", sleep disabled") << ")\n";
+	std::cout << "workers:       " << (threadPool ? threadPool->getWorkerCount() : 1) << "\n";
+	std::cout << "steps:         " << settings.steps << " measured, " << settings.warmupSteps << " warmup, dt " << std::setprecision(4) << settings.dt << std::setprecision(2) << "\n";
+	std::cout << "wall time:     " << totalTime * 1000.0 << " ms\n";
+	std::cout << "steps/sec:     " << settings.steps / (timeSum * 1e-6) << "\n";
+	std::cout << "step time us:  mean " << timeSum / samples.size()
+		<< ", p50 " << Percentile(times, 0.5)
+		<< ", p99 " << Percentile(times, 0.99)
+		<< ", max " << times.back() << "\n";
+	std::cout << "bodies:        " << startBodies << " at load, " << last.bodies << " at end, " << peakBodies << " peak\n";
+	std::cout << "contacts:      " << last.contacts << " at end (" << last.touching << " touching), " << peakContacts << " peak\n";
+	std::cout << "proxies:       " << world.m_broadphase.GetProxyCount() << ", aabb margin " << world.GetAABBMargin()
+		<< ", " << BroadphaseName(world.GetBroadphaseType()) << (world.GetWideTreeQueries() ? ", wide tree queries" : "") << "\n";
+
+	if (settings.printProfile)
+	{
+		std::cout << "mean step profile (us):\n";
+		PrintProfile(profileSum, static_cast<double>(samples.size()));
+		std::cout << "slowest step profile (us), step " << (slowest - samples.data()) << ":\n";
+		PrintProfile(slowest->profile, 1.0);
+	}
+
+	if (!settings.csvPath.empty())
+	{
+		std::ofstream csv(settings.csvPath);
+		if (!csv)
+		{
+			std::cerr << "could not open " << settings.csvPath << " for writing\n";
+			return 1;
+		}
+		csv << "step,time_us,bodies,contacts,touching,"
+			"transforms_us,update_pairs_us,update_contacts_us,solve_us,fracture_detect_us,fracture_clip_us,fracture_create_us,"
+			"awake_actors,awake_proxies,moved_proxies,pairs_generated,contacts_created,contacts_destroyed,gjk_iterations,fragments_spawned\n";
+		for (size_t i = 0; i < samples.size(); ++i)
+		{
+			const StepSample& s = samples[i];
+			const cStepProfile& p = s.profile;
+			csv << i << "," << s.time << "," << s.bodies << "," << s.contacts << "," << s.touching << ","
+				<< p.updateTransforms * 1000.0f << "," << p.updatePairs * 1000.0f << "," << p.updateContacts * 1000.0f << ","
+				<< p.solve * 1000.0f << "," << p.fractureDetect * 1000.0f << "," << p.fractureClip * 1000.0f << ","
+				<< p.fractureCreate * 1000.0f << ","
+				<< p.awakeActors << "," << p.awakeProxies << "," << p.movedProxies << "," << p.pairsGenerated << "," << p.contactsCreated << "," << p.contactsDestroyed << ","
+				<< p.gjkIterations << "," << p.fragmentsSpawned << "\n";
+		}
+	}
+
+	return 0;
+}
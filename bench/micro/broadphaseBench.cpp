@@ -0,0 +1,121 @@
+// Broadphase microbenchmark
+// Runs scenes with the dynamic tree (TREE_BROADPHASE), the dynamic tree with wide tree queries (cPhysicsWorld::SetWideTreeQueries),
+// the sweep and prune (SAP_BROADPHASE) and the hash grid (GRID_BROADPHASE) and compares
+// the broadphase phases of the step: transforms/aabbs (MoveProxy) and update pairs (tree rebuilds, pair finding, contact creation).
+// It runs the built-in StackScene, DominoScene, FractureTestScene and DebrisScene, rows of fracturable boxes
+// thrown at the floor that shatter into about 1800 fragments moving coherently.
+// The step order changes with the broadphase, so the simulations diverge a little and the counters are printed as well.
+//
+// Build (from the repository root):
+//   g++ -std=c++17 -O2 -pthread -I. bench/micro/broadphaseBench.cpp aabbtree.cpp broadphase.cpp chioriTasks.cpp contact.cpp
+//       fracture.cpp fractureWorld.cpp geom.cpp gjk.cpp island.cpp manifold.cpp physicsWorld.cpp scenes.cpp
+//       solver.cpp solverWide.cpp sweepAndPrune.cpp hashGrid.cpp voronoi.cpp wideTree.cpp -o broadphaseBench
+//
+// Usage:
+//   broadphaseBench [--steps N] [--threads N]
+#include "pch.h"
+#include "fractureWorld.h"
+#include "scenes.h"
+#include <chrono>
+
+using namespace chiori;
+
+struct BroadphaseTimes
+{
+	double step{ 0.0 };			// microseconds per step
+	double transforms{ 0.0 };
+	double updatePairs{ 0.0 };
+	double movedProxies{ 0.0 };	// per step
+	double pairsGenerated{ 0.0 };
+	int actors{ 0 };			// at the end
+};
+
+struct BroadphaseConfig
+{
+	const char* name;
+	cBroadphaseType type;
+	bool wideTreeQueries;
+};
+
+static BroadphaseTimes RunScene(SceneBuilder build, const BroadphaseConfig& config, int steps, cTaskSystem* taskSystem)
+{
+	cFractureWorld world;
+	world.SetBroadphaseType(config.type);
+	world.SetWideTreeQueries(config.wideTreeQueries);
+	world.taskSystem = taskSystem;
+	build(&world);
+
+	BroadphaseTimes times;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int i = 0; i < steps; ++i)
+	{
+		world.f_step(0.0167f);
+		const cStepProfile& profile = world.GetProfile();
+		times.transforms += profile.updateTransforms;
+		times.updatePairs += profile.updatePairs;
+		times.movedProxies += profile.movedProxies;
+		times.pairsGenerated += profile.pairsGenerated;
+	}
+	double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+	times.step = us / steps;
+	times.transforms *= 1000.0 / steps;
+	times.updatePairs *= 1000.0 / steps;
+	times.movedProxies /= steps;
+	times.pairsGenerated /= steps;
+	times.actors = static_cast<int>(world.p_actors.size());
+	return times;
+}
+
+int main(int argc, char** argv)
+{
+	int steps = 600;
+	int threads = 1;
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		if (arg == "--steps" && i + 1 < argc)
+			steps = std::stoi(argv[++i]);
+		else if (arg == "--threads" && i + 1 < argc)
+			threads = std::stoi(argv[++i]);
+		else
+		{
+			printf("usage: broadphaseBench [--steps N] [--threads N]\n");
+			return 1;
+		}
+	}
+
+	std::unique_ptr<cThreadPool> threadPool;
+	if (threads != 1)
+		threadPool = std::make_unique<cThreadPool>(threads);
+
+	struct Scene
+	{
+		const char* name;
+		SceneBuilder build;
+	};
+	const Scene scenes[] = {
+		{ "StackScene", FindSceneBuilder("StackScene") },
+		{ "DominoScene", FindSceneBuilder("DominoScene") },
+		{ "FractureTestScene", FindSceneBuilder("FractureTestScene") },
+		{ "DebrisScene", FindSceneBuilder("DebrisScene") },
+	};
+
+	printf("%-18s %-5s %8s %10s %12s %13s %8s %8s\n", "scene", "type", "actors", "step us", "transforms", "update pairs", "moved", "pairs");
+	for (const Scene& scene : scenes)
+	{
+		const BroadphaseConfig configs[] = {
+			{ "tree", TREE_BROADPHASE, false },
+			{ "wide", TREE_BROADPHASE, true },
+			{ "sap", SAP_BROADPHASE, false },
+			{ "grid", GRID_BROADPHASE, false },
+		};
+		for (const BroadphaseConfig& config : configs)
+		{
+			BroadphaseTimes times = RunScene(scene.build, config, steps, threadPool.get());
+			printf("%-18s %-5s %8d %10.1f %12.1f %13.1f %8.1f %8.1f\n", scene.name, config.name,
+				times.actors, times.step, times.transforms, times.updatePairs, times.movedProxies, times.pairsGenerated);
+		}
+	}
+	return 0;
+}
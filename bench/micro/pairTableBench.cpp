@@ -0,0 +1,178 @@
+// Pair table microbenchmark
+// Compares cFLUTable (flat open addressing) against the std::unordered_set table it replaced,
+// using the access pattern of the step: every frame the broadphase checks all candidate pairs
+// with contains, and a few contacts are destroyed (erase) and created (insert).
+// Both tables are also checked against each other, a mismatch aborts the benchmark.
+//
+// Build (from the repository root):
+//   g++ -std=c++17 -O2 -I. bench/micro/pairTableBench.cpp -o pairTableBench
+//
+// Usage:
+//   pairTableBench [--frames N] [--seed N]
+#include "pch.h"
+#include "chioriMath.h"
+#include "chioriPool.h"
+#include <chrono>
+#include <random>
+
+using namespace chiori;
+
+// the previous cFLUTable, kept here as the baseline
+class cUnorderedPairTable
+{
+private:
+	std::unordered_set<uint64_t> data;
+public:
+	bool insert(int a, int b) { return data.emplace(LOOKUP_KEY(a, b)).second; }
+	bool contains(int a, int b) const { return data.find(LOOKUP_KEY(a, b)) != data.end(); }
+	bool erase(int a, int b) { return data.erase(LOOKUP_KEY(a, b)) > 0; }
+	size_t size() const { return data.size(); }
+};
+
+struct Pair
+{
+	int a, b;
+};
+
+struct TableTimes
+{
+	double insertNs{ 0.0 };		// per insert, building the table from empty
+	double hitNs{ 0.0 };		// per contains of a pair in the table
+	double missNs{ 0.0 };		// per contains of a pair not in the table
+	double churnNs{ 0.0 };		// per erase + insert pair during the frames
+	long long checksum{ 0 };	// number of contains hits, compared between the tables
+};
+
+using Clock = std::chrono::steady_clock;
+
+static double NsPer(Clock::time_point start, size_t ops)
+{
+	return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / static_cast<double>(ops);
+}
+
+// a random pair of two different shape indices in [0, shapeCount)
+static Pair RandomPair(std::mt19937& rng, int shapeCount)
+{
+	std::uniform_int_distribution<int> dist(0, shapeCount - 1);
+	Pair p{ dist(rng), dist(rng) };
+	while (p.a == p.b)
+		p.b = dist(rng);
+	return p;
+}
+
+template <typename Table>
+static TableTimes RunTable(Table& table, const std::vector<Pair>& pairs, const std::vector<Pair>& misses,
+	const std::vector<Pair>& churn, int frames)
+{
+	TableTimes times;
+
+	Clock::time_point start = Clock::now();
+	for (const Pair& p : pairs)
+		table.insert(p.a, p.b);
+	times.insertNs = NsPer(start, pairs.size());
+
+	// the live pairs, churn replaces them in place so hits keep hitting
+	std::vector<Pair> live = pairs;
+	size_t churnPerFrame = c_max(static_cast<size_t>(1), pairs.size() / 20);
+	size_t churnIndex = 0;
+
+	double hitTotal = 0.0, missTotal = 0.0, churnTotal = 0.0;
+	for (int frame = 0; frame < frames; ++frame)
+	{
+		start = Clock::now();
+		for (const Pair& p : live)
+			times.checksum += table.contains(p.b, p.a); // reversed order on purpose, the key is symmetric
+		hitTotal += NsPer(start, live.size());
+
+		start = Clock::now();
+		for (const Pair& p : misses)
+			times.checksum += table.contains(p.a, p.b);
+		missTotal += NsPer(start, misses.size());
+
+		start = Clock::now();
+		for (size_t i = 0; i < churnPerFrame; ++i)
+		{
+			size_t slot = (churnIndex * 7919) % live.size();
+			Pair& old = live[slot];
+			const Pair& n = churn[churnIndex % churn.size()];
+			times.checksum += table.erase(old.a, old.b);
+			times.checksum += table.insert(n.a, n.b);
+			old = n;
+			++churnIndex;
+		}
+		churnTotal += NsPer(start, churnPerFrame);
+	}
+
+	times.hitNs = hitTotal / frames;
+	times.missNs = missTotal / frames;
+	times.churnNs = churnTotal / frames;
+	return times;
+}
+
+int main(int argc, char** argv)
+{
+	int frames = 20;
+	unsigned seed = 12345;
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		if (arg == "--frames" && i + 1 < argc)
+			frames = std::stoi(argv[++i]);
+		else if (arg == "--seed" && i + 1 < argc)
+			seed = static_cast<unsigned>(std::stoul(argv[++i]));
+		else
+		{
+			printf("usage: pairTableBench [--frames N] [--seed N]\n");
+			return 1;
+		}
+	}
+
+	const size_t pairCounts[] = { 1000, 10000, 100000 };
+	printf("%-8s %-14s %10s %10s %10s %10s\n", "pairs", "table", "insert ns", "hit ns", "miss ns", "churn ns");
+	for (size_t pairCount : pairCounts)
+	{
+		std::mt19937 rng(seed);
+		int shapeCount = static_cast<int>(2.0 * std::sqrt(static_cast<double>(pairCount))) + 2;
+		shapeCount *= 4; // keep the pairs sparse enough that unique pairs are quick to find
+
+		// unique pairs in the table, pairs never in the table and the pairs churned in during the frames
+		cUnorderedPairTable used;
+		auto makeUnique = [&](size_t count)
+			{
+				std::vector<Pair> out;
+				out.reserve(count);
+				while (out.size() < count)
+				{
+					Pair p = RandomPair(rng, shapeCount);
+					if (used.insert(p.a, p.b))
+						out.push_back(p);
+				}
+				return out;
+			};
+		std::vector<Pair> pairs = makeUnique(pairCount);
+		std::vector<Pair> misses = makeUnique(pairCount);
+		std::vector<Pair> churn = makeUnique(c_max(static_cast<size_t>(1), pairCount / 20) * frames);
+
+		cDefaultAllocator defaultAllocator;
+		cAllocatorWrapper<cDefaultAllocator> allocator(defaultAllocator);
+
+		cUnorderedPairTable baseline;
+		TableTimes baseTimes = RunTable(baseline, pairs, misses, churn, frames);
+
+		cFLUTable flat(&allocator);
+		TableTimes flatTimes = RunTable(flat, pairs, misses, churn, frames);
+
+		if (baseTimes.checksum != flatTimes.checksum || baseline.size() != flat.size())
+		{
+			printf("MISMATCH at %zu pairs: checksum %lld vs %lld, size %zu vs %zu\n", pairCount,
+				baseTimes.checksum, flatTimes.checksum, baseline.size(), flat.size());
+			return 1;
+		}
+
+		printf("%-8zu %-14s %10.1f %10.1f %10.1f %10.1f\n", pairCount, "unordered_set",
+			baseTimes.insertNs, baseTimes.hitNs, baseTimes.missNs, baseTimes.churnNs);
+		printf("%-8zu %-14s %10.1f %10.1f %10.1f %10.1f\n", pairCount, "cFLUTable",
+			flatTimes.insertNs, flatTimes.hitNs, flatTimes.missNs, flatTimes.churnNs);
+	}
+	return 0;
+}
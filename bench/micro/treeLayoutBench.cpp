@@ -0,0 +1,150 @@
+// Dynamic tree node layout microbenchmark
+// Runs a long fracture session (DebrisScene) so that the broadphase trees go through many insertions, removals,
+// rotations and rebuilds, then times broadphase queries and ray casts before and after cPhysicsWorld::CompactBroadphase.
+// The queries are the ones of cBroadphase::UpdatePairs: every shape queries with its fat AABB.
+// The mean jump is the mean distance in m_nodes between a node and its children, small when traversals walk memory forward.
+// Both layouts must find the same overlaps and ray hits, a mismatch aborts the benchmark.
+//
+// Build (from the repository root):
+//   g++ -std=c++17 -O2 -pthread -I. bench/micro/treeLayoutBench.cpp aabbtree.cpp broadphase.cpp chioriTasks.cpp contact.cpp
+//       fracture.cpp fractureWorld.cpp geom.cpp gjk.cpp island.cpp manifold.cpp physicsWorld.cpp scenes.cpp
+//       solver.cpp solverWide.cpp sweepAndPrune.cpp hashGrid.cpp voronoi.cpp wideTree.cpp -o treeLayoutBench
+//
+// Usage:
+//   treeLayoutBench [--steps N] [--rounds N]
+#include "pch.h"
+#include "fractureWorld.h"
+#include "scenes.h"
+#include <chrono>
+
+using namespace chiori;
+
+using Clock = std::chrono::steady_clock;
+
+struct LayoutTimes
+{
+	double nsPerQuery{ 0.0 };
+	double nsPerRay{ 0.0 };
+	long long overlaps{ 0 };	// summed over all rounds, compared between the layouts
+	long long rayHits{ 0 };
+};
+
+static double MeanJump(const cDynamicTree& tree)
+{
+	if (tree.GetRoot() == null_node)
+		return 0.0;
+
+	double jump = 0.0;
+	int count = 0;
+	std::vector<int> stack{ tree.GetRoot() };
+	while (!stack.empty())
+	{
+		int nodeID = stack.back();
+		stack.pop_back();
+		const cTreeNode& node = tree.GetNode(nodeID);
+		if (node.IsLeaf())
+			continue;
+
+		jump += std::abs(node.child1 - nodeID) + std::abs(node.child2 - nodeID);
+		count += 2;
+		stack.push_back(node.child1);
+		stack.push_back(node.child2);
+	}
+	return jump / count;
+}
+
+static LayoutTimes RunQueries(cFractureWorld& world, const std::vector<cRayCastInput>& rays, int rounds)
+{
+	const cBroadphase& broadphase = world.m_broadphase;
+	std::vector<cAABB> queries;
+	for (const cShape* shape : world.p_shapes)
+		queries.push_back(broadphase.GetFattenedAABB(shape->broadphaseIndex));
+
+	LayoutTimes times;
+	Clock::time_point start = Clock::now();
+	for (int round = 0; round < rounds; ++round)
+	{
+		for (const cAABB& aabb : queries)
+		{
+			broadphase.Query(aabb, [&times](int) -> bool {
+				++times.overlaps;
+				return true;
+				});
+		}
+	}
+	times.nsPerQuery = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / (static_cast<double>(queries.size()) * rounds);
+
+	start = Clock::now();
+	for (int round = 0; round < rounds; ++round)
+	{
+		for (const cRayCastInput& ray : rays)
+		{
+			broadphase.RayCast(ray, [&times](const cRayCastInput&, int) -> float {
+				++times.rayHits;
+				return -1.0f;
+				});
+		}
+	}
+	times.nsPerRay = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / (static_cast<double>(rays.size()) * rounds);
+	return times;
+}
+
+int main(int argc, char** argv)
+{
+	int steps = 1200;
+	int rounds = 20;
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		if (arg == "--steps" && i + 1 < argc)
+			steps = std::stoi(argv[++i]);
+		else if (arg == "--rounds" && i + 1 < argc)
+			rounds = std::stoi(argv[++i]);
+		else
+		{
+			printf("usage: treeLayoutBench [--steps N] [--rounds N]\n");
+			return 1;
+		}
+	}
+
+	cFractureWorld world;
+	BuildDebrisScene(&world);
+	for (int i = 0; i < steps; ++i)
+		world.f_step(0.0167f);
+
+	// rays across the debris field, from above and from the sides
+	std::vector<cRayCastInput> rays;
+	std::mt19937 rng(7);
+	std::uniform_real_distribution<float> across(-100.0f, 100.0f), up(0.0f, 20.0f);
+	for (int i = 0; i < 1000; ++i)
+	{
+		cVec2 origin{ across(rng), 30.0f + up(rng) };
+		cVec2 target{ across(rng), up(rng) - 5.0f };
+		rays.push_back({ origin, target - origin, 1.0f });
+	}
+
+	const cDynamicTree& dynamicTree = world.m_broadphase.GetTree(DYNAMIC_PROXY);
+	printf("after %d steps: %u proxies, dynamic tree capacity %d, height %d\n", steps, world.m_broadphase.GetProxyCount(),
+		dynamicTree.GetProxyCapacity(), dynamicTree.GetHeight());
+
+	printf("%-10s %10s %12s %10s %12s %10s\n", "layout", "mean jump", "ns/query", "overlaps", "ns/ray", "ray hits");
+	LayoutTimes before = RunQueries(world, rays, rounds);
+	printf("%-10s %10.1f %12.1f %10lld %12.1f %10lld\n", "scattered", MeanJump(dynamicTree), before.nsPerQuery, before.overlaps,
+		before.nsPerRay, before.rayHits);
+
+	Clock::time_point start = Clock::now();
+	world.CompactBroadphase();
+	double compactUs = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+
+	LayoutTimes after = RunQueries(world, rays, rounds);
+	printf("%-10s %10.1f %12.1f %10lld %12.1f %10lld\n", "compacted", MeanJump(dynamicTree), after.nsPerQuery, after.overlaps,
+		after.nsPerRay, after.rayHits);
+	printf("compaction: %.1f us, dynamic tree capacity %d\n", compactUs, dynamicTree.GetProxyCapacity());
+
+	if (before.overlaps != after.overlaps || before.rayHits != after.rayHits)
+	{
+		printf("MISMATCH: %lld vs %lld overlaps, %lld vs %lld ray hits\n", before.overlaps, after.overlaps, before.rayHits, after.rayHits);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,140 @@
+// Dynamic tree query microbenchmark
+// Compares cDynamicTree::Query (templated callback, fixed size stack) against the query it replaced,
+// which allocated a std::stack per call and called the callback through a std::function.
+// Like cBroadphase::UpdatePairs, every proxy queries the tree with its own fat AABB.
+// Both queries must find the same overlaps, a mismatch aborts the benchmark.
+//
+// Build (from the repository root):
+//   g++ -std=c++17 -O2 -I. bench/micro/treeQueryBench.cpp aabbtree.cpp -o treeQueryBench
+//
+// Usage:
+//   treeQueryBench [--rounds N] [--seed N]
+#include "pch.h"
+#include "chioriMath.h"
+#include "aabbtree.h"
+#include <chrono>
+#include <random>
+#include <stack>
+
+using namespace chiori;
+
+// the previous cDynamicTree::Query, kept here as the baseline
+static void StdFunctionQuery(const cDynamicTree& tree, const cAABB& aabb, QueryCallback callback)
+{
+	std::stack<int> stack;
+	stack.push(tree.GetRoot());
+
+	while (stack.size() > 0)
+	{
+		int nodeID = stack.top();
+		stack.pop();
+		if (nodeID == null_node)
+			continue;
+
+		const cTreeNode& node = tree.GetNode(nodeID);
+
+		if (aabb.intersects(node.aabb))
+		{
+			if (node.IsLeaf())
+			{
+				if (!callback(nodeID))
+					return;
+			}
+			else
+			{
+				stack.push(node.child1);
+				stack.push(node.child2);
+			}
+		}
+	}
+}
+
+using Clock = std::chrono::steady_clock;
+
+struct QueryTimes
+{
+	double nsPerQuery{ 0.0 };
+	long long overlaps{ 0 };	// summed over all rounds, compared between the queries
+};
+
+template <typename QueryFunction>
+static QueryTimes RunQueries(const std::vector<int>& proxies, const cDynamicTree& tree, int rounds, QueryFunction&& query)
+{
+	QueryTimes times;
+	Clock::time_point start = Clock::now();
+	for (int round = 0; round < rounds; ++round)
+	{
+		for (int proxy : proxies)
+			times.overlaps += query(tree.GetFattenedAABB(proxy));
+	}
+	double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+	times.nsPerQuery = ns / (static_cast<double>(proxies.size()) * rounds);
+	return times;
+}
+
+int main(int argc, char** argv)
+{
+	int rounds = 5;
+	unsigned seed = 12345;
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		if (arg == "--rounds" && i + 1 < argc)
+			rounds = std::stoi(argv[++i]);
+		else if (arg == "--seed" && i + 1 < argc)
+			seed = static_cast<unsigned>(std::stoul(argv[++i]));
+		else
+		{
+			printf("usage: treeQueryBench [--rounds N] [--seed N]\n");
+			return 1;
+		}
+	}
+
+	const int proxyCounts[] = { 10000, 30000, 100000 };
+	printf("%-8s %-14s %12s %14s %10s\n", "proxies", "query", "ns/query", "queries/sec", "overlaps");
+	for (int proxyCount : proxyCounts)
+	{
+		// boxes of 0.5 to 2 units scattered so that every box overlaps a few others, like a pile of debris
+		std::mt19937 rng(seed);
+		float worldSize = std::sqrt(static_cast<float>(proxyCount)) * 1.5f;
+		std::uniform_real_distribution<float> position(0.0f, worldSize);
+		std::uniform_real_distribution<float> extent(0.25f, 1.0f);
+
+		cDynamicTree tree;
+		std::vector<int> proxies;
+		proxies.reserve(proxyCount);
+		for (int i = 0; i < proxyCount; ++i)
+		{
+			cVec2 center{ position(rng), position(rng) };
+			cVec2 halfSize{ extent(rng), extent(rng) };
+			cAABB aabb;
+			aabb.min = center - halfSize;
+			aabb.max = center + halfSize;
+			proxies.push_back(tree.InsertProxy(aabb, nullptr));
+		}
+
+		QueryTimes before = RunQueries(proxies, tree, rounds, [&tree](const cAABB& aabb)
+			{
+				long long count = 0;
+				StdFunctionQuery(tree, aabb, [&count](unsigned int) { ++count; return true; });
+				return count;
+			});
+
+		QueryTimes after = RunQueries(proxies, tree, rounds, [&tree](const cAABB& aabb)
+			{
+				long long count = 0;
+				tree.Query(aabb, [&count](int) { ++count; return true; });
+				return count;
+			});
+
+		if (before.overlaps != after.overlaps)
+		{
+			printf("MISMATCH at %d proxies: %lld vs %lld overlaps\n", proxyCount, before.overlaps, after.overlaps);
+			return 1;
+		}
+
+		printf("%-8d %-14s %12.1f %14.0f %10lld\n", proxyCount, "std::function", before.nsPerQuery, 1e9 / before.nsPerQuery, before.overlaps);
+		printf("%-8d %-14s %12.1f %14.0f %10lld\n", proxyCount, "templated", after.nsPerQuery, 1e9 / after.nsPerQuery, after.overlaps);
+	}
+	return 0;
+}
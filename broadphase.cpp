@@ -6,54 +6,150 @@ namespace chiori
 {
 	cBroadphase::cBroadphase()
 	{
+		m_type = TREE_BROADPHASE;
+		m_sweepPairs = false;
+		m_wideQueries = false;
 		m_proxyCount = 0;
 
-		m_pairCapacity = 16;
-		m_pairCount = 0;
-		m_pairBuffer = new cPair[m_pairCapacity];
-
 		m_moveCapacity = 16;
 		m_moveCount = 0;
 		m_moveBuffer = new int[m_moveCapacity];
+
+		m_bulkCapacity = 0;
+		m_bulkCount = 0;
+		m_bulkBuffer = nullptr;
+		m_bulkInsert = false;
+
+		m_moveIndexCapacity = 0;
+		m_moveIndices = nullptr;
+
+		m_pairBufferCount = 0;
+		m_pairBuffers = nullptr;
+
+		m_mergeCapacity = 0;
+		m_mergeRanges = nullptr;
+
+		m_trees[STATIC_PROXY].SetAABBMargin(0.0f);
 	}
 	
 	cBroadphase::~cBroadphase()
 	{
-		delete[] m_pairBuffer;
+		for (int i = 0; i < m_pairBufferCount; ++i)
+		{
+			delete[] m_pairBuffers[i].pairs;
+			delete[] m_pairBuffers[i].ranges;
+		}
+		delete[] m_pairBuffers;
+		delete[] m_mergeRanges;
+		delete[] m_moveIndices;
+		delete[] m_bulkBuffer;
 		delete[] m_moveBuffer;
 	}
 
-	int cBroadphase::CreateProxy(const cAABB& aabb, void* userData)
+	void cBroadphase::SetType(cBroadphaseType type)
 	{
-		int proxyId = m_tree.InsertProxy(aabb, userData);
+		cassert(m_proxyCount == 0);
+		m_type = type;
+	}
+
+	int cBroadphase::CreateProxy(const cAABB& aabb, void* userData, cProxyType type)
+	{
+		int proxyKey;
+		if (m_bulkInsert && (type == STATIC_PROXY || m_type == TREE_BROADPHASE))
+		{
+			proxyKey = ProxyKey(m_trees[type].AllocateProxy(aabb, userData), type);
+			GrowBuffer(m_bulkBuffer, m_bulkCapacity, m_bulkCount, m_bulkCount + 1);
+			m_bulkBuffer[m_bulkCount++] = proxyKey;
+		}
+		else
+		{
+			// the sweep and prune and the grid have no build to batch, they take their proxies right away
+			proxyKey = ProxyKey(VisitProxies(type, [&](auto& proxies) { return proxies.InsertProxy(aabb, userData); }), type);
+		}
 		++m_proxyCount;
-		BufferMove(proxyId);
-		return proxyId;
+		// a new static proxy queries the dynamic tree once, so that it finds the proxies that are already resting on it
+		BufferMove(proxyKey);
+		return proxyKey;
 	}
 
-	void cBroadphase::DestroyProxy(int proxyId)
+	void cBroadphase::DestroyProxy(int proxyKey)
 	{
-		UnBufferMove(proxyId);
+		if (m_bulkInsert)
+		{
+			for (int i = 0; i < m_bulkCount; ++i)
+			{
+				if (m_bulkBuffer[i] == proxyKey)
+				{
+					m_bulkBuffer[i] = m_bulkBuffer[--m_bulkCount];
+					break;
+				}
+			}
+		}
+		UnBufferMove(proxyKey);
 		--m_proxyCount;
-		m_tree.DestroyProxy(proxyId);
+		VisitProxies(ProxyType(proxyKey), [proxyKey](auto& proxies) { proxies.DestroyProxy(ProxyID(proxyKey)); });
 	}
 
-	void cBroadphase::MoveProxy(int proxyId, const cAABB& aabb, const cVec2& displacement)
+	void cBroadphase::BeginBulkInsert()
 	{
-		bool buffer = m_tree.MoveProxy(proxyId, aabb, displacement);
+		cassert(!m_bulkInsert);
+		m_bulkInsert = true;
+		m_bulkCount = 0;
+	}
+
+	void cBroadphase::EndBulkInsert()
+	{
+		cassert(m_bulkInsert);
+
+		// Static keys first, then turn the keys into ids for each tree
+		int* firstDynamic = std::partition(m_bulkBuffer, m_bulkBuffer + m_bulkCount,
+			[](int proxyKey) { return ProxyType(proxyKey) == STATIC_PROXY; });
+		for (int i = 0; i < m_bulkCount; ++i)
+			m_bulkBuffer[i] = ProxyID(m_bulkBuffer[i]);
+
+		int staticCount = static_cast<int>(firstDynamic - m_bulkBuffer);
+		m_trees[STATIC_PROXY].InsertProxies(m_bulkBuffer, staticCount);
+		m_trees[DYNAMIC_PROXY].InsertProxies(firstDynamic, m_bulkCount - staticCount);
+		m_bulkInsert = false;
+		m_bulkCount = 0;
+	}
+
+	bool cBroadphase::MoveProxy(int proxyKey, const cAABB& aabb, const cVec2& displacement)
+	{
+		cassert(ProxyType(proxyKey) == DYNAMIC_PROXY);
+		bool buffer = VisitProxies(DYNAMIC_PROXY,
+			[&](auto& proxies) { return proxies.MoveProxy(ProxyID(proxyKey), aabb, displacement); });
 		if (buffer)
 		{
-			BufferMove(proxyId);
+			BufferMove(proxyKey);
 		}
+		return buffer;
+	}
+
+	void cBroadphase::TouchProxy(int proxyKey)
+	{
+		BufferMove(proxyKey);
 	}
 
-	void cBroadphase::TouchProxy(int proxyId)
+	void cBroadphase::GrowMoveIndices(int proxyKey)
 	{
-		BufferMove(proxyId);
+		if (proxyKey < m_moveIndexCapacity)
+			return;
+
+		int oldCapacity = m_moveIndexCapacity;
+		GrowBuffer(m_moveIndices, m_moveIndexCapacity, oldCapacity, proxyKey + 1);
+		for (int i = oldCapacity; i < m_moveIndexCapacity; ++i)
+			m_moveIndices[i] = null_proxy;
 	}
 
-	void cBroadphase::BufferMove(int proxyId)
+	void cBroadphase::BufferMove(int proxyKey)
 	{
+		GrowMoveIndices(proxyKey);
+		if (m_moveIndices[proxyKey] != null_proxy)
+		{
+			return;
+		}
+
 		if (m_moveCount == m_moveCapacity)
 		{
 			int* oldBuffer = m_moveBuffer;
@@ -63,99 +159,279 @@ namespace chiori
 			delete[] oldBuffer;
 		}
 
-		m_moveBuffer[m_moveCount] = proxyId;
+		m_moveIndices[proxyKey] = m_moveCount;
+		m_moveBuffer[m_moveCount] = proxyKey;
 		++m_moveCount;
 	}
 
-	void cBroadphase::UnBufferMove(int proxyId)
+	void cBroadphase::UnBufferMove(int proxyKey)
 	{
-		for (int i = 0; i < m_moveCount; ++i)
+		if (IsBuffered(proxyKey))
 		{
-			if (m_moveBuffer[i] == proxyId)
-				m_moveBuffer[i] = null_proxy;
+			m_moveBuffer[m_moveIndices[proxyKey]] = null_proxy;
+			m_moveIndices[proxyKey] = null_proxy;
 		}
 	}
 
-	bool cBroadphase::QueryCallback(int proxyId)
+	void cBroadphase::CompactTrees(ProxyRemapCallback callback)
+	{
+		cassert(!m_bulkInsert);
+
+		int* remap = nullptr;
+		int remapCapacity = 0;
+		for (int type = 0; type < PROXY_TYPE_COUNT; ++type)
+		{
+			if (!UsesTree(static_cast<cProxyType>(type)))
+				continue;
+
+			int oldCapacity = m_trees[type].GetProxyCapacity();
+			GrowBuffer(remap, remapCapacity, 0, oldCapacity);
+			m_trees[type].Compact(remap);
+
+			// Move the buffered proxies to their new keys. An old key can be the new key of another proxy,
+			// so all the old keys are cleared before the new ones are set
+			for (int i = 0; i < m_moveCount; ++i)
+			{
+				int proxyKey = m_moveBuffer[i];
+				if (proxyKey == null_proxy || ProxyType(proxyKey) != type)
+					continue;
+
+				m_moveIndices[proxyKey] = null_proxy;
+				m_moveBuffer[i] = ProxyKey(remap[ProxyID(proxyKey)], static_cast<cProxyType>(type));
+			}
+
+			for (int i = 0; i < m_moveCount; ++i)
+			{
+				int proxyKey = m_moveBuffer[i];
+				if (proxyKey == null_proxy || ProxyType(proxyKey) != type)
+					continue;
+
+				GrowMoveIndices(proxyKey);
+				m_moveIndices[proxyKey] = i;
+			}
+
+			for (int i = 0; i < oldCapacity; ++i)
+			{
+				int proxyID = remap[i];
+				if (proxyID == null_node || proxyID == i || !m_trees[type].GetNode(proxyID).IsLeaf())
+					continue;
+
+				callback(m_trees[type].GetUserData(proxyID), ProxyKey(proxyID, static_cast<cProxyType>(type)));
+			}
+		}
+		delete[] remap;
+	}
+
+	bool cBroadphase::QueryCallback(int proxyKey, int queryProxyKey, cPairBuffer* buffer) const
 	{
 		// A proxy cannot form a pair with itself.
-		if (proxyId == m_queryProxyId)
+		if (proxyKey == queryProxyKey)
 		{
 			return true;
 		}
 
-		// Grow the pair buffer as needed.
-		if (m_pairCount == m_pairCapacity)
+		// Both proxies moved, so the query of the other proxy finds this pair too.
+		// Only the query of the smaller proxy keeps it
+		if (IsBuffered(proxyKey) && proxyKey < queryProxyKey)
 		{
-			cPair* oldBuffer = m_pairBuffer;
-			m_pairCapacity *= 2;
-			m_pairBuffer = new cPair[m_pairCapacity];
-			memcpy(m_pairBuffer, oldBuffer, m_pairCount * sizeof(cPair));
-			delete[] oldBuffer;
+			return true;
 		}
 
-		m_pairBuffer[m_pairCount].a = c_min(proxyId, m_queryProxyId);
-		m_pairBuffer[m_pairCount].b = c_max(proxyId, m_queryProxyId);
-		cPair test1 = m_pairBuffer[0];
-		cPair test2 = m_pairBuffer[1];
-		++m_pairCount;
+		GrowBuffer(buffer->pairs, buffer->pairCapacity, buffer->pairCount, buffer->pairCount + 1);
+
+		cPair* pair = buffer->pairs + buffer->pairCount;
+		pair->a = c_min(proxyKey, queryProxyKey);
+		pair->b = c_max(proxyKey, queryProxyKey);
+		++buffer->pairCount;
 
 		return true;
 	}
 
-	void cBroadphase::UpdatePairs(BroadphaseCallback callback)
+	void cBroadphase::QueryMoves(int begin, int end, cPairBuffer* buffer, int worker) const
 	{
-		// Reset pair buffer
-		m_pairCount = 0;
+		GrowBuffer(buffer->ranges, buffer->rangeCapacity, buffer->rangeCount, buffer->rangeCount + 1);
+		cPairRange* range = buffer->ranges + buffer->rangeCount;
+		range->moveBegin = begin;
+		range->worker = worker;
+		range->pairStart = buffer->pairCount;
+		++buffer->rangeCount;
 
-		// Perform tree queries for all moving proxies.
-		for (int i = 0; i < m_moveCount; ++i)
+		for (int i = begin; i < end; ++i)
 		{
-
-			m_queryProxyId = m_moveBuffer[i];
-			if (m_queryProxyId == null_proxy)
+			int queryProxyKey = m_moveBuffer[i];
+			if (queryProxyKey == null_proxy)
 			{
 				continue;
 			}
 
 			// We have to query the tree with the fat AABB so that
 			// we don't fail to create a pair that may touch later.
-			const cAABB& fatAABB = m_tree.GetFattenedAABB(m_queryProxyId);
+			const cAABB& fatAABB = GetFattenedAABB(queryProxyKey);
 
-			// Query tree, create pairs and add them pair buffer.
-			auto q_callback = [this](unsigned int proxyId) -> bool {
-				return this->QueryCallback(proxyId);
+			// Query the trees, create pairs and add them pair buffer.
+			// Static proxies only look for dynamic proxies, static pairs are never created.
+			// When the sweep finds the pairs between dynamic proxies, only static proxies query the sweep and prune
+			auto dynamicCallback = [this, queryProxyKey, buffer](int proxyId) -> bool {
+				return this->QueryCallback(ProxyKey(proxyId, DYNAMIC_PROXY), queryProxyKey, buffer);
 				};
-			m_tree.Query(fatAABB, q_callback);
+
+			if (!m_sweepPairs || ProxyType(queryProxyKey) == STATIC_PROXY)
+				VisitQueryProxies(DYNAMIC_PROXY, [&](const auto& proxies) { proxies.Query(fatAABB, dynamicCallback); });
+
+			if (ProxyType(queryProxyKey) == DYNAMIC_PROXY)
+			{
+				auto staticCallback = [this, queryProxyKey, buffer](int proxyId) -> bool {
+					return this->QueryCallback(ProxyKey(proxyId, STATIC_PROXY), queryProxyKey, buffer);
+					};
+				VisitQueryProxies(STATIC_PROXY, [&](const auto& proxies) { proxies.Query(fatAABB, staticCallback); });
+			}
 		}
 
-		// Reset move buffer
-		m_moveCount = 0;
+		range->pairCount = buffer->pairCount - range->pairStart;
+	}
+
+	void cBroadphase::SweepPairs(int begin, int end, cPairBuffer* buffer, int worker) const
+	{
+		// the sweep ranges are merged after the ranges of the move buffer
+		GrowBuffer(buffer->ranges, buffer->rangeCapacity, buffer->rangeCount, buffer->rangeCount + 1);
+		cPairRange* range = buffer->ranges + buffer->rangeCount;
+		range->moveBegin = m_moveCount + begin;
+		range->worker = worker;
+		range->pairStart = buffer->pairCount;
+		++buffer->rangeCount;
 
-		// Sort the pair buffer to expose duplicates.
-		std::sort(m_pairBuffer, m_pairBuffer + m_pairCount, cPairLessThan);
+		m_sap.FindPairs(begin, end, [this, buffer](int proxyIdA, int proxyIdB) {
+			int proxyKeyA = ProxyKey(proxyIdA, DYNAMIC_PROXY);
+			int proxyKeyB = ProxyKey(proxyIdB, DYNAMIC_PROXY);
 
-		// Send the pairs back to the client.
-		int i = 0;
-		while (i < m_pairCount)
+			// pairs that did not move are already known
+			if (!IsBuffered(proxyKeyA) && !IsBuffered(proxyKeyB))
+				return;
+
+			GrowBuffer(buffer->pairs, buffer->pairCapacity, buffer->pairCount, buffer->pairCount + 1);
+			cPair* pair = buffer->pairs + buffer->pairCount;
+			pair->a = c_min(proxyKeyA, proxyKeyB);
+			pair->b = c_max(proxyKeyA, proxyKeyB);
+			++buffer->pairCount;
+			});
+
+		range->pairCount = buffer->pairCount - range->pairStart;
+	}
+
+	void cBroadphase::UpdatePairs(BroadphaseCallback callback, cTaskSystem* taskSystem)
+	{
+		// the static proxies query the sweep and prune, which needs to be sorted first
+		if (m_type == SAP_BROADPHASE)
+			m_sap.Sort();
+		// the grid follows the size of its proxies, resizing only moves them to other cells
+		else if (m_type == GRID_BROADPHASE)
+			m_grid.UpdateCellSize();
+
+		// the static tree rarely changes, its copy is usually kept from the last step
+		if (m_wideQueries)
+		{
+			for (int type = 0; type < PROXY_TYPE_COUNT; ++type)
+			{
+				if (UsesTree(static_cast<cProxyType>(type)) && !m_wideTrees[type].IsBuiltFrom(m_trees[type]))
+					m_wideTrees[type].Build(m_trees[type]);
+			}
+		}
+
+		int dynamicMoves = 0;
+		for (int i = 0; i < m_moveCount; ++i)
+		{
+			if (m_moveBuffer[i] != null_proxy && ProxyType(m_moveBuffer[i]) == DYNAMIC_PROXY)
+				++dynamicMoves;
+		}
+
+		// A sweep visits every dynamic proxy, it only pays off once a good part of them moved
+		m_sweepPairs = m_type == SAP_BROADPHASE && dynamicMoves > 0 &&
+			dynamicMoves >= SAP_SWEEP_MOVE_FRACTION * m_sap.GetProxyCount();
+
+		// Reset the pair buffers, one per worker
+		int workerCount = taskSystem ? taskSystem->getWorkerCount() : 1;
+		if (m_pairBufferCount < workerCount)
+		{
+			cPairBuffer* oldBuffers = m_pairBuffers;
+			m_pairBuffers = new cPairBuffer[workerCount];
+			for (int i = 0; i < m_pairBufferCount; ++i)
+				m_pairBuffers[i] = oldBuffers[i];
+			delete[] oldBuffers;
+			m_pairBufferCount = workerCount;
+		}
+
+		for (int i = 0; i < m_pairBufferCount; ++i)
 		{
-			cPair* primaryPair = m_pairBuffer + i;
-			void* userDataA = m_tree.GetUserData(primaryPair->a);
-			void* userDataB = m_tree.GetUserData(primaryPair->b);
+			m_pairBuffers[i].pairCount = 0;
+			m_pairBuffers[i].rangeCount = 0;
+		}
 
-			callback(userDataA, userDataB); // Gives the cilent the new pair
-			++i;
+		// Perform tree queries for all moving proxies.
+		if (taskSystem)
+		{
+			taskSystem->parallelFor(m_moveCount, MOVES_PER_TASK,
+				[this](int begin, int end, int worker) { QueryMoves(begin, end, m_pairBuffers + worker, worker); });
+		}
+		else
+		{
+			QueryMoves(0, m_moveCount, m_pairBuffers, 0);
+		}
 
-			// Skip any duplicate pairs.
-			while (i < m_pairCount)
+		// Sweep the sorted dynamic proxies for the pairs with a moved proxy
+		if (m_sweepPairs)
+		{
+			int entryCount = m_sap.GetEntryCount();
+			if (taskSystem)
 			{
-				cPair* pair = m_pairBuffer + i;
-				if (pair->a != primaryPair->a || pair->b != primaryPair->b)
-				{
-					break;
-				}
-				++i;
+				taskSystem->parallelFor(entryCount, SAP_ENTRIES_PER_TASK,
+					[this](int begin, int end, int worker) { SweepPairs(begin, end, m_pairBuffers + worker, worker); });
+			}
+			else
+			{
+				SweepPairs(0, entryCount, m_pairBuffers, 0);
 			}
 		}
+
+		// Merge the ranges in move buffer order, followed by the sweep ranges in entry order, which gives the same pair order for any number of workers.
+		// The queries already skipped the pairs found from the other proxy, no pair is found twice
+		int rangeCount = 0;
+		for (int i = 0; i < m_pairBufferCount; ++i)
+			rangeCount += m_pairBuffers[i].rangeCount;
+
+		GrowBuffer(m_mergeRanges, m_mergeCapacity, 0, rangeCount);
+		rangeCount = 0;
+		for (int i = 0; i < m_pairBufferCount; ++i)
+		{
+			// a worker that got no moves has no range buffer
+			if (m_pairBuffers[i].rangeCount == 0)
+				continue;
+
+			memcpy(m_mergeRanges + rangeCount, m_pairBuffers[i].ranges, m_pairBuffers[i].rangeCount * sizeof(cPairRange));
+			rangeCount += m_pairBuffers[i].rangeCount;
+		}
+		std::sort(m_mergeRanges, m_mergeRanges + rangeCount,
+			[](const cPairRange& range1, const cPairRange& range2) { return range1.moveBegin < range2.moveBegin; });
+
+		// Send the pairs back to the client.
+		for (int i = 0; i < rangeCount; ++i)
+		{
+			const cPairRange& range = m_mergeRanges[i];
+			const cPair* pairs = m_pairBuffers[range.worker].pairs + range.pairStart;
+			for (int j = 0; j < range.pairCount; ++j)
+			{
+				void* userDataA = GetUserData(pairs[j].a);
+				void* userDataB = GetUserData(pairs[j].b);
+
+				callback(userDataA, userDataB); // Gives the cilent the new pair
+			}
+		}
+
+		// Reset move buffer
+		for (int i = 0; i < m_moveCount; ++i)
+		{
+			if (m_moveBuffer[i] != null_proxy)
+				m_moveIndices[m_moveBuffer[i]] = null_proxy;
+		}
+		m_moveCount = 0;
 	}
 }
\ No newline at end of file
@@ -1,57 +1,186 @@
 #pragma once
 #include "aabbtree.h"
+#include "sweepAndPrune.h"
+#include "hashGrid.h"
+#include "wideTree.h"
+#include "chioriTasks.h"
 
 namespace chiori
 {
 	static constexpr int null_proxy = -1;
 	using BroadphaseCallback = std::function<void(void*, void*)>;
+	using ProxyRemapCallback = std::function<void(void* userData, int newProxyKey)>;
+
+	#define MOVES_PER_TASK 16 // the minimum number of moved proxies queried by one broadphase task
+	#define SAP_ENTRIES_PER_TASK 64 // the minimum number of sorted entries swept by one broadphase task
+	#define SAP_SWEEP_MOVE_FRACTION 0.25f // the sweep and prune is swept once at least this fraction of its proxies moved, fewer moved proxies query it instead
+
+	// What holds the dynamic proxies, static proxies are always kept in a tree
+	enum cBroadphaseType
+	{
+		TREE_BROADPHASE = 0,	// a cDynamicTree queried by every moved proxy
+		SAP_BROADPHASE = 1,		// a cSweepAndPrune swept once per UpdatePairs, for many proxies moving coherently
+		GRID_BROADPHASE = 2		// a cHashGrid queried by every moved proxy, for many proxies of similar size
+	};
+
+	// Static proxies never move, they live in their own tree which is only queried by the dynamic proxies
+	enum cProxyType
+	{
+		STATIC_PROXY = 0,
+		DYNAMIC_PROXY = 1,
+		PROXY_TYPE_COUNT = 2
+	};
+
+	// A proxy key is the proxy id in its tree shifted up by one, the low bit holds the cProxyType
+	inline int ProxyKey(int inProxyID, cProxyType inType) { return (inProxyID << 1) | inType; }
+	inline int ProxyID(int inProxyKey) { return inProxyKey >> 1; }
+	inline cProxyType ProxyType(int inProxyKey) { return static_cast<cProxyType>(inProxyKey & 1); }
 	
 	struct cPair
 	{
-		int a;
+		int a; // proxy keys
 		int b;
 	};
+
+	// the pairs found by the queries of the move buffer entries [moveBegin, moveBegin + moveCount)
+	struct cPairRange
+	{
+		int moveBegin;
+		int worker;
+		int pairStart;
+		int pairCount;
+	};
+
+	// the pairs and ranges one worker found during UpdatePairs
+	struct cPairBuffer
+	{
+		cPair* pairs{ nullptr };
+		int pairCount{ 0 };
+		int pairCapacity{ 0 };
+
+		cPairRange* ranges{ nullptr };
+		int rangeCount{ 0 };
+		int rangeCapacity{ 0 };
+	};
 	
 	// This will return all the overlapping pairs for the current frame
 	// All previous pairs will be overwritten, as such, it is the client's
 	// task to track and handle pairs as they require
+	// Static and dynamic proxies are kept in separate trees. Moved dynamic proxies query both trees,
+	// static proxies are only queried once against the dynamic tree when they are created, so two static
+	// proxies never form a pair. All proxy ids taken and returned by the broadphase are proxy keys.
+	// With SAP_BROADPHASE the dynamic tree is replaced by a sweep and prune: the pairs between dynamic proxies
+	// come from one sweep over the sorted proxies instead of a query per moved proxy.
+	// With GRID_BROADPHASE the dynamic tree is replaced by a hashed uniform grid, queried like the tree
 	class cBroadphase
 	{
 	public:
 		cBroadphase();
 		~cBroadphase();
+
+		// the type can only be changed while the broadphase is empty
+		void SetType(cBroadphaseType inType);
+		cBroadphaseType GetType() const { return m_type; }
 		
-		int CreateProxy(const cAABB& inAABB, void* inUserData);
+		int CreateProxy(const cAABB& inAABB, void* inUserData, cProxyType inType = DYNAMIC_PROXY);
 		
-		void DestroyProxy(int proxyID);
+		void DestroyProxy(int proxyKey);
 
-		void MoveProxy(int proxyID, const cAABB& inAABB, const cVec2& inDisplacement);
+		// dynamic proxies only, see cDynamicTree::MoveProxy. Returns true if the proxy was reinserted and will look for new pairs
+		bool MoveProxy(int proxyKey, const cAABB& inAABB, const cVec2& inDisplacement);
 		
-		void TouchProxy(int proxyID);
+		void TouchProxy(int proxyKey);
 		
-		const cAABB& GetFattenedAABB(int proxyID) const;
+		const cAABB& GetFattenedAABB(int proxyKey) const;
 		
-		void* GetUserData(int proxyID) const;
+		void* GetUserData(int proxyKey) const;
 
-		const cDynamicTree& GetTree() const;
+		const cDynamicTree& GetTree(cProxyType inType) const; // the dynamic tree is only used with TREE_BROADPHASE
+		const cSweepAndPrune& GetSweepAndPrune() const { return m_sap; } // only used with SAP_BROADPHASE
+		const cHashGrid& GetHashGrid() const { return m_grid; } // only used with GRID_BROADPHASE
+
+		// Proxies created between BeginBulkInsert and EndBulkInsert are added to their trees together with a binned SAH build.
+		// They are not found by queries before EndBulkInsert
+		void BeginBulkInsert();
+		void EndBulkInsert();
+
+		// see cDynamicTree::Rebuild and cDynamicTree::RebuildIfDegraded, these apply to both trees.
+		// Incrementally inserted static proxies get their SAH build from the next RebuildTreeIfDegraded
+		void RebuildTree();
+		bool RebuildTreeIfDegraded();
+		void SetTreeRebuildThreshold(float inThreshold);
+		// see cDynamicTree::Compact, applies to the trees. The keys of their proxies change, callback(userData, newProxyKey)
+		// is called for every proxy whose key changed. Not allowed between BeginBulkInsert and EndBulkInsert
+		void CompactTrees(ProxyRemapCallback callback);
+
+		// The fat AABB margin of the dynamic proxies. Static proxies never move and have no margin
+		void SetAABBMargin(float inMargin)
+		{
+			m_trees[DYNAMIC_PROXY].SetAABBMargin(inMargin);
+			m_sap.SetAABBMargin(inMargin);
+			m_grid.SetAABBMargin(inMargin);
+		}
+		float GetAABBMargin() const { return m_trees[DYNAMIC_PROXY].GetAABBMargin(); }
+
+		// Queries and casts of the trees read a cWideTree copy of them instead, UpdatePairs rebuilds the copies of the trees
+		// that changed. The copy of a tree that changed after UpdatePairs is not used until it is rebuilt. Off by default
+		void SetWideTreeQueries(bool inEnabled) { m_wideQueries = inEnabled; }
+		bool GetWideTreeQueries() const { return m_wideQueries; }
 
 		unsigned GetProxyCount() const;
 
-		void UpdatePairs(BroadphaseCallback callback);
+		// Queries the tree for every moved proxy, in parallel when there is a task system, and reports every new
+		// overlapping pair once. The callback is always called on the calling thread, in the same order for any number of workers.
+		// With SAP_BROADPHASE and enough moved proxies, the dynamic pairs come from a parallel sweep instead of the queries
+		void UpdatePairs(BroadphaseCallback callback, cTaskSystem* taskSystem = nullptr);
 
-		void Query(const cAABB& inAABB, QueryCallback callback);
+		// see cDynamicTree::Query, queries both trees and calls callback(proxyKey)
+		template <typename T>
+		void Query(const cAABB& inAABB, T&& callback) const;
+
+		// see cDynamicTree::RayCast, cDynamicTree::RayCastPacket and cDynamicTree::BoxCast, the callbacks get proxy keys.
+		// Both trees are cast, a ray clipped or terminated in one tree stays clipped or terminated in the other
+		template <typename T>
+		void RayCast(const cRayCastInput& inInput, T&& callback) const;
+		template <typename T>
+		void RayCastPacket(const cRayCastInput* inInputs, int inCount, T&& callback) const;
+		template <typename T>
+		void BoxCast(const cAABB& inAABB, const cRayCastInput& inInput, T&& callback) const;
 
 		void ShiftOrigin(const cVec2& inNewOrigin);
 		
 	private:
 		friend class cDynamicTree;
 
-		void BufferMove(int proxyID);
-		void UnBufferMove(int proxyID);
+		// a proxy is in the move buffer at most once, BufferMove ignores proxies that are already buffered
+		void BufferMove(int proxyKey);
+		void UnBufferMove(int proxyKey);
+		void GrowMoveIndices(int proxyKey); // makes room for proxyKey in m_moveIndices
+		bool IsBuffered(int proxyKey) const { return proxyKey < m_moveIndexCapacity && m_moveIndices[proxyKey] != null_proxy; }
+
+		void QueryMoves(int begin, int end, cPairBuffer* buffer, int worker) const;
+		bool QueryCallback(int proxyKey, int queryProxyKey, cPairBuffer* buffer) const;
+		// the dynamic pairs of the sorted entries [begin, end) with at least one moved proxy
+		void SweepPairs(int begin, int end, cPairBuffer* buffer, int worker) const;
 
-		bool QueryCallback(int proxyID);
+		// calls visitor with the cDynamicTree, cSweepAndPrune or cHashGrid holding the proxies of inType and returns its result,
+		// they share the proxy interface so the visitor is usually a generic lambda
+		template <typename F>
+		decltype(auto) VisitProxies(cProxyType inType, F&& visitor) const;
+		template <typename F>
+		decltype(auto) VisitProxies(cProxyType inType, F&& visitor);
+		// VisitProxies for queries and casts, which get the cWideTree instead of the tree while it is up to date
+		template <typename F>
+		decltype(auto) VisitQueryProxies(cProxyType inType, F&& visitor) const;
+		bool UsesTree(cProxyType inType) const { return inType == STATIC_PROXY || m_type == TREE_BROADPHASE; }
 
-		cDynamicTree m_tree;
+		cBroadphaseType m_type;
+		cDynamicTree m_trees[PROXY_TYPE_COUNT]; // indexed by cProxyType
+		cSweepAndPrune m_sap; // the dynamic proxies with SAP_BROADPHASE
+		cHashGrid m_grid; // the dynamic proxies with GRID_BROADPHASE
+		cWideTree m_wideTrees[PROXY_TYPE_COUNT]; // indexed by cProxyType, see SetWideTreeQueries
+		bool m_wideQueries;
+		bool m_sweepPairs; // set by UpdatePairs when the dynamic pairs come from the sweep
 
 		unsigned m_proxyCount;
 
@@ -59,11 +188,23 @@ namespace chiori
 		int m_moveCapacity;
 		int m_moveCount;
 
-		cPair* m_pairBuffer;
-		int m_pairCapacity;
-		int m_pairCount;
+		// keys of the proxies waiting for EndBulkInsert
+		int* m_bulkBuffer;
+		int m_bulkCapacity;
+		int m_bulkCount;
+		bool m_bulkInsert;
 
-		int m_queryProxyId;
+		// the move buffer entry of each proxy key, null_proxy for the proxies that are not buffered
+		int* m_moveIndices;
+		int m_moveIndexCapacity;
+
+		// one per worker
+		cPairBuffer* m_pairBuffers;
+		int m_pairBufferCount;
+
+		// the ranges of all workers, sorted for the merge
+		cPairRange* m_mergeRanges;
+		int m_mergeCapacity;
 	};
 
 	inline bool cPairLessThan(const cPair& pair1, const cPair& pair2)
@@ -79,14 +220,43 @@ namespace chiori
 		return false;
 	}
 
-	inline void* cBroadphase::GetUserData(int proxyId) const
+	template <typename F>
+	inline decltype(auto) cBroadphase::VisitProxies(cProxyType type, F&& visitor) const
+	{
+		if (type == DYNAMIC_PROXY && m_type == SAP_BROADPHASE)
+			return visitor(m_sap);
+		if (type == DYNAMIC_PROXY && m_type == GRID_BROADPHASE)
+			return visitor(m_grid);
+		return visitor(m_trees[type]);
+	}
+
+	template <typename F>
+	inline decltype(auto) cBroadphase::VisitProxies(cProxyType type, F&& visitor)
+	{
+		if (type == DYNAMIC_PROXY && m_type == SAP_BROADPHASE)
+			return visitor(m_sap);
+		if (type == DYNAMIC_PROXY && m_type == GRID_BROADPHASE)
+			return visitor(m_grid);
+		return visitor(m_trees[type]);
+	}
+
+	template <typename F>
+	inline decltype(auto) cBroadphase::VisitQueryProxies(cProxyType type, F&& visitor) const
 	{
-		return m_tree.GetUserData(proxyId);
+		if (m_wideQueries && UsesTree(type) && m_wideTrees[type].IsBuiltFrom(m_trees[type]))
+			return visitor(m_wideTrees[type]);
+		return VisitProxies(type, visitor);
 	}
 
-	inline const cAABB& cBroadphase::GetFattenedAABB(int proxyId) const
+	inline void* cBroadphase::GetUserData(int proxyKey) const
 	{
-		return m_tree.GetFattenedAABB(proxyId);
+		return VisitProxies(ProxyType(proxyKey), [proxyKey](const auto& proxies) { return proxies.GetUserData(ProxyID(proxyKey)); });
+	}
+
+	inline const cAABB& cBroadphase::GetFattenedAABB(int proxyKey) const
+	{
+		return VisitProxies(ProxyType(proxyKey),
+			[proxyKey](const auto& proxies) -> const cAABB& { return proxies.GetFattenedAABB(ProxyID(proxyKey)); });
 	}
 
 	inline unsigned cBroadphase::GetProxyCount() const
@@ -94,19 +264,102 @@ namespace chiori
 		return m_proxyCount;
 	}
 
-	inline void cBroadphase::Query(const cAABB& inAABB, chiori::QueryCallback callback)
+	template <typename T>
+	inline void cBroadphase::Query(const cAABB& inAABB, T&& callback) const
+	{
+		bool proceed = true;
+		for (int type = 0; type < PROXY_TYPE_COUNT && proceed; ++type)
+		{
+			auto treeCallback = [&callback, &proceed, type](int proxyId) -> bool {
+				proceed = callback(ProxyKey(proxyId, static_cast<cProxyType>(type)));
+				return proceed;
+				};
+
+			VisitQueryProxies(static_cast<cProxyType>(type), [&](const auto& proxies) { proxies.Query(inAABB, treeCallback); });
+		}
+	}
+
+	template <typename T>
+	inline void cBroadphase::RayCast(const cRayCastInput& inInput, T&& callback) const
+	{
+		BoxCast(cAABB{ inInput.origin, inInput.origin }, inInput, callback);
+	}
+
+	template <typename T>
+	inline void cBroadphase::BoxCast(const cAABB& inAABB, const cRayCastInput& inInput, T&& callback) const
 	{
-		m_tree.Query(inAABB, callback);
+		cRayCastInput input = inInput;
+		bool proceed = true;
+		for (int type = 0; type < PROXY_TYPE_COUNT && proceed; ++type)
+		{
+			auto treeCallback = [&callback, &input, &proceed, type](const cRayCastInput& subInput, int proxyId) -> float {
+				float value = callback(subInput, ProxyKey(proxyId, static_cast<cProxyType>(type)));
+				if (value == 0.0f)
+					proceed = false;
+				else if (0.0f < value && value < input.maxFraction)
+					input.maxFraction = value;
+				return value;
+				};
+
+			VisitQueryProxies(static_cast<cProxyType>(type), [&](const auto& proxies) { proxies.BoxCast(inAABB, input, treeCallback); });
+		}
+	}
+
+	template <typename T>
+	inline void cBroadphase::RayCastPacket(const cRayCastInput* inInputs, int inCount, T&& callback) const
+	{
+		cassert(0 <= inCount && inCount <= CTREE_RAY_PACKET_SIZE);
+		cRayCastInput inputs[CTREE_RAY_PACKET_SIZE];
+		for (int i = 0; i < inCount; ++i)
+			inputs[i] = inInputs[i];
+
+		for (int type = 0; type < PROXY_TYPE_COUNT; ++type)
+		{
+			auto treeCallback = [&callback, &inputs, type](const cRayCastInput& subInput, int rayIndex, int proxyId) -> float {
+				float value = callback(subInput, rayIndex, ProxyKey(proxyId, static_cast<cProxyType>(type)));
+				if (value == 0.0f)
+					inputs[rayIndex].maxFraction = -1.0f; // a negative max fraction never hits anything
+				else if (0.0f < value && value < inputs[rayIndex].maxFraction)
+					inputs[rayIndex].maxFraction = value;
+				return value;
+				};
+
+			VisitProxies(static_cast<cProxyType>(type), [&](const auto& proxies) { proxies.RayCastPacket(inputs, inCount, treeCallback); });
+		}
 	}
 
 	inline void cBroadphase::ShiftOrigin(const cVec2& newOrigin)
 	{
-		m_tree.ShiftOrigin(newOrigin);
+		m_trees[STATIC_PROXY].ShiftOrigin(newOrigin);
+		m_trees[DYNAMIC_PROXY].ShiftOrigin(newOrigin);
+		m_sap.ShiftOrigin(newOrigin);
+		m_grid.ShiftOrigin(newOrigin);
 	}
 	
-	inline const cDynamicTree& cBroadphase::GetTree() const
+	inline const cDynamicTree& cBroadphase::GetTree(cProxyType inType) const
+	{
+		return m_trees[inType];
+	}
+
+	inline void cBroadphase::RebuildTree()
+	{
+		m_trees[STATIC_PROXY].Rebuild();
+		m_trees[DYNAMIC_PROXY].Rebuild();
+	}
+
+	inline bool cBroadphase::RebuildTreeIfDegraded()
+	{
+		if (m_bulkInsert)
+			return false;
+		bool rebuiltStatic = m_trees[STATIC_PROXY].RebuildIfDegraded();
+		bool rebuiltDynamic = m_trees[DYNAMIC_PROXY].RebuildIfDegraded();
+		return rebuiltStatic || rebuiltDynamic;
+	}
+
+	inline void cBroadphase::SetTreeRebuildThreshold(float inThreshold)
 	{
-		return m_tree;
+		m_trees[STATIC_PROXY].SetRebuildThreshold(inThreshold);
+		m_trees[DYNAMIC_PROXY].SetRebuildThreshold(inThreshold);
 	}
 	
 }
\ No newline at end of file
@@ -27,6 +27,7 @@ namespace chiori
 		float angularDamping{ 0.0f };
 
 		float gravityScale{ 1.0f };
+		bool isBullet{ false };		// see cActor::IS_BULLET
 	};
 
 	class cActor
@@ -38,14 +39,15 @@ namespace chiori
 		enum // Actor flags
 		{
 			USE_GRAVITY = (1 << 0),
-			IS_DIRTY = (1 << 1)
+			IS_DIRTY = (1 << 1),
+			IS_BULLET = (1 << 2)	// continuous collision, a fast dynamic actor is stopped at its first impact with static geometry instead of tunneling through it
 		};
 
 		Flag_8 _flags = USE_GRAVITY | IS_DIRTY; // actor setting flags
 
 		cVec2 origin{ cVec2::zero };		// the body origin (not center of mass)
 		cVec2 position{ cVec2::zero };		// center of mass position in world space
-		cVec2 deltaPosition{ cVec2::zero }; // delta position for the whole time step
+		cVec2 position0{ cVec2::zero };		// center of mass position at the start of the last step, the start of the continuous collision sweep
 		cVec2 localCenter{ cVec2::zero };	// location of center of mass relative to the body origin (local space)
 		cRot rot{ cRot::iden };
 
@@ -64,11 +66,18 @@ namespace chiori
 		float angularDamping{ 0.0f };
 
 		float gravityScale{ 1.0f };
+		float minExtent{ FLT_MAX };	// the smallest distance from a shape's center to its edges, continuous collision only sweeps actors that moved further than a fraction of it
 
 		int contactList{ -1 };		// the head of the dll (-1 means an invalid head) 
 		int contactCount{ 0 };		// the number of contacts
 
 		int shapeList{ -1 };		// the ll of shapes on the actor
+
+		int islandIndex{ -1 };		// the island this actor belongs to, static and kinematic actors have no island
+		int islandPrev{ -1 };		// the dll of actors in the island
+		int islandNext{ -1 };
+		float sleepTime{ 0.0f };	// how long this actor has been below the sleep tolerances
+		bool awake{ true };			// sleeping actors are skipped by the step until their island is woken
 		
 		void* userData{ nullptr };
 
@@ -85,6 +94,7 @@ namespace chiori
 			position = origin;
 			rot = inTfm.q;
 			_flags.set(IS_DIRTY);
+			wake();
 		}
 
 		float getMass() const { return mass; }
@@ -113,22 +123,42 @@ namespace chiori
 			_flags.set(inFlags);
 		}
 
+		bool isBullet() const { return getFlags().isSet(IS_BULLET); }
+		void setBullet(bool inBullet)
+		{
+			if (inBullet)
+				_flags.set(IS_BULLET);
+			else
+				_flags.clear(IS_BULLET);
+		}
+
+		bool isAwake() const { return awake; }
+		// wakes this actor, the rest of its island is woken at the start of the next step
+		void wake()
+		{
+			awake = true;
+			sleepTime = 0.0f;
+		}
+
 		#pragma endregion
 		
 		void addForce(const cVec2& inForce)
 		{
 			forces += inForce * invMass;
+			wake();
 		}
 
 		void addTorque(float torque)
 		{
 			torques += torque * invInertia;
+			wake();
 		}
 
 		void applyImpulse(const cVec2& impulse, const cVec2& contactPoint)
 		{
 			linearVelocity += impulse * invMass;
 			angularVelocity += invInertia * cross(contactPoint - position, impulse);
+			wake();
 		}
 
 		bool operator==(const cActor& inRHS) const {
@@ -138,5 +168,7 @@ namespace chiori
 
 	};
 
+	using cActorHandle = cHandle<cActor>; // versioned reference to an actor, returned by cPhysicsWorld::CreateActor
+
 
 }
\ No newline at end of file
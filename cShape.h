@@ -7,11 +7,32 @@
 
 namespace chiori
 {
+	/*
+	* Which shapes a shape collides with, checked when the broadphase first reports a pair, before its contact is created.
+	* Two shapes with the same non zero groupIndex always collide if it is positive and never collide if it is negative.
+	* Otherwise they collide if the categoryBits of each shape are in the maskBits of the other
+	*/
+	struct cFilter
+	{
+		uint32_t categoryBits{ 0x0001 };		// the categories this shape belongs to, usually a single bit
+		uint32_t maskBits{ 0xFFFFFFFF };		// the categories this shape collides with
+		int groupIndex{ 0 };					// overrides the bits for shapes of the same group, e.g. the fragments of one actor
+	};
+
+	inline bool ShouldFiltersCollide(const cFilter& inFilterA, const cFilter& inFilterB)
+	{
+		if (inFilterA.groupIndex == inFilterB.groupIndex && inFilterA.groupIndex != 0)
+			return inFilterA.groupIndex > 0;
+
+		return (inFilterA.maskBits & inFilterB.categoryBits) != 0 && (inFilterA.categoryBits & inFilterB.maskBits) != 0;
+	}
+
 	struct ShapeConfig
 	{
 		float friction{ 0.5f };
 		float restitution{ 0.0f };
 		float density{ 1.0f };
+		cFilter filter;
 	};
 	
 	class cShape
@@ -22,18 +43,19 @@ namespace chiori
 		{
 			SCENE_QUERYABLE = (1 << 0), // this shape can be queried (either by raycasts or triggers)
 			IS_TRIGGER = (1 << 1),		// this shape is a trigger and will not participate in collision response
-			IS_STATIC = (1 << 2)		// this shape will not move during simulation time (set for broadphase optimization)
+			IS_STATIC = (1 << 2)		// this shape will not move during simulation time (set for the shapes of static actors, which go into the static broadphase tree)
 		};
 
 		int actorIndex{ -1 };		// the index of the actor that holds this shape
 		int nextShapeIndex{ -1 };	// the index of the next shape in the actor's shape linked list
-		int broadphaseIndex{ -1 };	// the index of this shape in the broadphase structure
+		int broadphaseIndex{ -1 };	// the proxy key of this shape in the broadphase structure
 		
 		cPolygon polygon;			// holds the vertices and normals of the shape
 		
 		float friction{ 0.5f };
 		float restitution{ 0.1f };
 		float density{ 1.0f };
+		cFilter filter;					// set it with cPhysicsWorld::SetShapeFilter
 		
 		cAABB aabb;						// untransformed close fit AABB
 		Flag_8 shapeFlags = SCENE_QUERYABLE;
@@ -57,6 +79,8 @@ namespace chiori
 			return this == &inRHS;
 		}
 	};
+
+	using cShapeHandle = cHandle<cShape>; // versioned reference to a shape, returned by cPhysicsWorld::CreateShape
 	
 	// this function assumes the size of the array passed in is equal to or greater than count
 	inline void cShape::getVertices(cVec2* inVertices, cTransform xf) const
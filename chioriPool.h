@@ -2,7 +2,7 @@
 
 #include "chioriAllocator.h"
 #include <utility> 
-#include <unordered_set>
+#include <cstdint>
 
 namespace chiori
 {
@@ -18,11 +18,27 @@ namespace chiori
 	{
 		unsigned index;	// Identifies the position of the object in the pool.
 		unsigned next;	// Used for maintaining the free list. When the object is allocated, next points to its own index. When free, next points to the next free slot. 
+		unsigned dense;	// Position of the object in the pool's dense array of allocated indices. Only valid while allocated.
+		unsigned generation; // Incremented every time the slot is freed, handles to a previous occupant of the slot no longer match
 	};
-	
-	/// TODO: Make the pool "stable", that is, pointers will never change, by allocating new blocks of memory in new locations and linking the blocks through meta data
-	/// This means users can keep pointers to item in the pool and be sure they will never be invalidated by the pool resizing!
 
+	/// <summary>
+	/// A versioned reference to an object in a cPool.
+	/// Unlike a raw index, a handle does not alias a new object that reuses the slot of a freed one,
+	/// as the pool increments the generation of the slot when it is freed.
+	/// A default constructed handle is never valid.
+	/// </summary>
+	/// <typeparam name="T"> The type of object the handle refers to, handles of different pools do not convert </typeparam>
+	template<typename T>
+	struct cHandle
+	{
+		int index{ -1 };
+		unsigned generation{ 0 };
+
+		bool operator==(const cHandle& inRHS) const { return index == inRHS.index && generation == inRHS.generation; }
+		bool operator!=(const cHandle& inRHS) const { return !(*this == inRHS); }
+	};
+	
 	/// <summary>
 	/// A memory pool that holds objects of type T. The pool is a contiguous block of memory that is allocated in chunks as needed.
 	/// Items are indexed and kept in contiguous memory blocks to ensure cache coherency and fast access times.
@@ -216,57 +232,86 @@ namespace chiori
 	//};
 
 
+	/// <summary>
+	/// A stable memory pool that holds objects of type T in fixed size blocks of block_size objects.
+	/// Growing the pool only allocates new blocks and grows the block table, objects never move,
+	/// so pointers to allocated objects stay valid until the object itself is freed.
+	/// Indices are still O(1) to resolve: blocks[index / block_size][index % block_size]
+	/// </summary>
+	/// <typeparam name="T"> The type of object the pool will hold </typeparam>
 	template<typename T>
 	class cPool
 	{
 	public:
 		static constexpr unsigned invalid_index = static_cast<unsigned>(-1);
+		static constexpr unsigned block_shift = 6;
+		static constexpr unsigned block_size = 1u << block_shift; // Number of objects in each block, must be a power of two
+		static constexpr unsigned block_mask = block_size - 1;
 	private:
-		T* pool;       // Pointer to the array of T
+		T** blocks;				 // Table of pointers to the fixed size blocks of T, objects never move once allocated
+		unsigned* dense;		 // Indices of all allocated objects packed into [0, p_count), used for iterating only the live objects
 		size_t       p_count;    // Number of active (allocated) objects
 		size_t       p_capacity; // Total number of objects the pool can hold
+		size_t		 b_count;	 // Number of allocated blocks
+		size_t		 b_capacity; // Size of the block table
 		unsigned     freeList;   // Index of the first free slot
 		cAllocator* allocator;	 // Custom memory allocator used to allocate and deallocate the memory block
 
+		T* GetSlot(unsigned index) const
+		{
+			return blocks[index >> block_shift] + (index & block_mask);
+		}
+
 		void GrowPool(size_t newCapacity)
 		{
 			if (newCapacity <= p_capacity) return;
 
-			// Allocate a new, larger array of T
-			T* newPool = static_cast<T*>(allocator->allocate(newCapacity * sizeof(T)));
+			size_t newBlockCount = (newCapacity + block_mask) >> block_shift;
+			newCapacity = newBlockCount << block_shift;
 
-			// Copy memory from the old array into the new one 
-			if (pool)
+			// Grow the block table, only the pointers to the blocks are copied
+			if (newBlockCount > b_capacity)
 			{
-				std::memcpy(newPool, pool, p_capacity * sizeof(T));
-				allocator->deallocate(pool, p_capacity * sizeof(T));
+				size_t newTableCapacity = newBlockCount > b_capacity * 2 ? newBlockCount : b_capacity * 2;
+				T** newBlocks = static_cast<T**>(allocator->allocate(newTableCapacity * sizeof(T*)));
+				if (blocks)
+				{
+					std::memcpy(newBlocks, blocks, b_count * sizeof(T*));
+					allocator->deallocate(blocks, b_capacity * sizeof(T*));
+				}
+				blocks = newBlocks;
+				b_capacity = newTableCapacity;
 			}
 
-			// Initialize the free slots in [p_capacity .. newCapacity-1]
-			for (size_t i = p_capacity; i < newCapacity - 1; ++i)
+			// Allocate the new blocks, existing blocks are left where they are
+			for (size_t b = b_count; b < newBlockCount; ++b)
 			{
-				newPool[i].header.index = static_cast<unsigned>(i);
-				newPool[i].header.next = static_cast<unsigned>(i + 1);
+				blocks[b] = static_cast<T*>(allocator->allocate(block_size * sizeof(T)));
 			}
-			// The very last newly added object
-			newPool[newCapacity - 1].header.index = static_cast<unsigned>(newCapacity - 1);
-			newPool[newCapacity - 1].header.next = invalid_index; // end of free list
+			b_count = newBlockCount;
 
-			// If freeList was invalid before, this means we had no free slots
-			// so the new free list starts at p_capacity
-			if (freeList == invalid_index)
+			unsigned* newDense = static_cast<unsigned*>(allocator->allocate(newCapacity * sizeof(unsigned)));
+			if (dense)
 			{
-				freeList = static_cast<unsigned>(p_capacity);
+				std::memcpy(newDense, dense, p_count * sizeof(unsigned));
+				allocator->deallocate(dense, p_capacity * sizeof(unsigned));
 			}
-			else
+			dense = newDense;
+
+			// Initialize the free slots in [p_capacity .. newCapacity-1] and push them onto the front of the free list
+			for (size_t i = p_capacity; i < newCapacity - 1; ++i)
 			{
-				// Otherwise, link the old chains last free object to the new start
-				// NOTE: Because we used to store free slots in the old pool,
-				//       we assume the last free element in the old pool was at `p_capacity - 1`.
-				newPool[p_capacity - 1].header.next = static_cast<unsigned>(p_capacity);
+				T* slot = GetSlot(static_cast<unsigned>(i));
+				slot->header.index = static_cast<unsigned>(i);
+				slot->header.next = static_cast<unsigned>(i + 1);
+				slot->header.generation = 0;
 			}
+			T* lastSlot = GetSlot(static_cast<unsigned>(newCapacity - 1));
+			lastSlot->header.index = static_cast<unsigned>(newCapacity - 1);
+			lastSlot->header.next = freeList;
+			lastSlot->header.generation = 0;
+			freeList = static_cast<unsigned>(p_capacity);
 
-			pool = newPool;
 			p_capacity = newCapacity;
 		}
 
@@ -276,7 +321,7 @@ namespace chiori
 			{
 				throw std::out_of_range("Index out of range");
 			}
-			T* obj = &pool[index];
+			T* obj = GetSlot(index);
 			// If next != index, that means this slot is not allocated
 			if (obj->header.next != obj->header.index)
 			{
@@ -287,16 +332,25 @@ namespace chiori
 
 	public:
 		cPool(cAllocator* alloc, size_t capacity = INIT_POOL_SIZE) :
-			pool{ nullptr }, p_count{ 0 }, p_capacity{ 0 }, freeList{ invalid_index }, allocator{ alloc }
+			blocks{ nullptr }, dense{ nullptr }, p_count{ 0 }, p_capacity{ 0 }, b_count{ 0 }, b_capacity{ 0 },
+			freeList{ invalid_index }, allocator{ alloc }
 		{
 			GrowPool(capacity);
 		}
 
 		~cPool()
 		{
-			if (pool)
+			for (size_t b = 0; b < b_count; ++b)
+			{
+				allocator->deallocate(blocks[b], block_size * sizeof(T));
+			}
+			if (blocks)
 			{
-				allocator->deallocate(pool, p_capacity * sizeof(T));
+				allocator->deallocate(blocks, b_capacity * sizeof(T*));
+			}
+			if (dense)
+			{
+				allocator->deallocate(dense, p_capacity * sizeof(unsigned));
 			}
 		}
 
@@ -310,18 +364,24 @@ namespace chiori
 			}
 
 			// Pop the head of the free list
-			T* obj = &pool[freeList];
+			unsigned idx = freeList;
+			T* obj = GetSlot(idx);
 			freeList = obj->header.next;
+			unsigned generation = obj->header.generation;
 
 			// Placement-new to call T constructor:
 			// This will re-construct the entire T including the header,
-			// so well forcibly overwrite the index/next immediately after.
+			// so we'll forcibly overwrite the index/next/generation immediately after.
 			new (obj) T();
 
 			// Ensure the header is in "allocated" state
-			unsigned idx = static_cast<unsigned>(obj - pool);
 			obj->header.index = idx;
 			obj->header.next = idx;  // next == index means "allocated"
+			obj->header.generation = generation;
+
+			// Append to the dense array
+			obj->header.dense = static_cast<unsigned>(p_count);
+			dense[p_count] = idx;
 
 			++p_count;
 			return obj;
@@ -343,9 +403,18 @@ namespace chiori
 			cassert(obj->header.index < p_capacity);
 			cassert(obj->header.next == obj->header.index);
 
+			// Swap the last dense entry into the freed object's spot
+			unsigned denseIndex = obj->header.dense;
+			unsigned lastIndex = dense[p_count - 1];
+			dense[denseIndex] = lastIndex;
+			GetSlot(lastIndex)->header.dense = denseIndex;
+
 			// Call the destructor
 			obj->~T();
 
+			// Invalidate all handles to this object
+			obj->header.generation += 1;
+
 			// Push the object back to the free list
 			obj->header.next = freeList;
 			freeList = obj->header.index;
@@ -356,22 +425,20 @@ namespace chiori
 		void Clear()
 		{
 			// Call the destructor on all allocated objects
-			for (size_t i = 0; i < p_capacity; ++i)
+			for (size_t i = 0; i < p_count; ++i)
 			{
-				T* obj = &pool[i];
-				if (obj->header.next == obj->header.index)
-				{
-					obj->~T();
-				}
+				T* obj = GetSlot(dense[i]);
+				obj->~T();
+				obj->header.generation += 1;
 			}
 
 			// Reset the free list
 			freeList = 0;
 			for (size_t i = 0; i < p_capacity - 1; ++i)
 			{
-				pool[i].header.next = static_cast<unsigned>(i + 1);
+				GetSlot(static_cast<unsigned>(i))->header.next = static_cast<unsigned>(i + 1);
 			}
-			pool[p_capacity - 1].header.next = invalid_index;
+			GetSlot(static_cast<unsigned>(p_capacity - 1))->header.next = invalid_index;
 
 			p_count = 0;
 		}
@@ -399,26 +466,298 @@ namespace chiori
 		{
 			if (index < 0 || static_cast<size_t>(index) >= p_capacity)
 				return false;
-			const T* obj = &pool[index];
+			const T* obj = GetSlot(static_cast<unsigned>(index));
 			return (obj->header.next == obj->header.index);
 		}
+
+		/// <summary>
+		/// Versioned handle to an allocated object, the handle stays valid until the object is freed
+		/// </summary>
+		cHandle<T> getHandle(const T* obj) const
+		{
+			if (!obj) return cHandle<T>();
+			cassert(obj->header.index < p_capacity);
+			cassert(obj->header.next == obj->header.index); // must be allocated
+			return { static_cast<int>(obj->header.index), obj->header.generation };
+		}
+
+		/// <returns> if the handle refers to a currently allocated object, never throws </returns>
+		bool isValid(cHandle<T> inHandle) const
+		{
+			if (inHandle.index < 0 || static_cast<size_t>(inHandle.index) >= p_capacity)
+				return false;
+			const T* obj = GetSlot(static_cast<unsigned>(inHandle.index));
+			return obj->header.next == obj->header.index && obj->header.generation == inHandle.generation;
+		}
+
+		/// <returns> the object the handle refers to, or nullptr if it has been freed </returns>
+		T* get(cHandle<T> inHandle)
+		{
+			return isValid(inHandle) ? GetSlot(static_cast<unsigned>(inHandle.index)) : nullptr;
+		}
+		const T* get(cHandle<T> inHandle) const
+		{
+			return isValid(inHandle) ? GetSlot(static_cast<unsigned>(inHandle.index)) : nullptr;
+		}
+
+		T* operator[](cHandle<T> inHandle)
+		{
+			if (!isValid(inHandle))
+			{
+				throw std::runtime_error("Accessing a freed object through a stale handle");
+			}
+			return GetSlot(static_cast<unsigned>(inHandle.index));
+		}
+		const T* operator[](cHandle<T> inHandle) const
+		{
+			if (!isValid(inHandle))
+			{
+				throw std::runtime_error("Accessing a freed object through a stale handle");
+			}
+			return GetSlot(static_cast<unsigned>(inHandle.index));
+		}
+
+		/// <summary>
+		/// Access by pool index without the bounds and allocation checks of operator[].
+		/// Only use this for indices that are known to be allocated, e.g. indices stored in other live objects.
+		/// </summary>
+		T* getUnchecked(int index)
+		{
+			cassert(isValid(index));
+			return GetSlot(static_cast<unsigned>(index));
+		}
+		const T* getUnchecked(int index) const
+		{
+			cassert(isValid(index));
+			return GetSlot(static_cast<unsigned>(index));
+		}
+
+		/// <summary>
+		/// Access by position in the dense array of allocated objects, denseIndex must be in [0, size()).
+		/// Freeing an object moves the last dense object into its position, so when freeing while
+		/// iterating, iterate backwards from size() - 1.
+		/// </summary>
+		T* getDense(int denseIndex)
+		{
+			cassert(0 <= denseIndex && static_cast<size_t>(denseIndex) < p_count);
+			return GetSlot(dense[denseIndex]);
+		}
+		const T* getDense(int denseIndex) const
+		{
+			cassert(0 <= denseIndex && static_cast<size_t>(denseIndex) < p_count);
+			return GetSlot(dense[denseIndex]);
+		}
+
+		/// <summary>
+		/// Iterates over the allocated objects only, in dense order.
+		/// Allocating or freeing while iterating invalidates the iterators.
+		/// </summary>
+		class iterator
+		{
+		public:
+			iterator(const cPool* inPool, const unsigned* inIt) : pool{ inPool }, it{ inIt } {}
+			T* operator*() const { return pool->GetSlot(*it); }
+			iterator& operator++() { ++it; return *this; }
+			bool operator!=(const iterator& inRHS) const { return it != inRHS.it; }
+		private:
+			const cPool* pool;
+			const unsigned* it;
+		};
+
+		class const_iterator
+		{
+		public:
+			const_iterator(const cPool* inPool, const unsigned* inIt) : pool{ inPool }, it{ inIt } {}
+			const T* operator*() const { return pool->GetSlot(*it); }
+			const_iterator& operator++() { ++it; return *this; }
+			bool operator!=(const const_iterator& inRHS) const { return it != inRHS.it; }
+		private:
+			const cPool* pool;
+			const unsigned* it;
+		};
+
+		iterator begin() { return iterator(this, dense); }
+		iterator end() { return iterator(this, dense + p_count); }
+		const_iterator begin() const { return const_iterator(this, dense); }
+		const_iterator end() const { return const_iterator(this, dense + p_count); }
 	};
 
-	// Fast lookup table for pairs of ints, used for pair lookups
-	// Just a quick wrapper around unordered_set for the purposes of the project
+	/// <summary>
+	/// Fast lookup table for pairs of indices, keyed by LOOKUP_KEY so (a, b) and (b, a) are the same pair.
+	/// A flat open addressing hash set with linear probing. Erasing shifts the following entries of the
+	/// probe run back instead of leaving tombstones, so lookups never slow down from deleted pairs.
+	/// Both indices must be >= 0, the key with all bits set is reserved as the empty slot marker.
+	/// </summary>
 	class cFLUTable
 	{
+	public:
+		static constexpr uint64_t empty_key = ~0ull;
+		static constexpr size_t min_capacity = 16;
 	private:
-		std::unordered_set<uint64_t> data;
+		uint64_t* slots;		// capacity is always a power of two
+		size_t    t_count;
+		size_t    t_capacity;
+		size_t    t_growAt;		// grow once t_count reaches this, t_capacity * maxLoadFactor
+		float     maxLoadFactor;
+		cAllocator* allocator;
+
+		static size_t Hash(uint64_t key)
+		{
+			// 64 bit finalizer, the keys are two small indices so the low bits need mixing
+			key ^= key >> 33;
+			key *= 0xff51afd7ed558ccdull;
+			key ^= key >> 33;
+			key *= 0xc4ceb9fe1a85ec53ull;
+			key ^= key >> 33;
+			return static_cast<size_t>(key);
+		}
+
+		void Rehash(size_t newCapacity)
+		{
+			uint64_t* oldSlots = slots;
+			size_t oldCapacity = t_capacity;
+
+			slots = static_cast<uint64_t*>(allocator->allocate(newCapacity * sizeof(uint64_t)));
+			for (size_t i = 0; i < newCapacity; ++i)
+				slots[i] = empty_key;
+			t_capacity = newCapacity;
+			t_growAt = static_cast<size_t>(static_cast<float>(newCapacity) * maxLoadFactor);
+
+			if (!oldSlots)
+				return;
+
+			size_t mask = t_capacity - 1;
+			for (size_t i = 0; i < oldCapacity; ++i)
+			{
+				uint64_t key = oldSlots[i];
+				if (key == empty_key)
+					continue;
+				size_t slot = Hash(key) & mask;
+				while (slots[slot] != empty_key)
+					slot = (slot + 1) & mask;
+				slots[slot] = key;
+			}
+			allocator->deallocate(oldSlots, oldCapacity * sizeof(uint64_t));
+		}
+
+		// smallest power of two capacity that holds inCount keys under the max load factor
+		size_t CapacityFor(size_t inCount) const
+		{
+			size_t capacity = min_capacity;
+			while (static_cast<size_t>(static_cast<float>(capacity) * maxLoadFactor) <= inCount)
+				capacity *= 2;
+			return capacity;
+		}
+
 	public:
+		explicit cFLUTable(cAllocator* alloc, size_t capacity = min_capacity) :
+			slots{ nullptr }, t_count{ 0 }, t_capacity{ 0 }, t_growAt{ 0 }, maxLoadFactor{ 0.5f }, allocator{ alloc }
+		{
+			Rehash(CapacityFor(capacity));
+		}
+
+		~cFLUTable()
+		{
+			if (slots)
+				allocator->deallocate(slots, t_capacity * sizeof(uint64_t));
+		}
+
+		cFLUTable(const cFLUTable&) = delete;
+		cFLUTable& operator=(const cFLUTable&) = delete;
+
 		bool insert(int a, int b) { return insertKey(LOOKUP_KEY(a, b)); }
-		bool insertKey(uint64_t key) { return data.emplace(key).second; }
-		bool contains(int a, int b) { return containsKey(LOOKUP_KEY(a, b)); }
-		bool containsKey(uint64_t key) { return data.find(key) != data.end(); }
+		bool insertKey(uint64_t key)
+		{
+			cassert(key != empty_key);
+			if (t_count + 1 > t_growAt)
+				Rehash(t_capacity * 2);
+
+			size_t mask = t_capacity - 1;
+			size_t slot = Hash(key) & mask;
+			while (slots[slot] != empty_key)
+			{
+				if (slots[slot] == key)
+					return false; // already in the table
+				slot = (slot + 1) & mask;
+			}
+			slots[slot] = key;
+			++t_count;
+			return true;
+		}
+
+		bool contains(int a, int b) const { return containsKey(LOOKUP_KEY(a, b)); }
+		bool containsKey(uint64_t key) const
+		{
+			size_t mask = t_capacity - 1;
+			size_t slot = Hash(key) & mask;
+			while (slots[slot] != empty_key)
+			{
+				if (slots[slot] == key)
+					return true;
+				slot = (slot + 1) & mask;
+			}
+			return false;
+		}
+
 		bool erase(int a, int b) { return eraseKey(LOOKUP_KEY(a, b)); }
-		bool eraseKey(uint64_t key) { return data.erase(key) > 0; }
-		void clear() { data.clear(); }
-		size_t size() const { return data.size(); }
-		bool empty() const { return data.empty(); }
+		bool eraseKey(uint64_t key)
+		{
+			size_t mask = t_capacity - 1;
+			size_t slot = Hash(key) & mask;
+			while (slots[slot] != key)
+			{
+				if (slots[slot] == empty_key)
+					return false; // not in the table
+				slot = (slot + 1) & mask;
+			}
+
+			// backward shift: move every following key of the probe run that is allowed to sit
+			// in the hole back into it, so no probe run is ever broken by the erase
+			size_t hole = slot;
+			size_t next = (hole + 1) & mask;
+			while (slots[next] != empty_key)
+			{
+				size_t home = Hash(slots[next]) & mask;
+				// the key can move into the hole if its home slot is not in (hole, next]
+				if (((next - home) & mask) >= ((next - hole) & mask))
+				{
+					slots[hole] = slots[next];
+					hole = next;
+				}
+				next = (next + 1) & mask;
+			}
+			slots[hole] = empty_key;
+			--t_count;
+			return true;
+		}
+
+		void clear()
+		{
+			for (size_t i = 0; i < t_capacity; ++i)
+				slots[i] = empty_key;
+			t_count = 0;
+		}
+
+		// makes room for inCount pairs without growing
+		void reserve(size_t inCount)
+		{
+			size_t capacity = CapacityFor(inCount);
+			if (capacity > t_capacity)
+				Rehash(capacity);
+		}
+
+		// the table doubles when it gets fuller than this, lower trades memory for shorter probe runs
+		void setMaxLoadFactor(float inLoadFactor)
+		{
+			maxLoadFactor = inLoadFactor < 0.1f ? 0.1f : (inLoadFactor > 0.9f ? 0.9f : inLoadFactor);
+			t_growAt = static_cast<size_t>(static_cast<float>(t_capacity) * maxLoadFactor);
+			if (t_count >= t_growAt)
+				Rehash(CapacityFor(t_count));
+		}
+		float getMaxLoadFactor() const { return maxLoadFactor; }
+
+		size_t size() const { return t_count; }
+		size_t capacity() const { return t_capacity; }
+		bool empty() const { return t_count == 0; }
 	};
-}
\ No newline at end of file
+}
@@ -0,0 +1,94 @@
+#pragma once
+#include <chrono>
+
+// The step profiler is on by default, define CHIORI_PROFILE as 0 to compile all of the timers
+// and counters out of step/f_step. cStepProfile still exists but is left zeroed.
+#ifndef CHIORI_PROFILE
+#define CHIORI_PROFILE 1
+#endif
+
+namespace chiori
+{
+	#define MAX_PROFILED_SOLVER_PASSES 32
+
+	/*
+	* Wall times (in milliseconds) and counters gathered over the last call to step or f_step.
+	* The profile is cleared at the start of every step, query it with cPhysicsWorld::GetProfile
+	*/
+	struct cStepProfile
+	{
+		// cPhysicsWorld::step phases
+		float step{ 0.0f };					// the entire step, includes all the phases below
+		float updateTransforms{ 0.0f };		// step 1: transforms and broadphase AABBs
+		float updatePairs{ 0.0f };			// step 2: broadphase tree rebuilds, pair finding and contact creation
+		float updateContacts{ 0.0f };		// step 3: narrowphase manifold updates and contact removal
+		float solve{ 0.0f };				// step 4: the solver, includes the solver sub-phases below
+		float continuous{ 0.0f };			// step 4b: sweeping the fast bullet actors and clamping them at their time of impact
+		float updateSleep{ 0.0f };			// step 5: island sleep timers, splitting and sleeping
+
+		// solver sub-phases
+		float prepareConstraints{ 0.0f };	// gathering the touching contacts into constraints
+		float integrateVelocities{ 0.0f };
+		float prepareContacts{ 0.0f };		// PrepareSoftContacts or PrepareContacts when using the basic solver
+		float warmStart{ 0.0f };
+		float integratePositions{ 0.0f };	// IntegratePositions + writing the solver bodies back to the actors
+		float storeImpulses{ 0.0f };
+		float solverPasses[MAX_PROFILED_SOLVER_PASSES]{};	// each contact solver pass in order, velocity passes then relax passes
+		int solverPassCount{ 0 };			// passes past MAX_PROFILED_SOLVER_PASSES are still timed in solve but not recorded here
+
+		// cFractureWorld::f_step phases, these stay zero when only step is called
+		float fractureStep{ 0.0f };			// the entire f_step, includes step
+		float fractureDetect{ 0.0f };		// finding fractors with contacts and checking their fracture stress
+		float fractureClip{ 0.0f };			// ClipVoronoiWithPolygon for all fractured actors
+		float fractureCreate{ 0.0f };		// CreateActor/CreateShape for all fragments
+		float fractureRemove{ 0.0f };		// removing the fractured actors
+
+		// counters
+		int awakeProxies{ 0 };				// proxies of awake actors checked against their fat AABB this step
+		int movedProxies{ 0 };				// proxies reinserted into the broadphase this step, movedProxies / awakeProxies is the reinsert rate
+		int treeRebuilds{ 0 };				// broadphase tree rebuilds triggered by its area ratio
+		int pairsGenerated{ 0 };			// pairs reported by the broadphase, including pairs that already had a contact
+		int pairsFiltered{ 0 };				// new pairs dropped by cPhysicsWorld::ShouldShapesCollide
+		int contactsCreated{ 0 };
+		int contactsDestroyed{ 0 };			// includes contacts destroyed by removing fractured actors
+		int gjkCalls{ 0 };
+		int gjkIterations{ 0 };				// summed over all gjkCalls
+		int awakeIslands{ 0 };				// islands simulated this step
+		int awakeActors{ 0 };				// dynamic actors simulated this step
+		int continuousActors{ 0 };			// bullet actors fast enough this step to be swept
+		int continuousHits{ 0 };			// swept bullet actors that were stopped at a time of impact
+		int solverColors{ 0 };				// constraint graph colors used by the soft solver
+		int overflowConstraints{ 0 };		// constraints that did not fit into any color and were solved serially
+		int fracturedActors{ 0 };
+		int fragmentsSpawned{ 0 };
+	};
+
+	// A simple wall clock timer, starts on construction
+	class cTimer
+	{
+	public:
+		cTimer() : m_start{ std::chrono::steady_clock::now() } {}
+
+		void reset() { m_start = std::chrono::steady_clock::now(); }
+
+		float getMilliseconds() const
+		{
+			return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - m_start).count();
+		}
+
+	private:
+		std::chrono::steady_clock::time_point m_start;
+	};
+
+#if CHIORI_PROFILE
+	#define C_PROFILE(X) X
+	#define C_PROFILE_BEGIN(timer) cTimer timer
+	#define C_PROFILE_END(timer, target) (target) += (timer).getMilliseconds()
+	#define C_PROFILE_COUNT(target, n) (target) += (n)
+#else
+	#define C_PROFILE(X)
+	#define C_PROFILE_BEGIN(timer)
+	#define C_PROFILE_END(timer, target) ((void)0)
+	#define C_PROFILE_COUNT(target, n) ((void)0)
+#endif
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+// Picks the widest float vector the compiler is allowed to use. AVX2 needs /arch:AVX2 (MSVC) or -mavx2,
+// x64 always has SSE2. Define CHIORI_DISABLE_SIMD to use the scalar fallback, which has the same interface
+#if !defined(CHIORI_DISABLE_SIMD) && defined(__AVX2__)
+	#define CHIORI_SIMD_AVX2
+	#define SIMD_WIDTH 8
+	#include <immintrin.h>
+#elif !defined(CHIORI_DISABLE_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+	#define CHIORI_SIMD_SSE2
+	#define SIMD_WIDTH 4
+	#include <emmintrin.h>
+#else
+	#define CHIORI_SIMD_SCALAR
+	#define SIMD_WIDTH 4
+#endif
+
+#define SIMD_ALIGNMENT (SIMD_WIDTH * 4)
+
+namespace chiori
+{
+	// SIMD_WIDTH floats processed together, each lane is independent
+	struct cFloatW
+	{
+#if defined(CHIORI_SIMD_AVX2)
+		__m256 v;
+#elif defined(CHIORI_SIMD_SSE2)
+		__m128 v;
+#else
+		float v[SIMD_WIDTH];
+#endif
+	};
+
+#if defined(CHIORI_SIMD_AVX2)
+	inline cFloatW wZero() { return { _mm256_setzero_ps() }; }
+	inline cFloatW wSplat(float f) { return { _mm256_set1_ps(f) }; }
+	inline cFloatW wLoad(const float* p) { return { _mm256_load_ps(p) }; } // p must be SIMD_ALIGNMENT aligned
+	inline void wStore(float* p, cFloatW a) { _mm256_store_ps(p, a.v); }
+	inline cFloatW operator+(cFloatW a, cFloatW b) { return { _mm256_add_ps(a.v, b.v) }; }
+	inline cFloatW operator-(cFloatW a, cFloatW b) { return { _mm256_sub_ps(a.v, b.v) }; }
+	inline cFloatW operator*(cFloatW a, cFloatW b) { return { _mm256_mul_ps(a.v, b.v) }; }
+	inline cFloatW wMax(cFloatW a, cFloatW b) { return { _mm256_max_ps(a.v, b.v) }; }
+	inline cFloatW wMin(cFloatW a, cFloatW b) { return { _mm256_min_ps(a.v, b.v) }; }
+	inline cFloatW wGreater(cFloatW a, cFloatW b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ) }; } // all bits set in the lanes where a > b
+	inline cFloatW wSelect(cFloatW mask, cFloatW a, cFloatW b) { return { _mm256_blendv_ps(b.v, a.v, mask.v) }; } // mask ? a : b
+	inline int wMoveMask(cFloatW mask) { return _mm256_movemask_ps(mask.v); } // bit i is set if lane i of the mask is set
+#elif defined(CHIORI_SIMD_SSE2)
+	inline cFloatW wZero() { return { _mm_setzero_ps() }; }
+	inline cFloatW wSplat(float f) { return { _mm_set1_ps(f) }; }
+	inline cFloatW wLoad(const float* p) { return { _mm_load_ps(p) }; } // p must be SIMD_ALIGNMENT aligned
+	inline void wStore(float* p, cFloatW a) { _mm_store_ps(p, a.v); }
+	inline cFloatW operator+(cFloatW a, cFloatW b) { return { _mm_add_ps(a.v, b.v) }; }
+	inline cFloatW operator-(cFloatW a, cFloatW b) { return { _mm_sub_ps(a.v, b.v) }; }
+	inline cFloatW operator*(cFloatW a, cFloatW b) { return { _mm_mul_ps(a.v, b.v) }; }
+	inline cFloatW wMax(cFloatW a, cFloatW b) { return { _mm_max_ps(a.v, b.v) }; }
+	inline cFloatW wMin(cFloatW a, cFloatW b) { return { _mm_min_ps(a.v, b.v) }; }
+	inline cFloatW wGreater(cFloatW a, cFloatW b) { return { _mm_cmpgt_ps(a.v, b.v) }; }
+	inline cFloatW wSelect(cFloatW mask, cFloatW a, cFloatW b) { return { _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v)) }; }
+	inline int wMoveMask(cFloatW mask) { return _mm_movemask_ps(mask.v); }
+#else
+	inline cFloatW wSplat(float f) { cFloatW r; for (int i = 0; i < SIMD_WIDTH; ++i) r.v[i] = f; return r; }
+	inline cFloatW wZero() { return wSplat(0.0f); }
+	inline cFloatW wLoad(const float* p) { cFloatW r; for (int i = 0; i < SIMD_WIDTH; ++i) r.v[i] = p[i]; return r; }
+	inline void wStore(float* p, cFloatW a) { for (int i = 0; i < SIMD_WIDTH; ++i) p[i] = a.v[i]; }
+	inline cFloatW operator+(cFloatW a, cFloatW b) { for (int i = 0; i < SIMD_WIDTH; ++i) a.v[i] += b.v[i]; return a; }
+	inline cFloatW operator-(cFloatW a, cFloatW b) { for (int i = 0; i < SIMD_WIDTH; ++i) a.v[i] -= b.v[i]; return a; }
+	inline cFloatW operator*(cFloatW a, cFloatW b) { for (int i = 0; i < SIMD_WIDTH; ++i) a.v[i] *= b.v[i]; return a; }
+	inline cFloatW wMax(cFloatW a, cFloatW b) { for (int i = 0; i < SIMD_WIDTH; ++i) a.v[i] = a.v[i] > b.v[i] ? a.v[i] : b.v[i]; return a; }
+	inline cFloatW wMin(cFloatW a, cFloatW b) { for (int i = 0; i < SIMD_WIDTH; ++i) a.v[i] = a.v[i] < b.v[i] ? a.v[i] : b.v[i]; return a; }
+	// the scalar mask is 1.0f or 0.0f per lane
+	inline cFloatW wGreater(cFloatW a, cFloatW b) { for (int i = 0; i < SIMD_WIDTH; ++i) a.v[i] = a.v[i] > b.v[i] ? 1.0f : 0.0f; return a; }
+	inline cFloatW wSelect(cFloatW mask, cFloatW a, cFloatW b) { for (int i = 0; i < SIMD_WIDTH; ++i) a.v[i] = mask.v[i] != 0.0f ? a.v[i] : b.v[i]; return a; }
+	inline int wMoveMask(cFloatW mask) { int bits = 0; for (int i = 0; i < SIMD_WIDTH; ++i) bits |= (mask.v[i] != 0.0f ? 1 : 0) << i; return bits; }
+#endif
+}
@@ -0,0 +1,102 @@
+#include "pch.h"
+#include "chioriTasks.h"
+#include "chioriMath.h"
+
+namespace chiori
+{
+	cThreadPool::cThreadPool(int inWorkerCount)
+	{
+		if (inWorkerCount <= 0)
+			inWorkerCount = c_max(1, static_cast<int>(std::thread::hardware_concurrency()));
+
+		threads.reserve(inWorkerCount - 1);
+		for (int i = 1; i < inWorkerCount; ++i)
+		{
+			threads.emplace_back(&cThreadPool::WorkerLoop, this, i);
+		}
+	}
+
+	cThreadPool::~cThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		wakeCondition.notify_all();
+		for (std::thread& thread : threads)
+		{
+			thread.join();
+		}
+	}
+
+	void cThreadPool::parallelFor(int count, int minRange, const cTaskFunction& task)
+	{
+		if (count <= 0)
+			return;
+
+		// a few ranges per worker so a slow range does not hold up the others
+		minRange = c_max(1, minRange);
+		int maxRanges = getWorkerCount() * 4;
+		int ranges = c_min(maxRanges, (count + minRange - 1) / minRange);
+		if (threads.empty() || ranges <= 1)
+		{
+			task(0, count, 0);
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			job = &task;
+			jobCount = count;
+			rangeSize = (count + ranges - 1) / ranges;
+			rangeCount = (count + rangeSize - 1) / rangeSize;
+			nextRange.store(0);
+			workersDone = 0;
+			++jobGeneration;
+		}
+		wakeCondition.notify_all();
+
+		RunRanges(0);
+
+		std::unique_lock<std::mutex> lock(mutex);
+		doneCondition.wait(lock, [this] { return workersDone == static_cast<int>(threads.size()); });
+		job = nullptr;
+	}
+
+	void cThreadPool::WorkerLoop(int inWorkerIndex)
+	{
+		unsigned seenGeneration = 0;
+		while (true)
+		{
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				wakeCondition.wait(lock, [&] { return stopping || jobGeneration != seenGeneration; });
+				if (stopping)
+					return;
+				seenGeneration = jobGeneration;
+			}
+
+			RunRanges(inWorkerIndex);
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				workersDone += 1;
+			}
+			doneCondition.notify_one();
+		}
+	}
+
+	void cThreadPool::RunRanges(int inWorkerIndex)
+	{
+		while (true)
+		{
+			int range = nextRange.fetch_add(1);
+			if (range >= rangeCount)
+				return;
+
+			int begin = range * rangeSize;
+			int end = c_min(begin + rangeSize, jobCount);
+			(*job)(begin, end, inWorkerIndex);
+		}
+	}
+}
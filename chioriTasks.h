@@ -0,0 +1,58 @@
+#pragma once
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <vector>
+
+namespace chiori
+{
+	// processes the items [begin, end), workerIndex is in [0, getWorkerCount()) and is unique among the ranges running at the same time
+	using cTaskFunction = std::function<void(int begin, int end, int workerIndex)>;
+
+	// interface
+	// Used by the world to run the parallel phases of a step. Implement this to run the world on your own job system,
+	// or use cThreadPool. A range must never depend on another range of the same parallelFor, so ranges can run in any order
+	struct cTaskSystem
+	{
+		virtual ~cTaskSystem() = default;
+		virtual int getWorkerCount() const = 0;
+		// splits [0, count) into ranges of at least minRange items, runs task over all of them and only returns once every range is done
+		virtual void parallelFor(int count, int minRange, const cTaskFunction& task) = 0;
+	};
+
+	// A fixed set of worker threads, the thread calling parallelFor works on the ranges too and is always worker 0
+	class cThreadPool : public cTaskSystem
+	{
+	public:
+		explicit cThreadPool(int inWorkerCount = 0); // inWorkerCount includes the calling thread, 0 uses std::thread::hardware_concurrency
+		~cThreadPool();
+
+		cThreadPool(const cThreadPool&) = delete;
+		cThreadPool& operator=(const cThreadPool&) = delete;
+
+		int getWorkerCount() const override { return static_cast<int>(threads.size()) + 1; }
+		void parallelFor(int count, int minRange, const cTaskFunction& task) override;
+
+	private:
+		void WorkerLoop(int inWorkerIndex);
+		void RunRanges(int inWorkerIndex);
+
+		std::vector<std::thread> threads;
+		std::mutex mutex;
+		std::condition_variable wakeCondition;	// a new job was posted, or the pool is stopping
+		std::condition_variable doneCondition;	// a worker finished its part of the job
+
+		// the current job, only written while no worker is running it
+		const cTaskFunction* job{ nullptr };
+		int jobCount{ 0 };
+		int rangeSize{ 0 };
+		int rangeCount{ 0 };
+		std::atomic<int> nextRange{ 0 };
+
+		unsigned jobGeneration{ 0 };	// incremented for every job, workers wake up when it changes
+		int workersDone{ 0 };			// every worker reports once per job, even if it ran no ranges
+		bool stopping{ false };
+	};
+}
@@ -15,9 +15,15 @@ namespace chiori
 	namespace commons
 	{
 		inline int GJK_ITERATIONS = 32;
+		inline int SHAPE_CAST_ITERATIONS = 20; // the maximum number of conservative advancement steps of a shape cast
 		inline int CTREE_START_CAPACITY = 32;
+		inline float CTREE_REBUILD_THRESHOLD = 1.5f; // the dynamic tree is rebuilt once GetAreaRatio grows past this factor of its value after the last rebuild, 0 disables it
 		inline float AABB_FATTEN_FACTOR = 0.05f; // This is used to fatten AABBs in the dynamic tree. 	
 		inline float LINEAR_SLOP = 0.005f;
 		inline float SPEC_DIST = 4.0f * LINEAR_SLOP;
+		inline float CCD_EXTENT_FRACTION = 0.5f;			// bullet actors that move further than this fraction of their minExtent in a step are swept for continuous collision
+		inline float LINEAR_SLEEP_TOLERANCE = 0.05f;		// actors slower than this (m/s) may fall asleep
+		inline float ANGULAR_SLEEP_TOLERANCE = 0.0349f;		// actors rotating slower than this (rad/s, ~2 degrees) may fall asleep
+		inline float TIME_TO_SLEEP = 0.5f;					// the time (s) an island has to stay below the sleep tolerances before it sleeps
 	}
 }
\ No newline at end of file
@@ -117,7 +117,7 @@ namespace chiori
 		world->p_contacts.Free(contact); // free the contact for the pool to use
 	}
 
-	void UpdateContact(cPhysicsWorld* world, cContact* contact, cShape* shapeA, cActor* bodyA, cShape* shapeB, cActor* bodyB)
+	void UpdateContact(cPhysicsWorld* world, cContact* contact, cShape* shapeA, cActor* bodyA, cShape* shapeB, cActor* bodyB, int* outGJKIterations)
 	{
 		cManifold oldManifold = contact->manifold;
 
@@ -129,16 +129,21 @@ namespace chiori
 
 		bool touching = false;
 		contact->manifold.pointCount = 0;
-		bool wasTouching = (contact->flags.isSet(cContact::ENTERED));
+		bool wasTouching = (contact->flags.isSet(cContact::TOUCHING));
+		contact->flags.clear(cContact::ENTERED | cContact::EXITED);
 
 		cTransform transformA = bodyA->getTransform();
 		cTransform transformB = bodyB->getTransform();
-		contact->manifold = CollideShapes(&shapeA->polygon, &shapeB->polygon, transformA, transformB, &contact->cache);
+		contact->manifold = CollideShapes(&shapeA->polygon, &shapeB->polygon, transformA, transformB, &contact->cache, outGJKIterations);
 
 		touching = contact->manifold.pointCount > 0;
-		if (!touching && wasTouching)
+		if (touching && !wasTouching)
 		{
-			contact->flags.clear(cContact::ENTERED);
+			contact->flags.set(cContact::ENTERED | cContact::TOUCHING);
+		}
+		else if (!touching && wasTouching)
+		{
+			contact->flags.clear(cContact::TOUCHING);
 			contact->flags.set(cContact::EXITED);
 		}
 
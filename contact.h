@@ -34,7 +34,9 @@ namespace chiori
 			OVERLAP = (1 << 0), // this contact has been created, and these two objects are being tracked as a pair in the broadphase
 			ENTERED = (1 << 1), // this contact has just entered a collision when there previously was none
 			EXITED = (1 << 2),  // this contact has just exited a pre-existing collision, but still has overlapping AABBs
-			DISJOINT = (1 << 3) // Broadphase has reported these objects have non-overlapping AABBs. This contact is marked for destruction in the current frame, and should not be used
+			DISJOINT = (1 << 3), // Broadphase has reported these objects have non-overlapping AABBs. This contact is marked for destruction in the current frame, and should not be used
+			TOUCHING = (1 << 4), // this contact has at least one manifold point, touching contacts between dynamic actors link their islands
+			UPDATED = (1 << 5) // set by the narrowphase for the contacts it updated this step, cleared again once their begin/end touch flags are applied
 		};
 		Flag_8 flags { OVERLAP };
 		cContactEdge edges[2];
@@ -47,7 +49,10 @@ namespace chiori
 		float restitution;
 	};
 
+	using cContactHandle = cHandle<cContact>; // versioned reference to a contact, contacts are destroyed when their shapes stop overlapping
+
 	void CreateContact(cPhysicsWorld* world, cShape* shapeA, cShape* shapeB);
 	void DestroyContact(cPhysicsWorld* world, cContact* contact);
-	void UpdateContact(cPhysicsWorld* world, cContact* contact, cShape* shapeA, cActor* bodyA, cShape* shapeB, cActor* bodyB);
+	// only writes to contact, so contacts can be updated in parallel. outGJKIterations is optional, see CollideShapes
+	void UpdateContact(cPhysicsWorld* world, cContact* contact, cShape* shapeA, cActor* bodyA, cShape* shapeB, cActor* bodyB, int* outGJKIterations = nullptr);
 }
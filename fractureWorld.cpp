@@ -3,12 +3,13 @@
 
 using namespace chiori;
 
-int cFractureWorld::MakeFracturable(int inActorIndex, cFractureMaterial inMaterial)
+int cFractureWorld::MakeFracturable(cActorHandle inActor, cFractureMaterial inMaterial)
 {
+	cassert(p_actors.isValid(inActor));
+	int inActorIndex = inActor.index;
 	// check if this actor is already fracturable
-	for (int i = 0; i < f_fractors.size(); i++)
+	for (const cFracturable* fractor : f_fractors)
 	{
-		const cFracturable* fractor = f_fractors[i];
 		if (fractor->actorIndex == inActorIndex)
 			return -1; // invalid make 
 	}
@@ -25,13 +26,15 @@ void cFractureWorld::MakeUnfracturable(int inFractorIndex)
 	f_fractors.Free(f_fractors[inFractorIndex]);
 }
 
-int cFractureWorld::IsFracturable(int inActorIndex)
+int cFractureWorld::IsFracturable(cActorHandle inActor)
 {
-	for (int i = 0; i < f_fractors.size(); i++)
+	if (!p_actors.isValid(inActor))
+		return -1;
+	int inActorIndex = inActor.index;
+	for (const cFracturable* fractor : f_fractors)
 	{
-		const cFracturable* fractor = f_fractors[i];
 		if (fractor->actorIndex == inActorIndex)
-			return i; // found 
+			return fractor->header.index; // found 
 	}
 	return -1;
 }
@@ -209,17 +212,19 @@ bool cFractureWorld::CreateFracturePattern(
 
 void cFractureWorld::f_step(float inFDT, int primaryIterations, int secondaryIterations, bool warmStart)
 {
+	C_PROFILE_BEGIN(fractureTimer);
 	step(inFDT, primaryIterations, secondaryIterations, warmStart);
+	C_PROFILE_BEGIN(phaseTimer);
+
 	fractorPointsMap.clear();
 	// fractor broadphase collision check, ignore all fractors unable to fracture this frame
 	std::unordered_map<int, std::vector<int>> fractorContactsMap;
-	for (int i = 0; i < f_fractors.size(); ++i)
+	for (cFracturable* fractor : f_fractors)
 	{
-		cFracturable* fractor = f_fractors[i];
 		cassert(p_actors.isValid(fractor->actorIndex));
 		cActor* actor = p_actors[fractor->actorIndex];
-		if (actor->contactCount < 1)
-			continue; // no collision here, we continue
+		if (actor->contactCount < 1 || !actor->awake)
+			continue; // no collision here or the fractor is asleep (its impulses are from before it slept), we continue
 
 		// loop through all the contacts this fractor is in
 		int contactKey = actor->contactList;
@@ -229,7 +234,7 @@ void cFractureWorld::f_step(float inFDT, int primaryIterations, int secondaryIte
 			const cManifold& manifold = contact->manifold;
 			if (manifold.pointCount > 0)
 			{
-				fractorContactsMap[i].push_back((contactKey >> 1));
+				fractorContactsMap[fractor->header.index].push_back((contactKey >> 1));
 			}
 			contactKey = contact->edges[contactKey & 1].nextKey;
 		}
@@ -245,7 +250,7 @@ void cFractureWorld::f_step(float inFDT, int primaryIterations, int secondaryIte
 		cActor* actor = p_actors[aid];
 		cFractureMaterial& mat = fractor->f_material;
 
-		const cAABB& actorAABB = GetActorAABB(aid);
+		const cAABB& actorAABB = GetActorAABB(p_actors.getHandle(actor));
 		cVec2 extents = actorAABB.getExtents();
 		float boundingRadius = extents.magnitude(); // AABB diagonal
 		float estimatedThickness = c_min(extents.x, extents.y); // Use smallest dimension
@@ -316,6 +321,8 @@ void cFractureWorld::f_step(float inFDT, int primaryIterations, int secondaryIte
 		}
 	}
 
+	C_PROFILE_END(phaseTimer, m_profile.fractureDetect);
+
 	std::vector<int> fractorsToRemove;
 	for (const auto& [fractorID, fracturePoint] : fractorPointsMap)
 	{
@@ -326,7 +333,7 @@ void cFractureWorld::f_step(float inFDT, int primaryIterations, int secondaryIte
 		cActor* actor = p_actors[aid];
 		cFractureMaterial& mat = fractor->f_material;
 
-		const cAABB& actorAABB = GetActorAABB(aid); // in world space!
+		const cAABB& actorAABB = GetActorAABB(p_actors.getHandle(actor)); // in world space!
 		const cVec2 extents = actorAABB.getExtents();
 
 		cVoronoiDiagram overlayPattern;
@@ -362,9 +369,11 @@ void cFractureWorld::f_step(float inFDT, int primaryIterations, int secondaryIte
 		s_config.density = actorShape->density;
 		s_config.friction = actorShape->friction;
 		s_config.restitution = actorShape->restitution;
+		s_config.filter = actorShape->filter;
 		ActorConfig a_config;
 		a_config.type = cActorType::DYNAMIC;
 		a_config.gravityScale = actor->gravityScale;
+		a_config.isBullet = actor->isBullet(); // fragments of a bullet can be as fast and are smaller, so they stay bullets
 
 		const cPolygon& actorPoly = actorShape->polygon;
 		// we need to rotate the polygon but keep the relative positions of the vertices around local 0,0
@@ -376,7 +385,9 @@ void cFractureWorld::f_step(float inFDT, int primaryIterations, int secondaryIte
 			localPoly.vertices[i] = actorPoly.vertices[i].rotated(actorRot);
 			localPoly.normals[i] = actorPoly.normals[i].rotated(actorRot);
 		}
+		C_PROFILE(phaseTimer.reset());
 		std::vector<std::vector<cVec2>> fragments = ClipVoronoiWithPolygon(overlayPattern, localPoly.vertices, localPoly.normals, localPoly.count);
+		C_PROFILE_END(phaseTimer, m_profile.fractureClip);
 		
 		if (fragments.size() == 0)
 		{
@@ -384,6 +395,8 @@ void cFractureWorld::f_step(float inFDT, int primaryIterations, int secondaryIte
 			continue; // no fragments, ignore
 		}
 
+		C_PROFILE(phaseTimer.reset());
+
 		for (const auto& fragment : fragments)
 		{
 			//// get centriod + actors pos to get new starting pos
@@ -401,19 +414,28 @@ void cFractureWorld::f_step(float inFDT, int primaryIterations, int secondaryIte
 			a_config.angularVelocity = actorAngVel * dampFactor;
 
 			// adds new actor into world
-			int newActorIndex = CreateActor(a_config);
+			cActorHandle newActor = CreateActor(a_config);
 			cPolygon fragShape{ fragment.data(), static_cast<int>(fragment.size()) };
-			CreateShape(newActorIndex, s_config, &fragShape);
+			CreateShape(newActor, s_config, &fragShape);
 		}
+
+		C_PROFILE_END(phaseTimer, m_profile.fractureCreate);
+		C_PROFILE_COUNT(m_profile.fragmentsSpawned, static_cast<int>(fragments.size()));
 	}
 
+	C_PROFILE(phaseTimer.reset());
+
 	for (const auto& fractorID : fractorsToRemove)
 	{
-		int actorIndex = f_fractors[fractorID]->actorIndex;
+		cActorHandle actorHandle = p_actors.getHandle(p_actors[f_fractors[fractorID]->actorIndex]);
 		MakeUnfracturable(fractorID);
-		RemoveActor(actorIndex);
+		RemoveActor(actorHandle);
 	}
 
+	C_PROFILE_END(phaseTimer, m_profile.fractureRemove);
+	C_PROFILE_COUNT(m_profile.fracturedActors, static_cast<int>(fractorsToRemove.size()));
+	C_PROFILE_END(fractureTimer, m_profile.fractureStep);
+
 	// loop through all fracturing fractors, as above
 	//  loop through each collision manifold
 	//   merge all the collision points to find 1 primary collision position, skewing the average based on the points with the most impact force
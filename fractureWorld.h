@@ -59,9 +59,9 @@ namespace chiori
 		cPool<cFracturable> f_fractors;
 		std::unordered_map<int, cVec2> fractorPointsMap;
 
-		int MakeFracturable(int inActorIndex, cFractureMaterial inMaterial); // turn a regular actor into a fracturable object
+		int MakeFracturable(cActorHandle inActor, cFractureMaterial inMaterial); // turn a regular actor into a fracturable object
 		void MakeUnfracturable(int inFractorIndex);
-		int IsFracturable(int inActorIndex);	// returns the index of the fractor if this actor is a fractor, -1 elsewise
+		int IsFracturable(cActorHandle inActor);	// returns the index of the fractor if this actor is a fractor, -1 elsewise
 		void SetFracturePattern(int inPatternIndex, int inFractorIndex);
 		
 		static bool CreateFracturePattern(cFracturePattern& outPattern, const cVoronoiDiagram& inDiagram, const cAABB& inBounds, bool shift = true);
@@ -74,9 +74,8 @@ namespace chiori
 		bool CheckDupePattern(const cVoronoiDiagram& inPattern)
 		{
 			// check if this pattern is already loaded in
-			for (int i = 0; i < f_patterns.size(); i++)
+			for (const cFracturePattern* f_pattern : f_patterns)
 			{
-				const cFracturePattern* f_pattern = f_patterns[i];
 				const cVoronoiDiagram& ovd = f_pattern->pattern;
 				const cVoronoiDiagram& vd = inPattern;
 
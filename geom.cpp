@@ -485,4 +485,50 @@ namespace chiori
 
 		return massData;
 	}
+
+	cRayCastOutput RayCastPolygon(const cRayCastInput& inInput, const cPolygon& inPolygon)
+	{
+		// Clip the ray against every edge's half plane, the ray enters the polygon at the largest entering fraction
+		float lower = 0.0f;
+		float upper = inInput.maxFraction;
+		int index = -1;
+
+		cRayCastOutput output;
+		for (int i = 0; i < inPolygon.count; ++i)
+		{
+			// p = origin + t * translation is inside the half plane if dot(normal, vertex - p) >= 0
+			float numerator = dot(inPolygon.normals[i], inPolygon.vertices[i] - inInput.origin);
+			float denominator = dot(inPolygon.normals[i], inInput.translation);
+
+			if (denominator == 0.0f)
+			{
+				// parallel to the edge and outside of it
+				if (numerator < 0.0f)
+					return output;
+			}
+			else if (denominator < 0.0f && numerator < lower * denominator)
+			{
+				// the ray enters this half plane later than the others
+				lower = numerator / denominator;
+				index = i;
+			}
+			else if (denominator > 0.0f && numerator < upper * denominator)
+			{
+				// the ray leaves this half plane earlier than the others
+				upper = numerator / denominator;
+			}
+
+			if (upper < lower)
+				return output;
+		}
+
+		if (index >= 0)
+		{
+			output.fraction = lower;
+			output.normal = inPolygon.normals[index];
+			output.point = inInput.origin + lower * inInput.translation;
+			output.hit = true;
+		}
+		return output;
+	}
 }
\ No newline at end of file
@@ -42,6 +42,26 @@ namespace chiori
 		const cVec2& GetNormal(int index) const { return normals[index]; }
 	};
 	
+	// A ray from origin to origin + translation, hits past maxFraction * translation are ignored
+	struct cRayCastInput
+	{
+		cVec2 origin{ cVec2::zero };
+		cVec2 translation{ cVec2::zero };
+		float maxFraction{ 1.0f };
+	};
+
+	// The hit point is origin + fraction * translation
+	struct cRayCastOutput
+	{
+		cVec2 point{ cVec2::zero };
+		cVec2 normal{ cVec2::zero };
+		float fraction{ 0.0f };
+		bool hit{ false };
+	};
+
+	// Casts a ray against a polygon, the ray is in the polygon's local space. A ray starting inside the polygon does not hit it
+	cRayCastOutput RayCastPolygon(const cRayCastInput& inInput, const cPolygon& inPolygon);
+	
 	// helper functions
 	cPolygon GeomMakeRegularPolygon(int count);
 	cPolygon GeomMakeSquare(float h);
@@ -75,6 +75,10 @@ namespace chiori
 				v->l = 0.0f;
 			}
 
+			// the sub algorithm only computes the weights of 2 and 3 point simplices, a single point has all the weight
+			if (s_size == 1)
+				m1.l = 1.0f;
+
 			// Compute the new simplex metric, if it is substantially different than
 			// old metric then flush the simplex.
 			if (s_size > 1)
@@ -518,4 +522,49 @@ namespace chiori
 		ComputeWitnessPoints(polytope, closestEdge, output.pointA, output.pointB);
 	}
 	#pragma endregion
+
+	#pragma region Shape Cast
+	void cShapeCast(const cShapeCastInput& input, cShapeCastOutput& output)
+	{
+		output = cShapeCastOutput();
+
+		const float target = commons::LINEAR_SLOP;
+		const float tolerance = 0.25f * commons::LINEAR_SLOP;
+
+		cGJKInput distanceInput{ input.proxyA, input.proxyB, input.transformA, input.transformB };
+		cGJKOutput distanceOutput;
+		cGJKCache cache;
+		cache.metric = 0.0f;
+		cache.count = 0;
+
+		float t = 0.0f;
+		for (int itr = 0; itr < commons::SHAPE_CAST_ITERATIONS; ++itr)
+		{
+			distanceInput.transformA.p = input.transformA.p + t * input.translation;
+			cGJK(distanceInput, distanceOutput, &cache);
+			output.iterations = itr + 1;
+
+			float distance = distanceOutput.distance;
+			if (distance < target + tolerance)
+			{
+				output.hit = true;
+				output.fraction = t;
+				output.point = distanceOutput.pointB;
+				if (distance > LEPSILON)
+					output.normal = (distanceOutput.pointA - distanceOutput.pointB) / distance;
+				return;
+			}
+
+			// proxyA closes the gap along the separating normal at this speed, the distance can not shrink any faster
+			cVec2 normal = (distanceOutput.pointB - distanceOutput.pointA) / distance;
+			float approach = dot(input.translation, normal);
+			if (approach <= 0.0f)
+				return; // moving away from or parallel to proxyB, a translating convex shape can not turn back
+
+			t += (distance - target) / approach;
+			if (t > input.maxFraction)
+				return;
+		}
+	}
+	#pragma endregion
 }
\ No newline at end of file
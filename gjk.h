@@ -59,6 +59,31 @@ namespace chiori
         unsigned indexB[3]; // supporting on shape B (target)
     };
 
+    /*
+    * Input for the shape cast, proxyA moves by translation (without rotating) and proxyB stays in place
+    */
+    struct cShapeCastInput
+    {
+        cGJKProxy proxyA;       // the moving proxy
+        cGJKProxy proxyB;       // the target proxy
+        cTransform transformA;  // the transform of the moving proxy at the start of the cast
+        cTransform transformB;  // the transform of the target proxy
+        cVec2 translation;      // the movement of proxyA over the whole cast
+        float maxFraction = 1.0f;   // only hits up to maxFraction * translation are reported
+    };
+
+    /*
+    * Output for the shape cast
+    */
+    struct cShapeCastOutput
+    {
+        cVec2 point{ cVec2::zero };     // the closest point on proxyB at the time of impact
+        cVec2 normal{ cVec2::zero };    // the surface normal of proxyB at point, pointing towards proxyA. Zero if the proxies start overlapping
+        float fraction{ 0.0f };         // proxyA touches proxyB after moving by fraction * translation
+        int iterations{ 0 };            // the number of GJK distance calls
+        bool hit{ false };
+    };
+
     inline const cVec2& cGJKProxy::GetVertex(int index) const
     {
         cassert(0 <= index && index < m_count);
@@ -84,4 +109,8 @@ namespace chiori
     void cGJK(const cGJKInput& input, cGJKOutput& output, cGJKCache* cache);
 
     void cEPA(const cGJKInput& input, cGJKOutput& output, cGJKCache* cache); // TODO: Very unstable, unsure why
+
+    // Conservative advancement: proxyA is moved towards proxyB by its GJK distance divided by the closing speed along the
+    // separating normal, which can never pass the time of impact. Proxies closer than commons::LINEAR_SLOP count as touching
+    void cShapeCast(const cShapeCastInput& input, cShapeCastOutput& output);
 }
\ No newline at end of file
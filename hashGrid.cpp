@@ -0,0 +1,342 @@
+#include "pch.h"
+#include "hashGrid.h"
+
+namespace chiori
+{
+	cHashGrid::cHashGrid()
+	{
+		m_proxyCapacity = 0;
+		m_proxyCount = 0;
+		m_proxies = nullptr;
+		m_freeList = null_node;
+
+		m_cellCount = 0;
+		m_cellCapacity = 0;
+		m_cells = nullptr;
+
+		m_tableCapacity = 64;
+		m_table = new int[m_tableCapacity];
+		for (int i = 0; i < m_tableCapacity; ++i)
+			m_table[i] = null_node;
+
+		m_entryCount = 0;
+		m_entryCapacity = 0;
+		m_liveEntryCount = 0;
+		m_entries = nullptr;
+		m_freeEntry = null_node;
+
+		// the fat AABBs come from the grid, the tree only stores the oversized ones
+		m_tree.SetAABBMargin(0.0f);
+
+		m_cellSize = 1.0f;
+		m_invCellSize = 1.0f;
+		m_sizedProxyCount = 0;
+		m_aabbMargin = commons::AABB_FATTEN_FACTOR;
+	}
+
+	cHashGrid::~cHashGrid()
+	{
+		delete[] m_entries;
+		delete[] m_table;
+		delete[] m_cells;
+		delete[] m_proxies;
+	}
+
+	int cHashGrid::InsertProxy(const cAABB& aabb, void* userData)
+	{
+		if (m_freeList == null_node)
+		{
+			int oldCapacity = m_proxyCapacity;
+			GrowBuffer(m_proxies, m_proxyCapacity, m_proxyCount, m_proxyCount + 1);
+			for (int i = oldCapacity; i < m_proxyCapacity - 1; ++i)
+				m_proxies[i].next = i + 1;
+			m_proxies[m_proxyCapacity - 1].next = null_node;
+			m_freeList = oldCapacity;
+		}
+
+		int proxyID = m_freeList;
+		cGridProxy* proxy = m_proxies + proxyID;
+		m_freeList = proxy->next;
+		++m_proxyCount;
+
+		cVec2 fat{ m_aabbMargin, m_aabbMargin };
+		proxy->aabb.min = aabb.min - fat;
+		proxy->aabb.max = aabb.max + fat;
+		proxy->userData = userData;
+		AddProxy(proxyID);
+
+		return proxyID;
+	}
+
+	void cHashGrid::DestroyProxy(int proxyID)
+	{
+		cassert(0 <= proxyID && proxyID < m_proxyCapacity);
+		cassert(0 < m_proxyCount);
+
+		RemoveProxy(proxyID);
+
+		cGridProxy* proxy = m_proxies + proxyID;
+		proxy->userData = nullptr;
+		proxy->next = m_freeList;
+		m_freeList = proxyID;
+		--m_proxyCount;
+	}
+
+	bool cHashGrid::MoveProxy(int proxyID, const cAABB& aabb, const cVec2& disp)
+	{
+		cassert(0 <= proxyID && proxyID < m_proxyCapacity);
+
+		// The same fat AABB as cDynamicTree::MoveProxy, with the margin and the predicted displacement
+		cVec2 fat{ m_aabbMargin, m_aabbMargin };
+		cAABB b = aabb;
+		b.min = b.min - fat;
+		b.max = b.max + fat;
+
+		cVec2 pdisp = disp * CTREE_DISPLACEMENT_MULTIPLIER;
+
+		if (pdisp.x < 0.0f)
+		{
+			b.min.x += pdisp.x;
+		}
+		else
+		{
+			b.max.x += pdisp.x;
+		}
+
+		if (pdisp.y < 0.0f)
+		{
+			b.min.y += pdisp.y;
+		}
+		else
+		{
+			b.max.y += pdisp.y;
+		}
+
+		cGridProxy* proxy = m_proxies + proxyID;
+		if (proxy->aabb.contains(aabb))
+		{
+			cVec2 huge = fat * CTREE_HUGE_MARGIN_MULTIPLIER;
+			cAABB hugeAABB;
+			hugeAABB.min = b.min - huge;
+			hugeAABB.max = b.max + huge;
+			if (hugeAABB.contains(proxy->aabb))
+			{
+				return false;
+			}
+		}
+
+		// Only proxies that changed cells are taken out of their cells
+		bool sameCells = proxy->treeID == null_node &&
+			CellCoord(b.min.x) == proxy->minX && CellCoord(b.min.y) == proxy->minY &&
+			CellCoord(b.max.x) == proxy->maxX && CellCoord(b.max.y) == proxy->maxY;
+		if (sameCells)
+		{
+			proxy->aabb = b;
+			return true;
+		}
+
+		RemoveProxy(proxyID);
+		proxy->aabb = b;
+		AddProxy(proxyID);
+		return true;
+	}
+
+	void cHashGrid::AddProxy(int proxyID)
+	{
+		cGridProxy* proxy = m_proxies + proxyID;
+		proxy->minX = CellCoord(proxy->aabb.min.x);
+		proxy->minY = CellCoord(proxy->aabb.min.y);
+		proxy->maxX = CellCoord(proxy->aabb.max.x);
+		proxy->maxY = CellCoord(proxy->aabb.max.y);
+
+		long long cellCount = static_cast<long long>(proxy->maxX - proxy->minX + 1) * static_cast<long long>(proxy->maxY - proxy->minY + 1);
+		if (cellCount > CGRID_MAX_PROXY_CELLS)
+		{
+			proxy->treeID = m_tree.InsertProxy(proxy->aabb, reinterpret_cast<void*>(static_cast<intptr_t>(proxyID)));
+			return;
+		}
+
+		proxy->treeID = null_node;
+		for (int y = proxy->minY; y <= proxy->maxY; ++y)
+		{
+			for (int x = proxy->minX; x <= proxy->maxX; ++x)
+			{
+				int cellIndex = FindOrCreateCell(x, y);
+
+				if (m_freeEntry == null_node)
+				{
+					GrowBuffer(m_entries, m_entryCapacity, m_entryCount, m_entryCount + 1);
+					m_freeEntry = m_entryCount++;
+					m_entries[m_freeEntry].next = null_node;
+				}
+
+				int entry = m_freeEntry;
+				m_freeEntry = m_entries[entry].next;
+				m_entries[entry].proxyID = proxyID;
+				m_entries[entry].next = m_cells[cellIndex].head;
+				m_cells[cellIndex].head = entry;
+				++m_liveEntryCount;
+			}
+		}
+	}
+
+	void cHashGrid::RemoveProxy(int proxyID)
+	{
+		cGridProxy* proxy = m_proxies + proxyID;
+		if (proxy->treeID != null_node)
+		{
+			m_tree.DestroyProxy(proxy->treeID);
+			proxy->treeID = null_node;
+			return;
+		}
+
+		for (int y = proxy->minY; y <= proxy->maxY; ++y)
+		{
+			for (int x = proxy->minX; x <= proxy->maxX; ++x)
+			{
+				int cellIndex = FindCell(x, y);
+				cassert(cellIndex != null_node);
+
+				int* link = &m_cells[cellIndex].head;
+				while (*link != null_node && m_entries[*link].proxyID != proxyID)
+					link = &m_entries[*link].next;
+				cassert(*link != null_node);
+
+				int entry = *link;
+				*link = m_entries[entry].next;
+				m_entries[entry].next = m_freeEntry;
+				m_freeEntry = entry;
+				--m_liveEntryCount;
+			}
+		}
+	}
+
+	int cHashGrid::FindOrCreateCell(int x, int y)
+	{
+		int cellIndex = FindCell(x, y);
+		if (cellIndex != null_node)
+			return cellIndex;
+
+		// keep the table at most half full
+		if (2 * (m_cellCount + 1) > m_tableCapacity)
+			GrowTable();
+
+		GrowBuffer(m_cells, m_cellCapacity, m_cellCount, m_cellCount + 1);
+		cellIndex = m_cellCount++;
+		m_cells[cellIndex] = { x, y, null_node };
+
+		unsigned mask = static_cast<unsigned>(m_tableCapacity - 1);
+		unsigned slot = (static_cast<unsigned>(x) * 73856093u ^ static_cast<unsigned>(y) * 19349663u) & mask;
+		while (m_table[slot] != null_node)
+			slot = (slot + 1) & mask;
+		m_table[slot] = cellIndex;
+		return cellIndex;
+	}
+
+	void cHashGrid::GrowTable()
+	{
+		delete[] m_table;
+		m_tableCapacity *= 2;
+		m_table = new int[m_tableCapacity];
+		for (int i = 0; i < m_tableCapacity; ++i)
+			m_table[i] = null_node;
+
+		unsigned mask = static_cast<unsigned>(m_tableCapacity - 1);
+		for (int i = 0; i < m_cellCount; ++i)
+		{
+			unsigned slot = (static_cast<unsigned>(m_cells[i].x) * 73856093u ^ static_cast<unsigned>(m_cells[i].y) * 19349663u) & mask;
+			while (m_table[slot] != null_node)
+				slot = (slot + 1) & mask;
+			m_table[slot] = i;
+		}
+	}
+
+	void cHashGrid::RebuildCells()
+	{
+		// Drop all the cells and add every proxy back at the current cell size
+		m_cellCount = 0;
+		for (int i = 0; i < m_tableCapacity; ++i)
+			m_table[i] = null_node;
+		m_entryCount = 0;
+		m_liveEntryCount = 0;
+		m_freeEntry = null_node;
+
+		bool* isFree = new bool[m_proxyCapacity]();
+		MarkFreeProxies(isFree);
+		for (int i = 0; i < m_proxyCapacity; ++i)
+		{
+			if (isFree[i])
+				continue;
+
+			if (m_proxies[i].treeID != null_node)
+			{
+				m_tree.DestroyProxy(m_proxies[i].treeID);
+				m_proxies[i].treeID = null_node;
+			}
+			AddProxy(i);
+		}
+		delete[] isFree;
+	}
+
+	bool cHashGrid::UpdateCellSize()
+	{
+		bool countChanged = m_proxyCount >= 2 * m_sizedProxyCount || 2 * m_proxyCount <= m_sizedProxyCount;
+		if (m_proxyCount == 0 || !countChanged)
+		{
+			// empty cells pile up where proxies have been, drop them once they outnumber the entries
+			if (m_cellCount > 4 * (m_liveEntryCount + 16))
+			{
+				RebuildCells();
+				return true;
+			}
+			return false;
+		}
+		m_sizedProxyCount = m_proxyCount;
+
+		// the median of the largest side of the fat AABBs
+		float* extents = new float[m_proxyCount];
+		bool* isFree = new bool[m_proxyCapacity]();
+		MarkFreeProxies(isFree);
+
+		int count = 0;
+		for (int i = 0; i < m_proxyCapacity; ++i)
+		{
+			if (!isFree[i])
+			{
+				cVec2 size = m_proxies[i].aabb.max - m_proxies[i].aabb.min;
+				extents[count++] = c_max(size.x, size.y);
+			}
+		}
+		std::nth_element(extents, extents + count / 2, extents + count);
+		float median = extents[count / 2];
+		delete[] isFree;
+		delete[] extents;
+
+		if (median <= 0.0f || fabsf(median - m_cellSize) <= CGRID_CELL_SIZE_TOLERANCE * m_cellSize)
+			return false;
+
+		m_cellSize = median;
+		m_invCellSize = 1.0f / median;
+		RebuildCells();
+		return true;
+	}
+
+	void cHashGrid::MarkFreeProxies(bool* isFree) const
+	{
+		// the free list is threaded through the proxies, everything else is allocated
+		for (int i = m_freeList; i != null_node; i = m_proxies[i].next)
+			isFree[i] = true;
+	}
+
+	void cHashGrid::ShiftOrigin(const cVec2& newOrigin)
+	{
+		for (int i = 0; i < m_proxyCapacity; ++i)
+		{
+			m_proxies[i].aabb.min -= newOrigin;
+			m_proxies[i].aabb.max -= newOrigin;
+		}
+
+		// the cell coordinates change with the origin
+		RebuildCells();
+	}
+}
@@ -0,0 +1,278 @@
+#pragma once
+
+#include "aabbtree.h"
+
+namespace chiori
+{
+	#define CGRID_MAX_PROXY_CELLS 16 // proxies whose fat AABB covers more cells are kept in the grid's tree instead
+	#define CGRID_CELL_SIZE_TOLERANCE 0.25f // the cells are rebuilt once the median proxy extent is this fraction away from the cell size
+
+	struct cGridProxy
+	{
+		cAABB aabb;					// the fat AABB
+		void* userData{ nullptr };
+		union
+		{
+			int treeID;				// the proxy id in the tree of oversized proxies, null_node for proxies in the cells
+			int next;				// the next free proxy
+		};
+		int minX, minY;				// the range of cells the proxy is in, inclusive
+		int maxX, maxY;
+	};
+
+	struct cGridCell
+	{
+		int x, y;
+		int head;					// the first cGridEntry of the cell, null_node for an empty cell
+	};
+
+	// a proxy in one cell, the entries of a cell form a singly linked list
+	struct cGridEntry
+	{
+		int proxyID;
+		int next;
+	};
+
+	/*
+	* A uniform grid hashed by cell coordinates, for many proxies of similar size in a bounded region such as fracture debris.
+	* A proxy is added to every cell its fat AABB touches, proxies touching more than CGRID_MAX_PROXY_CELLS cells go into a
+	* cDynamicTree instead. The cell size follows the median proxy extent, see UpdateCellSize. Queries report every proxy once
+	* without sorting: a proxy is only reported from the cell holding the min corner of its overlap with the query AABB.
+	* It has the proxy interface of cDynamicTree (fat AABBs, MoveProxy, Query, casts) so that cBroadphase can use it
+	* in place of the dynamic tree
+	*/
+	class cHashGrid
+	{
+	public:
+		cHashGrid();
+		~cHashGrid();
+
+		cHashGrid(const cHashGrid&) = delete;
+		cHashGrid& operator=(const cHashGrid&) = delete;
+
+		int InsertProxy(const cAABB& inAABB, void* inUserData);
+		void DestroyProxy(int inProxyID);
+		// see cDynamicTree::MoveProxy, returns true if the fat AABB was updated
+		bool MoveProxy(int inProxyID, const cAABB& inAABB, const cVec2& inDisplacement);
+
+		void SetAABBMargin(float inMargin) { m_aabbMargin = inMargin; }
+		float GetAABBMargin() const { return m_aabbMargin; }
+
+		void* GetUserData(int inProxyID) const;
+		const cAABB& GetFattenedAABB(int inProxyID) const;
+
+		int GetProxyCapacity() const { return m_proxyCapacity; } // every proxy id is below this
+		int GetProxyCount() const { return m_proxyCount; }
+
+		// Resizes the cells to the median proxy extent once the proxy count has doubled or halved since the last resize
+		// and the median moved past CGRID_CELL_SIZE_TOLERANCE. Also drops the empty cells once they outnumber the entries.
+		// Returns true if the cells were rebuilt
+		bool UpdateCellSize();
+		float GetCellSize() const { return m_cellSize; }
+		int GetCellCount() const { return m_cellCount; }
+		const cDynamicTree& GetTree() const { return m_tree; } // the oversized proxies
+
+		// see cDynamicTree::Query, cDynamicTree::RayCast, cDynamicTree::BoxCast and cDynamicTree::RayCastPacket.
+		// The casts test every proxy in the cells of the swept bounds, the packet casts its rays one at a time
+		template <typename T>
+		void Query(const cAABB& inAABB, T&& callback) const;
+		template <typename T>
+		void RayCast(const cRayCastInput& inInput, T&& callback) const;
+		template <typename T>
+		void BoxCast(const cAABB& inAABB, const cRayCastInput& inInput, T&& callback) const;
+		template <typename T>
+		void RayCastPacket(const cRayCastInput* inInputs, int inCount, T&& callback) const;
+
+		// The shift formula is: position -= newOrigin
+		void ShiftOrigin(const cVec2& newOrigin);
+
+	private:
+		int CellCoord(float inValue) const;
+		int FindCell(int inX, int inY) const; // null_node if the cell does not exist
+		int FindOrCreateCell(int inX, int inY);
+		void GrowTable();
+
+		// adds the proxy to the cells of its fat AABB or to the tree
+		void AddProxy(int inProxyID);
+		void RemoveProxy(int inProxyID);
+		void RebuildCells();
+		void MarkFreeProxies(bool* outIsFree) const; // outIsFree has m_proxyCapacity entries, all false
+
+		template <typename T>
+		void CastAABB(const cRayCastInput& inInput, const cVec2& inExtents, T&& callback) const;
+
+		cGridProxy* m_proxies;
+		int m_proxyCapacity;
+		int m_proxyCount;
+		int m_freeList;
+
+		cGridCell* m_cells;
+		int m_cellCount;
+		int m_cellCapacity;
+
+		int* m_table;				// open addressing, cell indices hashed by cell coordinates
+		int m_tableCapacity;		// a power of two
+
+		cGridEntry* m_entries;
+		int m_entryCount;			// entries ever used, including the free ones
+		int m_entryCapacity;
+		int m_liveEntryCount;
+		int m_freeEntry;
+
+		cDynamicTree m_tree;		// the oversized proxies, its user data is the grid proxy id
+
+		float m_cellSize;
+		float m_invCellSize;
+		int m_sizedProxyCount;		// the proxy count at the last UpdateCellSize resize
+		float m_aabbMargin;
+	};
+
+	inline void* cHashGrid::GetUserData(int proxyID) const
+	{
+		if (0 <= proxyID && proxyID < m_proxyCapacity)
+		{
+			return m_proxies[proxyID].userData;
+		}
+		throw std::out_of_range("Index out of range for hash grid");
+	}
+
+	inline const cAABB& cHashGrid::GetFattenedAABB(int proxyID) const
+	{
+		if (0 <= proxyID && proxyID < m_proxyCapacity)
+		{
+			return m_proxies[proxyID].aabb;
+		}
+		throw std::out_of_range("Index out of range for hash grid");
+	}
+
+	inline int cHashGrid::CellCoord(float value) const
+	{
+		// clamped so that far away proxies do not overflow the cell coordinates
+		float cell = floorf(value * m_invCellSize);
+		return static_cast<int>(c_max(-1e9f, c_min(cell, 1e9f)));
+	}
+
+	inline int cHashGrid::FindCell(int x, int y) const
+	{
+		unsigned mask = static_cast<unsigned>(m_tableCapacity - 1);
+		unsigned slot = (static_cast<unsigned>(x) * 73856093u ^ static_cast<unsigned>(y) * 19349663u) & mask;
+		while (m_table[slot] != null_node)
+		{
+			const cGridCell& cell = m_cells[m_table[slot]];
+			if (cell.x == x && cell.y == y)
+				return m_table[slot];
+			slot = (slot + 1) & mask;
+		}
+		return null_node;
+	}
+
+	template <typename T>
+	inline void cHashGrid::Query(const cAABB& inAABB, T&& callback) const
+	{
+		int minX = CellCoord(inAABB.min.x), minY = CellCoord(inAABB.min.y);
+		int maxX = CellCoord(inAABB.max.x), maxY = CellCoord(inAABB.max.y);
+
+		// a proxy overlapping inAABB is in every cell of the overlap, it is only reported from the cell of the overlap's min corner
+		auto queryCell = [&](const cGridCell& cell) -> bool {
+			for (int entry = cell.head; entry != null_node; entry = m_entries[entry].next)
+			{
+				int proxyID = m_entries[entry].proxyID;
+				const cAABB& aabb = m_proxies[proxyID].aabb;
+				if (!inAABB.intersects(aabb))
+					continue;
+
+				if (CellCoord(c_max(aabb.min.x, inAABB.min.x)) != cell.x || CellCoord(c_max(aabb.min.y, inAABB.min.y)) != cell.y)
+					continue;
+
+				if (!callback(proxyID))
+					return false;
+			}
+			return true;
+			};
+
+		// large queries walk the existing cells instead of looking up every cell in their range
+		long long rangeCount = static_cast<long long>(maxX - minX + 1) * static_cast<long long>(maxY - minY + 1);
+		if (rangeCount > m_cellCount)
+		{
+			for (int i = 0; i < m_cellCount; ++i)
+			{
+				const cGridCell& cell = m_cells[i];
+				if (cell.x < minX || cell.x > maxX || cell.y < minY || cell.y > maxY)
+					continue;
+				if (!queryCell(cell))
+					return;
+			}
+		}
+		else
+		{
+			for (int y = minY; y <= maxY; ++y)
+			{
+				for (int x = minX; x <= maxX; ++x)
+				{
+					int cellIndex = FindCell(x, y);
+					if (cellIndex != null_node && !queryCell(m_cells[cellIndex]))
+						return;
+				}
+			}
+		}
+
+		m_tree.Query(inAABB, [this, &callback](int treeID) -> bool {
+			return callback(static_cast<int>(reinterpret_cast<intptr_t>(m_tree.GetUserData(treeID))));
+			});
+	}
+
+	template <typename T>
+	inline void cHashGrid::RayCast(const cRayCastInput& inInput, T&& callback) const
+	{
+		CastAABB(inInput, cVec2::zero, callback);
+	}
+
+	template <typename T>
+	inline void cHashGrid::BoxCast(const cAABB& inAABB, const cRayCastInput& inInput, T&& callback) const
+	{
+		cRayCastInput centerInput = inInput;
+		centerInput.origin = inAABB.getCenter();
+		CastAABB(centerInput, inAABB.getExtents(), callback);
+	}
+
+	template <typename T>
+	inline void cHashGrid::CastAABB(const cRayCastInput& inInput, const cVec2& inExtents, T&& callback) const
+	{
+		if (inInput.maxFraction <= 0.0f)
+			return;
+
+		cRayCastInput subInput = inInput;
+		cVec2 invTranslation = RayInvTranslation(inInput.translation);
+
+		// the bounds of the swept box, a clipped ray keeps testing the proxies of its original length
+		cVec2 end = inInput.origin + inInput.maxFraction * inInput.translation;
+		cAABB bounds{ cVec2::vmin(inInput.origin, end) - inExtents, cVec2::vmax(inInput.origin, end) + inExtents };
+
+		Query(bounds, [&](int proxyID) -> bool {
+			const cAABB& aabb = m_proxies[proxyID].aabb;
+			cAABB proxyAABB{ aabb.min - inExtents, aabb.max + inExtents };
+			if (!RayIntersectsAABB(subInput.origin, invTranslation, subInput.maxFraction, proxyAABB))
+				return true;
+
+			float value = callback(static_cast<const cRayCastInput&>(subInput), proxyID);
+			if (value == 0.0f)
+				return false; // the client has terminated the ray cast
+
+			if (0.0f < value && value < subInput.maxFraction)
+				subInput.maxFraction = value; // the client found a closer hit, skip everything past it
+			return true;
+			});
+	}
+
+	template <typename T>
+	inline void cHashGrid::RayCastPacket(const cRayCastInput* inInputs, int inCount, T&& callback) const
+	{
+		cassert(0 <= inCount && inCount <= CTREE_RAY_PACKET_SIZE);
+		for (int i = 0; i < inCount; ++i)
+		{
+			CastAABB(inInputs[i], cVec2::zero, [&callback, i](const cRayCastInput& subInput, int proxyID) -> float {
+				return callback(subInput, i, proxyID);
+				});
+		}
+	}
+}
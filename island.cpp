@@ -0,0 +1,288 @@
+#include "pch.h"
+#include "island.h"
+#include "physicsWorld.h"
+
+namespace chiori
+{
+	int CreateIsland(cPhysicsWorld* world)
+	{
+		cIsland* n_island = world->p_islands.Alloc();
+		return world->p_islands.getIndex(n_island);
+	}
+
+	void AddActorToIsland(cPhysicsWorld* world, int inIslandIndex, int inActorIndex)
+	{
+		cIsland* island = world->p_islands[inIslandIndex];
+		cActor* actor = world->p_actors[inActorIndex];
+		cassert(actor->islandIndex == NULL_INDEX || actor->islandIndex == inIslandIndex);
+
+		actor->islandIndex = inIslandIndex;
+		actor->islandPrev = island->tailActor;
+		actor->islandNext = NULL_INDEX;
+
+		if (island->tailActor != NULL_INDEX)
+		{
+			world->p_actors[island->tailActor]->islandNext = inActorIndex;
+		}
+		else
+		{
+			island->headActor = inActorIndex;
+		}
+
+		island->tailActor = inActorIndex;
+		island->actorCount += 1;
+	}
+
+	void RemoveActorFromIsland(cPhysicsWorld* world, int inActorIndex)
+	{
+		cActor* actor = world->p_actors[inActorIndex];
+		if (actor->islandIndex == NULL_INDEX)
+			return;
+
+		cIsland* island = world->p_islands[actor->islandIndex];
+
+		if (actor->islandPrev != NULL_INDEX)
+			world->p_actors[actor->islandPrev]->islandNext = actor->islandNext;
+		else
+			island->headActor = actor->islandNext;
+
+		if (actor->islandNext != NULL_INDEX)
+			world->p_actors[actor->islandNext]->islandPrev = actor->islandPrev;
+		else
+			island->tailActor = actor->islandPrev;
+
+		cassert(island->actorCount > 0);
+		island->actorCount -= 1;
+
+		if (island->actorCount == 0)
+		{
+			world->p_islands.Free(island);
+		}
+		else
+		{
+			// the removed actor may have been the only connection between the rest of the island
+			island->constraintRemoveCount += 1;
+		}
+
+		actor->islandIndex = NULL_INDEX;
+		actor->islandPrev = NULL_INDEX;
+		actor->islandNext = NULL_INDEX;
+	}
+
+	void LinkContact(cPhysicsWorld* world, cContact* contact)
+	{
+		cActor* actorA = world->p_actors[contact->edges[0].bodyIndex];
+		cActor* actorB = world->p_actors[contact->edges[1].bodyIndex];
+
+		int islandIndexA = actorA->islandIndex;
+		int islandIndexB = actorB->islandIndex;
+
+		// static and kinematic actors do not link islands
+		if (islandIndexA == NULL_INDEX || islandIndexB == NULL_INDEX)
+			return;
+
+		if (islandIndexA == islandIndexB)
+			return;
+
+		if (!world->p_islands[islandIndexA]->awake)
+			WakeIsland(world, islandIndexA);
+		if (!world->p_islands[islandIndexB]->awake)
+			WakeIsland(world, islandIndexB);
+
+		// merge the smaller island into the larger one
+		if (world->p_islands[islandIndexA]->actorCount < world->p_islands[islandIndexB]->actorCount)
+			std::swap(islandIndexA, islandIndexB);
+
+		cIsland* bigIsland = world->p_islands[islandIndexA];
+		cIsland* smallIsland = world->p_islands[islandIndexB];
+
+		int actorIndex = smallIsland->headActor;
+		while (actorIndex != NULL_INDEX)
+		{
+			cActor* actor = world->p_actors[actorIndex];
+			actor->islandIndex = islandIndexA;
+			actorIndex = actor->islandNext;
+		}
+
+		// append the small island's actor list to the big island's list
+		world->p_actors[bigIsland->tailActor]->islandNext = smallIsland->headActor;
+		world->p_actors[smallIsland->headActor]->islandPrev = bigIsland->tailActor;
+		bigIsland->tailActor = smallIsland->tailActor;
+		bigIsland->actorCount += smallIsland->actorCount;
+		bigIsland->constraintRemoveCount += smallIsland->constraintRemoveCount;
+
+		world->p_islands.Free(smallIsland);
+	}
+
+	void UnlinkContact(cPhysicsWorld* world, cContact* contact)
+	{
+		const cActor* actorA = world->p_actors[contact->edges[0].bodyIndex];
+		const cActor* actorB = world->p_actors[contact->edges[1].bodyIndex];
+
+		if (actorA->islandIndex == NULL_INDEX || actorB->islandIndex == NULL_INDEX)
+			return;
+
+		cassert(actorA->islandIndex == actorB->islandIndex);
+		world->p_islands[actorA->islandIndex]->constraintRemoveCount += 1;
+	}
+
+	void WakeIsland(cPhysicsWorld* world, int inIslandIndex)
+	{
+		cIsland* island = world->p_islands[inIslandIndex];
+		island->awake = true;
+		island->sleepTime = 0.0f;
+
+		int actorIndex = island->headActor;
+		while (actorIndex != NULL_INDEX)
+		{
+			cActor* actor = world->p_actors[actorIndex];
+			actor->awake = true;
+			actor->sleepTime = 0.0f;
+			actorIndex = actor->islandNext;
+		}
+	}
+
+	void SleepIsland(cPhysicsWorld* world, int inIslandIndex)
+	{
+		cIsland* island = world->p_islands[inIslandIndex];
+		island->awake = false;
+
+		int actorIndex = island->headActor;
+		while (actorIndex != NULL_INDEX)
+		{
+			cActor* actor = world->p_actors[actorIndex];
+			actor->awake = false;
+			actor->linearVelocity = cVec2::zero;
+			actor->angularVelocity = 0.0f;
+			actor->forces = cVec2::zero;
+			actor->torques = 0.0f;
+			actorIndex = actor->islandNext;
+		}
+	}
+
+	void SplitIsland(cPhysicsWorld* world, int inIslandIndex)
+	{
+		auto& actors = world->p_actors;
+		auto& contacts = world->p_contacts;
+
+		cIsland* island = world->p_islands[inIslandIndex];
+		bool awake = island->awake;
+
+		// gather the actors and mark them as unvisited, the old island is
+		// replaced by one new island for every connected group of actors
+		std::vector<int> islandActors;
+		islandActors.reserve(island->actorCount);
+		int actorIndex = island->headActor;
+		while (actorIndex != NULL_INDEX)
+		{
+			cActor* actor = actors[actorIndex];
+			islandActors.push_back(actorIndex);
+			actorIndex = actor->islandNext;
+			actor->islandIndex = NULL_INDEX;
+			actor->islandPrev = NULL_INDEX;
+			actor->islandNext = NULL_INDEX;
+		}
+		world->p_islands.Free(island);
+
+		std::vector<int> stack;
+		for (int seedIndex : islandActors)
+		{
+			if (actors[seedIndex]->islandIndex != NULL_INDEX)
+				continue; // already visited
+
+			int newIslandIndex = CreateIsland(world);
+			world->p_islands[newIslandIndex]->awake = awake;
+
+			// depth first search over the touching contacts
+			AddActorToIsland(world, newIslandIndex, seedIndex);
+			stack.push_back(seedIndex);
+			while (!stack.empty())
+			{
+				int currentIndex = stack.back();
+				stack.pop_back();
+
+				int contactKey = actors[currentIndex]->contactList;
+				while (contactKey != NULL_INDEX)
+				{
+					cContact* contact = contacts[(contactKey >> 1)];
+					int edgeIndex = contactKey & 1;
+					contactKey = contact->edges[edgeIndex].nextKey;
+
+					if (!contact->flags.isSet(cContact::TOUCHING))
+						continue;
+
+					int otherIndex = contact->edges[edgeIndex ^ 1].bodyIndex;
+					cActor* other = actors[otherIndex];
+					if (other->type != cActorType::DYNAMIC || other->islandIndex != NULL_INDEX)
+						continue; // static/kinematic actors do not connect islands, or this actor was already visited
+
+					AddActorToIsland(world, newIslandIndex, otherIndex);
+					stack.push_back(otherIndex);
+				}
+			}
+		}
+	}
+
+	void UpdateSleep(cPhysicsWorld* world, float dt)
+	{
+		if (!world->enableSleep)
+		{
+			for (cIsland* island : world->p_islands)
+			{
+				if (!island->awake)
+					WakeIsland(world, island->header.index);
+				C_PROFILE_COUNT(world->m_profile.awakeIslands, 1);
+				C_PROFILE_COUNT(world->m_profile.awakeActors, island->actorCount);
+			}
+			return;
+		}
+
+		const float linTolSqr = commons::LINEAR_SLEEP_TOLERANCE * commons::LINEAR_SLEEP_TOLERANCE;
+		const float angTolSqr = commons::ANGULAR_SLEEP_TOLERANCE * commons::ANGULAR_SLEEP_TOLERANCE;
+
+		// splitting creates new islands, so it is deferred until all the islands have been visited
+		std::vector<int> splitIslands;
+		for (cIsland* island : world->p_islands)
+		{
+			if (!island->awake)
+				continue;
+
+			float minSleepTime = FLT_MAX;
+			int actorIndex = island->headActor;
+			while (actorIndex != NULL_INDEX)
+			{
+				cActor* actor = world->p_actors.getUnchecked(actorIndex);
+				float w = actor->angularVelocity;
+				if (actor->linearVelocity.sqrMagnitude() > linTolSqr || w * w > angTolSqr)
+					actor->sleepTime = 0.0f;
+				else
+					actor->sleepTime += dt;
+
+				minSleepTime = c_min(minSleepTime, actor->sleepTime);
+				actorIndex = actor->islandNext;
+			}
+
+			island->sleepTime = minSleepTime;
+			C_PROFILE_COUNT(world->m_profile.awakeIslands, 1);
+			C_PROFILE_COUNT(world->m_profile.awakeActors, island->actorCount);
+
+			if (minSleepTime < commons::TIME_TO_SLEEP)
+				continue;
+
+			if (island->constraintRemoveCount > 0)
+			{
+				// the island may no longer be connected, split it before it goes to sleep
+				splitIslands.push_back(island->header.index);
+			}
+			else
+			{
+				SleepIsland(world, island->header.index);
+			}
+		}
+
+		for (int islandIndex : splitIslands)
+		{
+			SplitIsland(world, islandIndex);
+		}
+	}
+}
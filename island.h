@@ -0,0 +1,41 @@
+#pragma once
+#include "chioriPool.h"
+
+namespace chiori
+{
+	// Forward declarations
+	class cPhysicsWorld;
+	class cActor;
+	struct cContact;
+
+	// An island is a persistent group of dynamic actors that are connected through touching contacts.
+	// Islands are merged when a contact between two dynamic actors starts touching, and are only split
+	// once they are about to fall asleep, as a split is a full traversal of the contact graph.
+	// Static and kinematic actors never belong to an island, they do not connect the actors touching them.
+	// The actors of an island are kept in a doubly linked list through cActor::islandPrev/islandNext
+	struct cIsland
+	{
+		cObjHeader header; // required for pool allocator
+		int headActor{ -1 };
+		int tailActor{ -1 };
+		int actorCount{ 0 };
+		int constraintRemoveCount{ 0 };	// touching contacts removed since the last split, if > 0 the island may be split
+		float sleepTime{ 0.0f };		// the minimum sleep time of all actors in the island
+		bool awake{ true };
+	};
+
+	int CreateIsland(cPhysicsWorld* world);
+	void AddActorToIsland(cPhysicsWorld* world, int inIslandIndex, int inActorIndex);
+	void RemoveActorFromIsland(cPhysicsWorld* world, int inActorIndex);
+
+	// called when a contact starts/stops touching, links or marks the islands of the two actors for splitting
+	void LinkContact(cPhysicsWorld* world, cContact* contact);
+	void UnlinkContact(cPhysicsWorld* world, cContact* contact);
+
+	void WakeIsland(cPhysicsWorld* world, int inIslandIndex);
+	void SleepIsland(cPhysicsWorld* world, int inIslandIndex);
+	void SplitIsland(cPhysicsWorld* world, int inIslandIndex);
+
+	// updates the sleep timers of all awake islands and puts them to sleep or splits them as needed
+	void UpdateSleep(cPhysicsWorld* world, float dt);
+}
@@ -241,7 +241,7 @@ namespace chiori
 	//     vertex-vertex
 	//   end
 	// end
-	cManifold CollideShapes(const cPolygon* shapeA, const cPolygon* shapeB, const cTransform& xfA, const cTransform& xfB, cGJKCache* cache)
+	cManifold CollideShapes(const cPolygon* shapeA, const cPolygon* shapeB, const cTransform& xfA, const cTransform& xfB, cGJKCache* cache, int* outGJKIterations)
 	{
 		cManifold manifold;
 		cPolygon localShapeB;
@@ -264,6 +264,8 @@ namespace chiori
 		cGJKOutput output;
 		
 		cGJK(input, output, cache);
+		if (outGJKIterations)
+			*outGJKIterations = output.iterations;
 
 		if (output.distance > commons::SPEC_DIST)
 		{
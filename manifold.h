@@ -36,5 +36,6 @@ namespace chiori
 		bool frictionPersisted{ false };
 	};
 
-	cManifold CollideShapes(const cPolygon* shapeA, const cPolygon* shapeB, const cTransform& xfA, const cTransform& xfB, cGJKCache* cache);
+	// outGJKIterations, if provided, is set to the number of iterations the GJK ran for
+	cManifold CollideShapes(const cPolygon* shapeA, const cPolygon* shapeB, const cTransform& xfA, const cTransform& xfB, cGJKCache* cache, int* outGJKIterations = nullptr);
 }
\ No newline at end of file
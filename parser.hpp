@@ -1,6 +1,11 @@
 #pragma once
+#ifdef _WIN32
 #include <windows.h>
 #include <commdlg.h> // Windows file dialog
+#include <shobjidl.h>  // For IFileDialog
+#else
+#define sscanf_s sscanf // only used for numeric fields here, which take no buffer sizes
+#endif
 #include <fstream>
 #include <sstream>
 #include <vector>
@@ -26,8 +31,15 @@ static fs::path getProjectPath(std::string folderName)
     return path;
 }
 
+// The file and folder dialogs are only available on Windows, everywhere else
+// they behave as if the user canceled and callers should pass paths directly
 std::string OpenFileDialog(const char* filter, const char* title)
 {
+#ifndef _WIN32
+    (void)filter;
+    (void)title;
+    return "";
+#else
     char filename[MAX_PATH] = "";
     OPENFILENAME ofn;
     ZeroMemory(&ofn, sizeof(ofn));
@@ -45,10 +57,17 @@ std::string OpenFileDialog(const char* filter, const char* title)
         return std::string(filename);
     }
     return ""; // User canceled
+#endif
 }
 
 std::string SaveFileDialog(const char* filter, const char* title, const char* defaultExt)
 {
+#ifndef _WIN32
+    (void)filter;
+    (void)title;
+    (void)defaultExt;
+    return "";
+#else
     char filename[MAX_PATH] = "";
     OPENFILENAME ofn;
     ZeroMemory(&ofn, sizeof(ofn));
@@ -67,13 +86,13 @@ std::string SaveFileDialog(const char* filter, const char* title, const char* de
         return std::string(filename);
     }
     return ""; // User canceled
+#endif
 }
 
-#include <shobjidl.h>  // For IFileDialog
 std::string OpenFolderDialog(const std::wstring& title = L"Select Folder")
 {
     std::string result;
-
+#ifdef _WIN32
     HRESULT hr = CoInitializeEx(nullptr, COINIT_APARTMENTTHREADED | COINIT_DISABLE_OLE1DDE);
     if (SUCCEEDED(hr))
     {
@@ -109,6 +128,9 @@ std::string OpenFolderDialog(const std::wstring& title = L"Select Folder")
         }
         CoUninitialize();
     }
+#else
+    (void)title;
+#endif
     return result;
 }
 
@@ -358,11 +380,11 @@ class SceneParser
             }
         }
 
-        int actorIndex = world->CreateActor(config);
+        cActorHandle actorHandle = world->CreateActor(config);
 
         if (isFracturable)
         {
-            int fractureIndex = world->MakeFracturable(actorIndex, fractureMaterial);
+            int fractureIndex = world->MakeFracturable(actorHandle, fractureMaterial);
             if (fracturePatternIndex >= 0 && succeedFracPattern)
             {
                 world->SetFracturePattern(fracturePatternIndex, fractureIndex);
@@ -425,7 +447,7 @@ class SceneParser
         if (actorIndex >= 0)
         {
             cassert(shapeSet);
-            world->CreateShape(actorIndex, config, &poly);
+            world->CreateShape(world->p_actors.getHandle(world->p_actors[actorIndex]), config, &poly);
         }
     }
 
@@ -446,9 +468,10 @@ class SceneParser
         }
     }
 
-    bool processVDFList(std::ifstream& file)
+    bool processVDFList(std::ifstream& file, std::string folderPath)
     {
-        std::string folderPath = OpenFolderDialog(L"Select Folder Containing VDF Files");
+        if (folderPath.empty())
+            folderPath = OpenFolderDialog(L"Select Folder Containing VDF Files");
         if (folderPath.empty())
         {
             std::cerr << "VDF folder selection canceled.\n";
@@ -528,7 +551,7 @@ public:
         return diagram;
     }
 
-    void SceneParser::loadFromFile()
+    void loadFromFile()
     {
         std::string filename = OpenFileDialog("Scene Files (*.phys)\0*.phys\0All Files (*.*)\0*.*\0", "Load Physics Scene");
 
@@ -538,6 +561,13 @@ public:
             return;
         }
 
+        loadFromPath(filename);
+    }
+
+    // Loads a scene without any dialogs. VDF files listed by the scene are looked up in
+    // inVDFFolder, if it is empty the user is asked for the folder instead
+    void loadFromPath(const std::string& filename, const std::string& inVDFFolder = "")
+    {
         std::ifstream file(filename);
         if (!file.is_open())
         {
@@ -551,7 +581,7 @@ public:
         {
             if (line.find("VDF {") != std::string::npos)
             {
-                success = processVDFList(file);
+                success = processVDFList(file, inVDFFolder);
                 break; // Only one VDF block supported
             }
         }
@@ -560,6 +590,8 @@ public:
         file.clear(); // Clear EOF flag
         file.seekg(0); // Go back to start
 
+        // the shapes go into the broadphase tree in one SAH build instead of one at a time
+        world->BeginBulkLoad();
         while (std::getline(file, line))
         {
             if (line.find("Actor {") != std::string::npos)
@@ -571,6 +603,7 @@ public:
                 processShape(file);
             }
         }
+        world->EndBulkLoad();
 
         file.close();
         std::cout << "Loaded Scene: " << filename << std::endl;
@@ -22,14 +22,18 @@
 #include <type_traits>
 #include <cmath>
 #include <cstdint>
+#include <cfloat>
+#include <cstring>
 
 #pragma warning(push, 0)
 
 // Windows
+#ifdef _WIN32
 #include <direct.h>
 #include <windows.h>
 #include <libloaderapi.h>
 #include <CommCtrl.h>
+#endif
 
 // Custom
 #include "commons.h"
@@ -8,8 +8,9 @@
 namespace chiori
 {
 	#define MAX_FIXED_UPDATES_PER_FRAME 3 
+	#define CONTACTS_PER_TASK 16 // the minimum number of contacts collided by one narrowphase task
 
-	int cPhysicsWorld::CreateActor(const ActorConfig& inConfig)
+	cActorHandle cPhysicsWorld::CreateActor(const ActorConfig& inConfig)
 	{
 		cActor* n_actor = p_actors.Alloc();
 
@@ -33,13 +34,28 @@ namespace chiori
 		n_actor->linearDamping = inConfig.linearDamping;
 		n_actor->angularDamping = inConfig.angularDamping;
 		n_actor->gravityScale = inConfig.gravityScale;
+		n_actor->setBullet(inConfig.isBullet);
 
-		return p_actors.getIndex(n_actor);
+		int actorIndex = p_actors.getIndex(n_actor);
+		if (inConfig.type == cActorType::DYNAMIC)
+		{
+			AddActorToIsland(this, CreateIsland(this), actorIndex);
+		}
+
+		return p_actors.getHandle(n_actor);
 	}
 
-	void cPhysicsWorld::RemoveActor(int inActorIndex)
+	void cPhysicsWorld::RemoveActor(cActorHandle inActor)
 	{
-		cActor* actor = p_actors[inActorIndex];
+		cActor* actor = p_actors[inActor];
+		int inActorIndex = inActor.index;
+
+		// Anything resting on this actor needs to be simulated again
+		if (actor->islandIndex != NULL_INDEX && !p_islands[actor->islandIndex]->awake)
+		{
+			WakeIsland(this, actor->islandIndex);
+		}
+		RemoveActorFromIsland(this, inActorIndex);
 		
 		// Destroy the attached contacts
 		int edgeKey = actor->contactList;
@@ -72,6 +88,11 @@ namespace chiori
 			
 			// Check other body's list head
 			cActor* other = p_actors[twin->bodyIndex];
+			if (other->islandIndex != NULL_INDEX && !p_islands[other->islandIndex]->awake)
+			{
+				WakeIsland(this, other->islandIndex);
+			}
+
 			if (other->contactList == twinKey)
 			{
 				other->contactList = twin->nextKey;
@@ -82,6 +103,7 @@ namespace chiori
 
 			// Remove pair from set
 			p_pairs.erase(contact->shapeIndexA, contact->shapeIndexB);
+			C_PROFILE_COUNT(m_profile.contactsDestroyed, 1);
 
 			cContactEdge* edge = contact->edges + edgeList;
 			edgeKey = edge->nextKey;
@@ -106,6 +128,68 @@ namespace chiori
 		p_actors.Free(actor);
 	}
 
+	void cPhysicsWorld::SetShapeFilter(cShapeHandle inShape, const cFilter& inFilter)
+	{
+		cShape* shape = p_shapes[inShape];
+		shape->filter = inFilter;
+		int shapeIndex = p_shapes.getIndex(shape);
+
+		cActor* actor = p_actors[shape->actorIndex];
+		int contactKey = actor->contactList;
+		while (contactKey != NULL_INDEX)
+		{
+			cContact* contact = p_contacts[(contactKey >> 1)];
+			contactKey = contact->edges[contactKey & 1].nextKey;
+			if (contact->shapeIndexA != shapeIndex && contact->shapeIndexB != shapeIndex)
+				continue; // a contact of another shape of the actor
+
+			if (ShouldShapesCollide(p_shapes[contact->shapeIndexA], p_shapes[contact->shapeIndexB]))
+				continue;
+
+			// the other actor may be resting on this shape
+			p_actors[contact->edges[0].bodyIndex]->wake();
+			p_actors[contact->edges[1].bodyIndex]->wake();
+			if (contact->flags.isSet(cContact::TOUCHING))
+				UnlinkContact(this, contact);
+			DestroyContact(this, contact);
+		}
+
+		// the pairs that were filtered out before are only reported again for proxies in the move buffer
+		m_broadphase.TouchProxy(shape->broadphaseIndex);
+		actor->wake();
+	}
+
+	// wakes the islands of all the actors in contact with inActor
+	static void WakeContactIslands(cPhysicsWorld* w, cActor* inActor)
+	{
+		int contactKey = inActor->contactList;
+		while (contactKey != NULL_INDEX)
+		{
+			cContact* contact = w->p_contacts[(contactKey >> 1)];
+			int edgeIndex = contactKey & 1;
+			cActor* other = w->p_actors[contact->edges[edgeIndex ^ 1].bodyIndex];
+			if (other->islandIndex != NULL_INDEX && !w->p_islands[other->islandIndex]->awake)
+			{
+				WakeIsland(w, other->islandIndex);
+			}
+			contactKey = contact->edges[edgeIndex].nextKey;
+		}
+	}
+
+	// the smallest distance from the center of a convex polygon to its edges
+	static float ComputeMinExtent(const cPolygon& polygon)
+	{
+		cVec2 center = cVec2::zero;
+		for (int i = 0; i < polygon.count; ++i)
+			center += polygon.vertices[i];
+		center = (1.0f / polygon.count) * center;
+
+		float minExtent = FLT_MAX;
+		for (int i = 0; i < polygon.count; ++i)
+			minExtent = c_min(minExtent, dot(polygon.normals[i], polygon.vertices[i] - center));
+		return minExtent;
+	}
+
 	static void computeActorMass(cPhysicsWorld* w, cActor* b)
 	{
 		// Compute mass data from shapes. Each shape has its own density.
@@ -114,6 +198,7 @@ namespace chiori
 		b->inertia = 0.0f;
 		b->invInertia = 0.0f;
 		b->localCenter = cVec2::zero;
+		b->minExtent = FLT_MAX;
 
 		// Static and kinematic bodies have zero mass.
 		if (b->type == cActorType::STATIC || b->type == cActorType::KINEMATIC)
@@ -130,6 +215,8 @@ namespace chiori
 			const cShape* s = w->p_shapes[shapeIndex];
 			shapeIndex = s->nextShapeIndex;
 
+			b->minExtent = c_min(b->minExtent, ComputeMinExtent(s->polygon));
+
 			if (s->density == 0.0f)
 			{
 				continue;
@@ -172,39 +259,49 @@ namespace chiori
 		b->linearVelocity = (b->linearVelocity + deltaLinear);
 	}
 
-	int cPhysicsWorld::CreateShape(int inActorIndex, const ShapeConfig& inConfig, cPolygon* inGeom)
+	cShapeHandle cPhysicsWorld::CreateShape(cActorHandle inActor, const ShapeConfig& inConfig, cPolygon* inGeom)
 	{
+		cActor* actor = p_actors[inActor];
 		cShape* n_shape = p_shapes.Alloc();
 		int shapeIndex = p_shapes.getIndex(n_shape);
-		cActor* actor = p_actors[inActorIndex];
 
-		n_shape->actorIndex = inActorIndex;
+		n_shape->actorIndex = inActor.index;
 		n_shape->polygon = *inGeom;
 		n_shape->density = inConfig.density;
 		n_shape->friction = inConfig.friction;
 		n_shape->restitution = inConfig.restitution;
+		n_shape->filter = inConfig.filter;
 
 		cTransform xf = actor->getTransform();
 		
 		n_shape->aabb = n_shape->ComputeAABB(xf);
-		n_shape->broadphaseIndex = m_broadphase.CreateProxy(n_shape->aabb, reinterpret_cast<void*>(n_shape->header.index));
+
+		// shapes of static actors never move, they go into the static broadphase tree
+		cProxyType proxyType = DYNAMIC_PROXY;
+		if (actor->type == cActorType::STATIC)
+		{
+			n_shape->shapeFlags.set(cShape::IS_STATIC);
+			proxyType = STATIC_PROXY;
+		}
+		n_shape->broadphaseIndex = m_broadphase.CreateProxy(n_shape->aabb, reinterpret_cast<void*>(static_cast<intptr_t>(n_shape->header.index)), proxyType);
 		
 		// Add to shape linked list
 		n_shape->nextShapeIndex = actor->shapeList;
 		actor->shapeList = shapeIndex;
+		actor->wake();
 
 		if (n_shape->density)
 		{
 			computeActorMass(this, actor);
 		}
 
-		return shapeIndex;
+		return p_shapes.getHandle(n_shape);
 	}
 
-	cAABB cPhysicsWorld::GetActorAABB(int inActorIndex)
+	cAABB cPhysicsWorld::GetActorAABB(cActorHandle inActor)
 	{
-		cassert(p_actors.isValid(inActorIndex));
-		cActor* actor = p_actors[inActorIndex];
+		cassert(p_actors.isValid(inActor));
+		cActor* actor = p_actors[inActor];
 		cAABB totalAABB;
 		int shapeIndex = actor->shapeList;
 		if (shapeIndex != NULL_INDEX)
@@ -221,37 +318,293 @@ namespace chiori
 		return totalAABB;
 	}
 
+	void cPhysicsWorld::CompactBroadphase()
+	{
+		m_broadphase.CompactTrees([this](void* userData, int newProxyKey) {
+			int shapeIndex = static_cast<int>(reinterpret_cast<intptr_t>(userData));
+			p_shapes[shapeIndex]->broadphaseIndex = newProxyKey;
+			});
+	}
+
+	bool cPhysicsWorld::RayCastShape(const cRayCastInput& inInput, int inShapeIndex, cRayHit* outHit)
+	{
+		cShape* shape = p_shapes.getUnchecked(inShapeIndex);
+		if (!shape->shapeFlags.isSet(cShape::SCENE_QUERYABLE))
+			return false;
+
+		// the actor origin is only updated at the start of step, so it is rebuilt from the solved position
+		const cActor* actor = p_actors.getUnchecked(shape->actorIndex);
+		cTransform xf{ actor->position - actor->localCenter.rotated(actor->rot), actor->rot };
+
+		cRayCastInput localInput;
+		localInput.origin = cInvTransformVec(xf, inInput.origin);
+		localInput.translation = inInput.translation.rotated(-xf.q);
+		localInput.maxFraction = inInput.maxFraction;
+
+		cRayCastOutput output = RayCastPolygon(localInput, shape->polygon);
+		if (!output.hit)
+			return false;
+
+		outHit->shape = p_shapes.getHandle(shape);
+		outHit->point = cTransformVec(xf, output.point);
+		outHit->normal = output.normal.rotated(xf.q);
+		outHit->fraction = output.fraction;
+		return true;
+	}
+
+	bool cPhysicsWorld::ShapeCastShape(const cPolygon& inPolygon, const cTransform& inTransform, const cVec2& inTranslation, float inMaxFraction,
+		int inShapeIndex, cShapeCastHit* outHit)
+	{
+		cShape* shape = p_shapes.getUnchecked(inShapeIndex);
+		if (!shape->shapeFlags.isSet(cShape::SCENE_QUERYABLE))
+			return false;
+
+		const cActor* actor = p_actors.getUnchecked(shape->actorIndex);
+		cTransform xf{ actor->position - actor->localCenter.rotated(actor->rot), actor->rot };
+
+		cShapeCastInput input{
+			cGJKProxy{ inPolygon.vertices, inPolygon.count },
+			cGJKProxy{ shape->polygon.vertices, shape->polygon.count },
+			inTransform, xf, inTranslation, inMaxFraction };
+		cShapeCastOutput output;
+		cShapeCast(input, output);
+		if (!output.hit)
+			return false;
+
+		outHit->shape = p_shapes.getHandle(shape);
+		outHit->point = output.point;
+		outHit->normal = output.normal;
+		outHit->fraction = output.fraction;
+		return true;
+	}
+
+	bool cPhysicsWorld::ShapeCastClosest(const cPolygon& inPolygon, const cTransform& inTransform, const cVec2& inTranslation, cShapeCastHit* outHit)
+	{
+		bool found = false;
+		ShapeCast(inPolygon, inTransform, inTranslation, [outHit, &found](const cShapeCastHit& hit) -> float {
+			*outHit = hit;
+			found = true;
+			return hit.fraction;
+			});
+		return found;
+	}
+
+	bool cPhysicsWorld::RayCastClosest(const cVec2& inOrigin, const cVec2& inTranslation, cRayHit* outHit)
+	{
+		cRayCastInput input{ inOrigin, inTranslation, 1.0f };
+		bool found = false;
+		RayCast(input, [outHit, &found](const cRayHit& hit) -> float {
+			*outHit = hit;
+			found = true;
+			return hit.fraction;
+			});
+		return found;
+	}
+
+	bool cPhysicsWorld::RayCastAny(const cVec2& inOrigin, const cVec2& inTranslation, cRayHit* outHit)
+	{
+		cRayCastInput input{ inOrigin, inTranslation, 1.0f };
+		bool found = false;
+		RayCast(input, [outHit, &found](const cRayHit& hit) -> float {
+			*outHit = hit;
+			found = true;
+			return 0.0f;
+			});
+		return found;
+	}
+
+	int cPhysicsWorld::RayCastAll(const cVec2& inOrigin, const cVec2& inTranslation, std::vector<cRayHit>& outHits)
+	{
+		cRayCastInput input{ inOrigin, inTranslation, 1.0f };
+		size_t first = outHits.size();
+		RayCast(input, [&outHits](const cRayHit& hit) -> float {
+			outHits.push_back(hit);
+			return -1.0f;
+			});
+		std::sort(outHits.begin() + first, outHits.end(),
+			[](const cRayHit& hit1, const cRayHit& hit2) { return hit1.fraction < hit2.fraction; });
+		return static_cast<int>(outHits.size() - first);
+	}
+
+	int cPhysicsWorld::RayCastBatch(const cRayCastInput* inRays, int inCount, cRayHit* outHits)
+	{
+		std::atomic<int> hitCount{ 0 };
+		auto castPackets = [&](int begin, int end, int)
+			{
+				int packetHits = 0;
+				for (int packet = begin; packet < end; ++packet)
+				{
+					int firstRay = packet * CTREE_RAY_PACKET_SIZE;
+					int rayCount = c_min(CTREE_RAY_PACKET_SIZE, inCount - firstRay);
+					cRayHit* hits = outHits + firstRay;
+					for (int i = 0; i < rayCount; ++i)
+						hits[i] = cRayHit();
+
+					m_broadphase.RayCastPacket(inRays + firstRay, rayCount, [this, hits](const cRayCastInput& input, int rayIndex, int proxyKey) -> float {
+						int shapeIndex = static_cast<int>(reinterpret_cast<intptr_t>(m_broadphase.GetUserData(proxyKey)));
+						cRayHit hit;
+						if (!RayCastShape(input, shapeIndex, &hit))
+							return -1.0f;
+						hits[rayIndex] = hit;
+						return hit.fraction;
+						});
+
+					for (int i = 0; i < rayCount; ++i)
+					{
+						if (hits[i].shape.index != -1)
+							++packetHits;
+					}
+				}
+				hitCount += packetHits;
+			};
+
+		int packetCount = (inCount + CTREE_RAY_PACKET_SIZE - 1) / CTREE_RAY_PACKET_SIZE;
+		if (taskSystem)
+			taskSystem->parallelFor(packetCount, 1, castPackets);
+		else
+			castPackets(0, packetCount, 0);
+
+		return hitCount.load();
+	}
+
+	// Sweeps a bullet's shapes from its position at the start of the step to its solved position and returns the
+	// time of impact, 1 if nothing was hit. The sweep is translation only and uses the solved rotation.
+	// Shapes that the bullet already touches at the start are ignored, so it can still slide along them
+	static float ComputeBulletTOI(cPhysicsWorld* w, const cActor* bullet, int bulletIndex)
+	{
+		cVec2 translation = bullet->position - bullet->position0;
+		cTransform xf0{ bullet->position0 - bullet->localCenter.rotated(bullet->rot), bullet->rot };
+
+		float toi = 1.0f;
+		int shapeIndex = bullet->shapeList;
+		while (shapeIndex != -1)
+		{
+			cShape* shape = w->p_shapes.getUnchecked(shapeIndex);
+			shapeIndex = shape->nextShapeIndex;
+			if (shape->shapeFlags.isSet(cShape::IS_TRIGGER))
+				continue;
+
+			cRayCastInput input{ xf0.p, translation, toi };
+			cAABB aabb = CreateAABBHull(shape->polygon.vertices, shape->polygon.count, xf0);
+			w->m_broadphase.BoxCast(aabb, input, [&](const cRayCastInput& subInput, int proxyKey) -> float {
+				int otherIndex = static_cast<int>(reinterpret_cast<intptr_t>(w->m_broadphase.GetUserData(proxyKey)));
+				cShape* other = w->p_shapes.getUnchecked(otherIndex);
+				if (other->actorIndex == bulletIndex || other->shapeFlags.isSet(cShape::IS_TRIGGER) || !w->ShouldShapesCollide(shape, other))
+					return -1.0f;
+
+				// other bullets are being moved by the other tasks, so they are never hit
+				const cActor* otherActor = w->p_actors.getUnchecked(other->actorIndex);
+				if (!other->shapeFlags.isSet(cShape::IS_STATIC) && (!w->continuousHitsDynamic || otherActor->isBullet()))
+					return -1.0f;
+
+				cTransform xf{ otherActor->position - otherActor->localCenter.rotated(otherActor->rot), otherActor->rot };
+				cShapeCastInput castInput{
+					cGJKProxy{ shape->polygon.vertices, shape->polygon.count },
+					cGJKProxy{ other->polygon.vertices, other->polygon.count },
+					xf0, xf, translation, subInput.maxFraction };
+				cShapeCastOutput output;
+				cShapeCast(castInput, output);
+				if (!output.hit || output.fraction == 0.0f)
+					return -1.0f;
+
+				toi = output.fraction;
+				return toi;
+				});
+		}
+		return toi;
+	}
+
+	static void SolveContinuous(cPhysicsWorld* w)
+	{
+		// only the bullets that moved far enough to tunnel are swept, so the cost scales with the fast actors
+		int actorCount = static_cast<int>(w->p_actors.size());
+		cActor** bullets = static_cast<cActor**>(w->allocator->allocate(sizeof(cActor*) * actorCount));
+		int bulletCount = 0;
+		for (cActor* actor : w->p_actors)
+		{
+			if (actor->type != cActorType::DYNAMIC || !actor->awake || !actor->isBullet())
+				continue;
+
+			float threshold = commons::CCD_EXTENT_FRACTION * actor->minExtent;
+			if ((actor->position - actor->position0).sqrMagnitude() > threshold * threshold)
+				bullets[bulletCount++] = actor;
+		}
+		C_PROFILE_COUNT(w->m_profile.continuousActors, bulletCount);
+
+		C_PROFILE(std::atomic<int> hits{ 0 });
+		auto sweepBullets = [&](int begin, int end, int)
+			{
+				for (int i = begin; i < end; ++i)
+				{
+					cActor* bullet = bullets[i];
+					float toi = ComputeBulletTOI(w, bullet, w->p_actors.getIndex(bullet));
+					if (toi < 1.0f)
+					{
+						// the velocity is kept, the speculative contact created next step resolves the impact
+						bullet->position = bullet->position0 + toi * (bullet->position - bullet->position0);
+						C_PROFILE(++hits);
+					}
+				}
+			};
+
+		if (w->taskSystem)
+			w->taskSystem->parallelFor(bulletCount, 1, sweepBullets);
+		else
+			sweepBullets(0, bulletCount, 0);
+		C_PROFILE_COUNT(w->m_profile.continuousHits, hits.load());
+
+		w->allocator->deallocate(bullets, sizeof(cActor*) * actorCount);
+	}
+
 	void cPhysicsWorld::step(float inFDT, int primaryIterations, int secondaryIterations, bool warmStart)
 	{
-		int actorCapacity = p_actors.capacity();
+		m_profile = cStepProfile();
+		C_PROFILE_BEGIN(stepTimer);
+		C_PROFILE_BEGIN(phaseTimer);
+
 		// Step 1: Update the transform and broadphase AABBs for all shapes
 		// We also check if any of the actors or shapes have been modified by the user and update the system accordingly
-		for (int i = 0; i < actorCapacity; ++i)
+		for (cActor* actor : p_actors)
 		{
-			if (!p_actors.isValid(i))
-				continue;
-
-			cActor* actor = p_actors[i];
 			if (actor->type == cActorType::STATIC)
 				continue;
 
+			// the start of the continuous collision sweep, also set for sleeping actors as their island can be woken later in this step
+			actor->position0 = actor->position;
+			if (!actor->awake)
+				continue; // sleeping actors have not moved since they fell asleep
+
+			if (actor->islandIndex != NULL_INDEX && !p_islands.getUnchecked(actor->islandIndex)->awake)
+			{
+				// the actor was woken by the user (impulse, force, transform), wake the rest of its island
+				WakeIsland(this, actor->islandIndex);
+			}
+			else if (actor->type == cActorType::KINEMATIC && (actor->linearVelocity != cVec2::zero || actor->angularVelocity != 0.0f))
+			{
+				// kinematic actors are not part of islands, so a moving one needs to wake anything it might touch
+				WakeContactIslands(this, actor);
+			}
+
 			actor->origin = actor->position - actor->localCenter.rotated(actor->rot);
 			actor->forces = cVec2::zero;
 			actor->torques = 0.0f;
 
 			cTransform xf = { actor->origin, actor->rot };
+			// the fat AABBs are extended along the movement predicted for this step, so fast actors are not reinserted every step
+			cVec2 displacement = actor->linearVelocity * inFDT;
 
 			int shapeIndex = actor->shapeList;
 			while (shapeIndex != -1)
 			{
-				cShape* shape = p_shapes[shapeIndex];
+				cShape* shape = p_shapes.getUnchecked(shapeIndex);
 				
 				shape->aabb = CreateAABBHull(shape->polygon.vertices, shape->polygon.count, xf);
-				cAABB fatAABB = m_broadphase.GetFattenedAABB(shape->broadphaseIndex);
-				if (!fatAABB.contains(shape->aabb) || actor->_flags.isSet(cActor::IS_DIRTY)) // moved out of broadphase AABB, significant enough movement to update broadphase
+				// reinserts the proxy if it moved out of its fat AABB, or if the fat AABB is much larger than it needs to be
+				if (m_broadphase.MoveProxy(shape->broadphaseIndex, shape->aabb, displacement))
 				{
-					m_broadphase.MoveProxy(shape->broadphaseIndex, shape->aabb, cVec2::zero);
+					C_PROFILE_COUNT(m_profile.movedProxies, 1);
 				}
+				C_PROFILE_COUNT(m_profile.awakeProxies, 1);
 
 				shapeIndex = shape->nextShapeIndex;
 			}
@@ -266,52 +619,115 @@ namespace chiori
 				actor->_flags.clear(cActor::IS_DIRTY);
 		}
 
+		C_PROFILE_END(phaseTimer, m_profile.updateTransforms);
+		C_PROFILE(phaseTimer.reset());
+
 		// Step 2: Broadphase + Narrowphase + Contact Generation
 		// Update collision pairs, and create all new contacts for this frame
 		// This includes the broadphase AABB tree query
 		// and contact generation in one sweep
+		if (m_broadphase.RebuildTreeIfDegraded())
+			C_PROFILE_COUNT(m_profile.treeRebuilds, 1);
+
 		m_broadphase.UpdatePairs(
 			[this](void* userDataA, void* userDataB)
 			{
-				int shapeAIndex = reinterpret_cast<int>(userDataA);
-				int shapeBIndex = reinterpret_cast<int>(userDataB);
+				int shapeAIndex = static_cast<int>(reinterpret_cast<intptr_t>(userDataA));
+				int shapeBIndex = static_cast<int>(reinterpret_cast<intptr_t>(userDataB));
+				C_PROFILE_COUNT(m_profile.pairsGenerated, 1);
 				if (p_pairs.contains(shapeAIndex, shapeBIndex))
 					return; // no need to create a contact for these shapes since a contact already exists
-				CreateContact(this, p_shapes[shapeAIndex], p_shapes[shapeBIndex]);
-			}
+				cShape* shapeA = p_shapes[shapeAIndex];
+				cShape* shapeB = p_shapes[shapeBIndex];
+				if (!ShouldShapesCollide(shapeA, shapeB))
+				{
+					C_PROFILE_COUNT(m_profile.pairsFiltered, 1);
+					return;
+				}
+				CreateContact(this, shapeA, shapeB);
+				C_PROFILE_COUNT(m_profile.contactsCreated, 1);
+			},
+			taskSystem
 		);
 
+		C_PROFILE_END(phaseTimer, m_profile.updatePairs);
+		C_PROFILE(phaseTimer.reset());
+
 		// Step 3: Update Contacts
-		// All contacts are run through and updated or removed
-		// as required. We loop backwards to ensure that the
-		// removal of items doesn't invalidate the pool loop
-		size_t contactCapacity = p_contacts.capacity();
-		int i = static_cast<int>(contactCapacity) - 1;
-		for (; i >= 0; --i)
-		{
-			if (!p_contacts.isValid(i))
-				continue;
+		// First the narrowphase collides all awake contacts whose shape fat AABBs
+		// still overlap, and marks the others as disjoint. Each contact update only
+		// writes to its own contact, so this runs in parallel on the task system
+		C_PROFILE(std::atomic<int> gjkCalls{ 0 });
+		C_PROFILE(std::atomic<int> gjkIterations{ 0 });
+		auto collideTask = [&](int begin, int end, int)
+			{
+				C_PROFILE(int rangeCalls = 0);
+				C_PROFILE(int rangeIterations = 0);
+				for (int i = begin; i < end; ++i)
+				{
+					cContact* contact = p_contacts.getDense(i);
+					if (!IsContactAwake(contact))
+						continue; // nothing on this contact can have moved
+
+					cShape* shapeA = p_shapes.getUnchecked(contact->shapeIndexA);
+					cShape* shapeB = p_shapes.getUnchecked(contact->shapeIndexB);
+					cAABB aabb_a = m_broadphase.GetFattenedAABB(shapeA->broadphaseIndex);
+					cAABB aabb_b = m_broadphase.GetFattenedAABB(shapeB->broadphaseIndex);
+					if (!aabb_a.intersects(aabb_b))
+					{
+						contact->flags.set(cContact::DISJOINT);
+						continue;
+					}
+
+					// Shape fat AABBs are still overlapping, so keep this contact
+					// and update it with the new info
+					cActor* actorA = p_actors.getUnchecked(shapeA->actorIndex);
+					cActor* actorB = p_actors.getUnchecked(shapeB->actorIndex);
+					int iterations = 0;
+					UpdateContact(this, contact, shapeA, actorA, shapeB, actorB, &iterations);
+					contact->flags.set(cContact::UPDATED);
+					C_PROFILE(rangeCalls += 1);
+					C_PROFILE(rangeIterations += iterations);
+				}
+				C_PROFILE(gjkCalls += rangeCalls);
+				C_PROFILE(gjkIterations += rangeIterations);
+			};
+
+		int contactCount = static_cast<int>(p_contacts.size());
+		if (taskSystem)
+			taskSystem->parallelFor(contactCount, CONTACTS_PER_TASK, collideTask);
+		else
+			collideTask(0, contactCount, 0);
+
+		C_PROFILE_COUNT(m_profile.gjkCalls, gjkCalls.load());
+		C_PROFILE_COUNT(m_profile.gjkIterations, gjkIterations.load());
 
-			cContact* contact = p_contacts[i];
-			cShape* shapeA = p_shapes[contact->shapeIndexA];
-			cShape* shapeB = p_shapes[contact->shapeIndexB];
-			cAABB aabb_a = m_broadphase.GetFattenedAABB(shapeA->broadphaseIndex);
-			cAABB aabb_b = m_broadphase.GetFattenedAABB(shapeB->broadphaseIndex);
-			bool overlaps = aabb_a.intersects(aabb_b);
-			if (overlaps)
+		// Then the results are applied serially, this links and unlinks islands and
+		// destroys the disjoint contacts. We loop backwards over the live contacts as a
+		// removal moves the last contact into the removed contact's dense position
+		for (int i = contactCount - 1; i >= 0; --i)
+		{
+			cContact* contact = p_contacts.getDense(i);
+			if (contact->flags.isSet(cContact::DISJOINT))
 			{
-				// Shape fat AABBs are still overlapping, so keep this contact
-				// and update it with the new info
-				cActor* actorA = p_actors[shapeA->actorIndex];
-				cActor* actorB = p_actors[shapeB->actorIndex];
-				UpdateContact(this, contact, shapeA, actorA, shapeB, actorB);
+				if (contact->flags.isSet(cContact::TOUCHING))
+					UnlinkContact(this, contact);
+				DestroyContact(this, contact);
+				C_PROFILE_COUNT(m_profile.contactsDestroyed, 1);
 			}
-			else
+			else if (contact->flags.isSet(cContact::UPDATED))
 			{
-				DestroyContact(this, contact);
+				contact->flags.clear(cContact::UPDATED);
+				if (contact->flags.isSet(cContact::ENTERED))
+					LinkContact(this, contact);
+				else if (contact->flags.isSet(cContact::EXITED))
+					UnlinkContact(this, contact);
 			}
 		}
 
+		C_PROFILE_END(phaseTimer, m_profile.updateContacts);
+		C_PROFILE(phaseTimer.reset());
+
 		// Step 4: Integrate velocities, solve velocity constraints,
 		// and integrate positions. This is done primary in the solver.
 		SolverContext context;
@@ -327,11 +743,33 @@ namespace chiori
 		{
 			PGSSolver(this, &context);
 		}
+		else if (runWideSolver)
+		{
+			PGSSoftSolverWide(this, &context);
+		}
 		else
 		{
 			PGSSoftSolver(this, &context);
 		}
-		
+
+		C_PROFILE_END(phaseTimer, m_profile.solve);
+		C_PROFILE(phaseTimer.reset());
+
+		// Step 4b: Continuous collision
+		// Bullet actors that moved further than a fraction of their extent are swept from their start position
+		// and stopped at their first time of impact, so that they don't tunnel through thin geometry
+		SolveContinuous(this);
+
+		C_PROFILE_END(phaseTimer, m_profile.continuous);
+		C_PROFILE(phaseTimer.reset());
+
+		// Step 5: Update the island sleep timers
+		// Islands that have been resting long enough are put to sleep
+		// and are skipped by all of the steps above until woken up
+		UpdateSleep(this, inFDT);
+
+		C_PROFILE_END(phaseTimer, m_profile.updateSleep);
+		C_PROFILE_END(stepTimer, m_profile.step);
 	}
 
 
@@ -355,14 +793,8 @@ namespace chiori
 		float textSize = fontSize;
 		if (draw->drawShapes)
 		{
-			int count = p_actors.capacity();
-			for (int i = 0; i < count; ++i)
+			for (cActor* actor : p_actors)
 			{
-				if (!p_actors.isValid(i))
-					continue;
-
-				cActor* actor = p_actors[i];
-
 				cTransform xf = actor->getTransform();
 				int shapeIndex = actor->shapeList;
 				while (shapeIndex != NULL_INDEX)
@@ -381,6 +813,10 @@ namespace chiori
 					{
 						DebugDrawShape(draw, shape, xf, { 0.5f, 0.5f, 0.9f, 1.0f });
 					}
+					else if (!actor->awake)
+					{
+						DebugDrawShape(draw, shape, xf, { 0.6f, 0.6f, 0.6f, 1.0f });
+					}
 					else
 					{
 						DebugDrawShape(draw, shape, xf, cDebugColor::Yellow);
@@ -396,16 +832,10 @@ namespace chiori
 		{
 			cDebugColor AABBcolor = { 0.9f, 0.3f, 0.9f, 1.0f };
 
-			int count = p_actors.capacity();
-			for (int i = 0; i < count; ++i)
+			for (cActor* actor : p_actors)
 			{
-				if (!p_actors.isValid(i))
-					continue;
-
-				cActor* actor = p_actors[i];
-
 				char buffer[32];
-				snprintf(buffer, 32, "%d", i);
+				snprintf(buffer, 32, "%u", actor->header.index);
 				draw->DrawString(actor->position, textSize, buffer, AABBcolor, draw->context);
 
 				int shapeIndex = actor->shapeList;
@@ -448,19 +878,25 @@ namespace chiori
 
 					draw->DrawPolygon(verts, 4, treeColor, draw->context);
 				};
-			m_broadphase.GetTree().DisplayTree(drawFunc);
+			m_broadphase.GetTree(STATIC_PROXY).DisplayTree(drawFunc);
+			m_broadphase.GetTree(DYNAMIC_PROXY).DisplayTree(drawFunc);
+
+			const cSweepAndPrune& sap = m_broadphase.GetSweepAndPrune();
+			for (int i = 0; i < sap.GetEntryCount(); ++i)
+			{
+				if (sap.GetEntries()[i].proxyID != null_node)
+					drawFunc(0, sap.GetEntries()[i].aabb);
+			}
+
+			// the grid cells are not drawn, only the proxies that fell back to its tree
+			m_broadphase.GetHashGrid().GetTree().DisplayTree(drawFunc);
 		}
 
 		if (draw->drawMass)
 		{
 			cVec2 offset = { 0.1f,0.1f };
-			int count = p_actors.capacity();
-			for (int i = 0; i < count; ++i)
+			for (cActor* actor : p_actors)
 			{
-				if (!p_actors.isValid(i))
-					continue;
-
-				cActor* actor = p_actors[i];
 				cTransform xf = actor->getTransform();
 				draw->DrawTransform(xf, draw->context);
 
@@ -483,13 +919,8 @@ namespace chiori
 			cDebugColor impulseColor = { 0.9f, 0.9f, 0.3f, 1.0f };
 			cDebugColor frictionColor = { 0.9f, 0.9f, 0.3f, 1.0f };
 
-			int contactCapacity = p_contacts.capacity();
-			for (int i = 0; i < contactCapacity; ++i)
+			for (cContact* contact : p_contacts)
 			{
-				if (!p_contacts.isValid(i))
-					continue;
-
-				cContact* contact = p_contacts[i];
 				
 				int pointCount = contact->manifold.pointCount;
 				cVec2 normal = contact->manifold.normal;
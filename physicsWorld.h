@@ -5,12 +5,36 @@
 #include "broadphase.h"
 #include "chioriPool.h"
 #include "contact.h"
+#include "island.h"
 #include "commons.h"
+#include "chioriProfiler.h"
+#include "chioriTasks.h"
 
 namespace chiori
 {	
 	class cDebugDraw; // forward declaration
 
+	// A ray cast hit on a shape, point = origin + fraction * translation
+	struct cRayHit
+	{
+		cShapeHandle shape;		// invalid if the ray hit nothing
+		cVec2 point{ cVec2::zero };
+		cVec2 normal{ cVec2::zero };
+		float fraction{ 1.0f };
+	};
+
+	// A shape cast hit, the cast polygon touches the hit shape at point after moving by fraction * translation
+	struct cShapeCastHit
+	{
+		cShapeHandle shape;		// invalid if the cast hit nothing
+		cVec2 point{ cVec2::zero };
+		cVec2 normal{ cVec2::zero };	// the hit shape's surface normal, zero if the polygon already overlaps the shape at the start
+		float fraction{ 1.0f };
+	};
+
+	// Decides if two shapes that passed their cFilter check collide, see cPhysicsWorld::customFilter
+	using ShapeFilterCallback = std::function<bool(const cShape& shapeA, const cShape& shapeB)>;
+
 	class cPhysicsWorld
 	{
 	public:
@@ -21,7 +45,7 @@ namespace chiori
 		template <typename Allocator = cDefaultAllocator>
 		explicit cPhysicsWorld(Allocator alloc = Allocator()) :
 			allocator { std::make_unique<cAllocatorWrapper<Allocator>>(std::move(alloc)) },
-			p_actors{ allocator.get() }, p_shapes{ allocator.get() }, p_contacts{ allocator.get() }
+			p_actors{ allocator.get() }, p_shapes{ allocator.get() }, p_pairs{ allocator.get() }, p_contacts{ allocator.get() }, p_islands{ allocator.get() }
 		{}
 
 		~cPhysicsWorld() = default;
@@ -30,18 +54,135 @@ namespace chiori
 		cVec2 gravity = { 0.0f, -9.81f };
 		void step(float inFDT, int primaryIterations = 4, int secondaryIterations = 2, bool warmStart = true);	// simulates one time step of physics, call directly if not using update
 
-		int CreateActor(const ActorConfig& inConfig);
-		int CreateShape(int inActorIndex, const ShapeConfig& inConfig, cPolygon* inGeom);
-		void RemoveActor(int inActorIndex);
-		cAABB GetActorAABB(int inActorIndex); // computes the AABB of an actor from its sum of shapes
+		cActorHandle CreateActor(const ActorConfig& inConfig);
+		cShapeHandle CreateShape(cActorHandle inActor, const ShapeConfig& inConfig, cPolygon* inGeom);
+		void RemoveActor(cActorHandle inActor);	// also removes the actor's shapes and contacts, their handles become invalid
+		cAABB GetActorAABB(cActorHandle inActor); // computes the AABB of an actor from its sum of shapes
+		// Destroys the shape's contacts that the new filter rejects, the pairs it now accepts are found in the next step
+		void SetShapeFilter(cShapeHandle inShape, const cFilter& inFilter);
+		// the cFilter check followed by customFilter, step calls it on new broadphase pairs and bullet sweeps
+		bool ShouldShapesCollide(const cShape* inShapeA, const cShape* inShapeB) const
+		{
+			return ShouldFiltersCollide(inShapeA->filter, inShapeB->filter) && (!customFilter || customFilter(*inShapeA, *inShapeB));
+		}
+
+		// Shapes created between BeginBulkLoad and EndBulkLoad are added to the broadphase trees at once with a binned SAH build,
+		// which is faster and gives a better tree than inserting them one by one. Use it when loading a scene, don't step in between
+		void BeginBulkLoad() { m_broadphase.BeginBulkInsert(); }
+		void EndBulkLoad() { m_broadphase.EndBulkInsert(); }
+		// Rebuilds the static and dynamic broadphase trees from scratch. A tree is also rebuilt by step when it has degraded past
+		// commons::CTREE_REBUILD_THRESHOLD, set the threshold per world with SetBroadphaseRebuildThreshold
+		void RebuildBroadphase() { m_broadphase.RebuildTree(); }
+		// Renumbers the broadphase tree nodes in depth first order so that queries walk memory forward, see cDynamicTree::Compact.
+		// The shapes get their new proxy keys. Step never compacts, call it after long sessions of fracturing or between levels.
+		// Not between BeginBulkLoad and EndBulkLoad
+		void CompactBroadphase();
+		void SetBroadphaseRebuildThreshold(float inThreshold) { m_broadphase.SetTreeRebuildThreshold(inThreshold); }
+		// The margin around the fat AABBs of moving shapes, defaults to commons::AABB_FATTEN_FACTOR. A larger margin means fewer
+		// reinsertions (cStepProfile::movedProxies) but more pairs, shapes pick up a new margin when they are next reinserted
+		void SetAABBMargin(float inMargin) { m_broadphase.SetAABBMargin(inMargin); }
+		float GetAABBMargin() const { return m_broadphase.GetAABBMargin(); }
+		// Keeps the dynamic shapes in a sweep and prune (SAP_BROADPHASE) instead of the dynamic tree. It suits many shapes that move
+		// coherently, e.g. debris, as it has no reinsertions but sweeps all the dynamic shapes every step.
+		// A hashed grid (GRID_BROADPHASE) suits many shapes of similar size, its cells follow the median shape size and
+		// shapes much larger than a cell fall back to a tree. Set it before creating shapes
+		void SetBroadphaseType(cBroadphaseType inType) { m_broadphase.SetType(inType); }
+		cBroadphaseType GetBroadphaseType() const { return m_broadphase.GetType(); }
+		// Broadphase queries and ray casts read SIMD friendly wide copies of the trees, rebuilt every step for the trees that changed.
+		// It pays off when there are many queries per step, see cBroadphase::SetWideTreeQueries
+		void SetWideTreeQueries(bool inEnabled) { m_broadphase.SetWideTreeQueries(inEnabled); }
+		bool GetWideTreeQueries() const { return m_broadphase.GetWideTreeQueries(); }
+
+		// Ray casts against the shapes with cShape::SCENE_QUERYABLE set. Rays starting inside a shape do not hit it.
+		// Queries read the world as it was after the last step, don't call them during step
+		bool RayCastClosest(const cVec2& inOrigin, const cVec2& inTranslation, cRayHit* outHit);
+		bool RayCastAny(const cVec2& inOrigin, const cVec2& inTranslation, cRayHit* outHit); // stops at the first hit found, which is not always the closest
+		int RayCastAll(const cVec2& inOrigin, const cVec2& inTranslation, std::vector<cRayHit>& outHits); // appends the hits sorted by fraction, returns their count
+		// Finds the closest hit of every ray, outHits[i] is the hit of inRays[i]. The rays are cast in packets of CTREE_RAY_PACKET_SIZE,
+		// keep rays that start close together and point the same way next to each other. Packets run in parallel on the task system
+		// if the world has one. Returns the number of rays that hit a shape
+		int RayCastBatch(const cRayCastInput* inRays, int inCount, cRayHit* outHits);
+		// calls callback(const cRayHit& hit) for the shapes hit by the ray, in no particular order. The callback returns the
+		// new max fraction like cDynamicTree::RayCast: 0 stops the cast, hit.fraction only looks for closer hits, -1 continues unchanged
+		template <typename T>
+		void RayCast(const cRayCastInput& inInput, T&& callback);
+
+		// Sweeps inPolygon placed at inTransform along inTranslation (without rotating it) and finds the first SCENE_QUERYABLE shape
+		// it touches, see cShapeCast. Shapes that already overlap the polygon are hit at fraction 0, so a cast with a zero
+		// translation is an overlap test, e.g. to check a spawn point
+		bool ShapeCastClosest(const cPolygon& inPolygon, const cTransform& inTransform, const cVec2& inTranslation, cShapeCastHit* outHit);
+		// calls callback(const cShapeCastHit& hit) for the shapes hit by the cast, returns work like RayCast
+		template <typename T>
+		void ShapeCast(const cPolygon& inPolygon, const cTransform& inTransform, const cVec2& inTranslation, T&& callback);
+
+		// handles are invalidated when the object they refer to is removed, even if its slot is reused later.
+		// IsValid never throws, Get returns nullptr for an invalid handle
+		bool IsValid(cActorHandle inActor) const { return p_actors.isValid(inActor); }
+		bool IsValid(cShapeHandle inShape) const { return p_shapes.isValid(inShape); }
+		bool IsValid(cContactHandle inContact) const { return p_contacts.isValid(inContact); }
+		cActor* GetActor(cActorHandle inActor) { return p_actors.get(inActor); }
+		cShape* GetShape(cShapeHandle inShape) { return p_shapes.get(inShape); }
+		cContact* GetContact(cContactHandle inContact) { return p_contacts.get(inContact); }
+
+		const cStepProfile& GetProfile() const { return m_profile; } // timings and counters of the last step
 
 		float fontSize = 14.0f;
 		void DebugDraw(cDebugDraw* draw);
 		bool runBasicSolver = false;
+		bool runWideSolver = false;	// the SIMD soft solver, ignored when runBasicSolver is set
+		bool enableSleep = true;	// islands that have been at rest for commons::TIME_TO_SLEEP are skipped until woken
+		bool continuousHitsDynamic = false;	// bullets are also stopped by non bullet dynamic and kinematic actors, not only by static ones
+		// Called for the pairs that pass their cFilter check, returns false to drop the pair. It is only asked again once one of
+		// the shapes is reinserted into the broadphase, and it is called from the task system threads during bullet sweeps
+		ShapeFilterCallback customFilter;
+		cTaskSystem* taskSystem = nullptr;	// runs the parallel phases of step (broadphase queries, narrowphase and solver), the world does not own it. If null, step runs on the calling thread only
+
+		// a contact only needs to be updated and solved if one of its actors is an awake dynamic actor
+		bool IsContactAwake(const cContact* contact) const
+		{
+			const cActor* actorA = p_actors.getUnchecked(contact->edges[0].bodyIndex);
+			const cActor* actorB = p_actors.getUnchecked(contact->edges[1].bodyIndex);
+			return (actorA->type == cActorType::DYNAMIC && actorA->awake) || (actorB->type == cActorType::DYNAMIC && actorB->awake);
+		}
+
+		// the exact ray cast against one shape, fills outHit and returns true on a hit
+		bool RayCastShape(const cRayCastInput& inInput, int inShapeIndex, cRayHit* outHit);
+		// the exact shape cast against one shape, fills outHit and returns true on a hit
+		bool ShapeCastShape(const cPolygon& inPolygon, const cTransform& inTransform, const cVec2& inTranslation, float inMaxFraction,
+			int inShapeIndex, cShapeCastHit* outHit);
 
 		cPool<cActor> p_actors;
 		cPool<cShape> p_shapes;
 		cFLUTable p_pairs;
 		cPool<cContact> p_contacts;
+		cPool<cIsland> p_islands;
+
+		cStepProfile m_profile;
 	};
+
+	template <typename T>
+	inline void cPhysicsWorld::RayCast(const cRayCastInput& inInput, T&& callback)
+	{
+		m_broadphase.RayCast(inInput, [this, &callback](const cRayCastInput& input, int proxyKey) -> float {
+			int shapeIndex = static_cast<int>(reinterpret_cast<intptr_t>(m_broadphase.GetUserData(proxyKey)));
+			cRayHit hit;
+			if (!RayCastShape(input, shapeIndex, &hit))
+				return -1.0f;
+			return callback(static_cast<const cRayHit&>(hit));
+			});
+	}
+
+	template <typename T>
+	inline void cPhysicsWorld::ShapeCast(const cPolygon& inPolygon, const cTransform& inTransform, const cVec2& inTranslation, T&& callback)
+	{
+		cRayCastInput input{ inTransform.p, inTranslation, 1.0f };
+		cAABB aabb = CreateAABBHull(inPolygon.vertices, inPolygon.count, inTransform);
+		m_broadphase.BoxCast(aabb, input, [&](const cRayCastInput& subInput, int proxyKey) -> float {
+			int shapeIndex = static_cast<int>(reinterpret_cast<intptr_t>(m_broadphase.GetUserData(proxyKey)));
+			cShapeCastHit hit;
+			if (!ShapeCastShape(inPolygon, inTransform, inTranslation, subInput.maxFraction, shapeIndex, &hit))
+				return -1.0f;
+			return callback(static_cast<const cShapeCastHit&>(hit));
+			});
+	}
 }
\ No newline at end of file
@@ -5,6 +5,7 @@
 #include "cprocessing.h"
 #include "uimanager.h"
 #include "parser.hpp"
+#include "scenes.h"
 
 using namespace chiori;
 
@@ -22,12 +23,13 @@ void PhysicsScene::Unload()
 	{
 		if (pWorld->p_actors.isValid(i))
 		{
-			int index = pWorld->IsFracturable(i);
+			cActorHandle actor = pWorld->p_actors.getHandle(pWorld->p_actors[i]);
+			int index = pWorld->IsFracturable(actor);
 			if (index >= 0)
 			{
 				pWorld->MakeUnfracturable(index);
 			}
-			pWorld->RemoveActor(i);
+			pWorld->RemoveActor(actor);
 		}
 	}
 }
@@ -72,29 +74,7 @@ public:
 
 	void Load() override
 	{
-		cFractureWorld* pWorld = static_cast<cFractureWorld*>(world);
-
-		// Create a floor
-		ActorConfig a_config;
-		a_config.type = cActorType::STATIC;
-		int floorID = pWorld->CreateActor(a_config);
-
-		ShapeConfig s_config;
-		s_config.friction = 0.2f;
-		cPolygon floorShape = GeomMakeBox(10.0f, 0.25f);
-		int floorShapeIndex = pWorld->CreateShape(floorID, s_config, &floorShape);
-
-		// Create the ground box
-		a_config.type = cActorType::DYNAMIC;
-		a_config.position = { 0.0f, 1.0f };
-		int boxID = pWorld->CreateActor(a_config);
-		cPolygon box = GeomMakeBox(1.0f, 1.0f);
-		int boxShapeIndex = pWorld->CreateShape(boxID, s_config, &box);
-
-		// Create the top box
-		a_config.position = { 0.25f, 3.5f };
-		int boxID2 = pWorld->CreateActor(a_config);
-		int boxShapeIndex2 = pWorld->CreateShape(boxID2, s_config, &box);
+		BuildDefaultScene(static_cast<cFractureWorld*>(world));
 
 		// configure camera
 		{
@@ -119,16 +99,16 @@ public:
 		// Create a floor
 		ActorConfig a_config;
 		a_config.type = cActorType::STATIC;
-		int staticID = pWorld->CreateActor(a_config);
+		cActorHandle staticID = pWorld->CreateActor(a_config);
 
 		a_config.position = { 0.0f, 10.0f };
 		a_config.angle = -0.25f;
-		int staticID2 = pWorld->CreateActor(a_config);
+		cActorHandle staticID2 = pWorld->CreateActor(a_config);
 
 		ShapeConfig s_config;
 		s_config.friction = 0.2f;
 		cPolygon floorShape = GeomMakeBox(15.0f, 0.25f);
-		int floorShapeIndex = pWorld->CreateShape(staticID, s_config, &floorShape);
+		cShapeHandle floorShapeIndex = pWorld->CreateShape(staticID, s_config, &floorShape);
 
 		cPolygon ramp = GeomMakeOffsetBox(6.0f, 0.25f, { -3.0f, 12.0f }, -0.25f);
 		pWorld->CreateShape(staticID, s_config, &ramp);
@@ -154,7 +134,7 @@ public:
 			ActorConfig box_config;
 			box_config.type = cActorType::DYNAMIC;
 			box_config.position = { -8.0f + 2.0f * i, 14.0f };
-			int bodyId = pWorld->CreateActor(box_config);
+			cActorHandle bodyId = pWorld->CreateActor(box_config);
 
 			s_config.friction = friction[i];
 			pWorld->CreateShape(bodyId, s_config, &box);
@@ -163,7 +143,7 @@ public:
 		ActorConfig frac_config;
 		frac_config.type = cActorType::DYNAMIC;
 		frac_config.position = { 6.5f, 1.5f };
-		int fracId = pWorld->CreateActor(frac_config);
+		cActorHandle fracId = pWorld->CreateActor(frac_config);
 
 		cPolygon fracturableWall = GeomMakeBox(0.5f, 1.25f);
 		s_config.friction = 1.0f;
@@ -198,38 +178,7 @@ public:
 
 	void Load() override
 	{
-		cFractureWorld* pWorld = static_cast<cFractureWorld*>(world);
-
-		// Create a floor
-		ActorConfig a_config;
-		a_config.position = { 0.0f, -1.0f };
-		a_config.type = cActorType::STATIC;
-		int staticID = pWorld->CreateActor(a_config);
-
-		ShapeConfig s_config;
-		cPolygon floorShape = GeomMakeBox(20.0f, 1.0f);
-		pWorld->CreateShape(staticID, s_config, &floorShape);
-
-		// Create row of dominos
-		cPolygon box = GeomMakeBox(0.125f, 0.5f);
-		s_config.friction = 0.6f;
-		a_config.type = cActorType::DYNAMIC;
-
-		int count = 17;
-		float x = -0.5f * count;
-		for (int i = 0; i < count; ++i)
-		{
-			a_config.position = { x, 0.5f };
-			int bodyId = pWorld->CreateActor(a_config);
-			pWorld->CreateShape(bodyId, s_config, &box);
-			if (i == 0)
-			{
-				cActor* actor = pWorld->p_actors[bodyId];
-				actor->applyImpulse({ 0.2f, 0.0f }, { x, 1.0f });
-			}
-
-			x += 1.0f;
-		}
+		BuildDominoScene(static_cast<cFractureWorld*>(world));
 
 		{
 			currentZoom = 75.0f;
@@ -247,42 +196,7 @@ public:
 
 	void Load() override
 	{
-		cFractureWorld* pWorld = static_cast<cFractureWorld*>(world);
-
-		// Create a floor
-		ActorConfig a_config;
-		a_config.position = { 0.0f, -1.0f };
-		a_config.type = cActorType::STATIC;
-		int staticID = pWorld->CreateActor(a_config);
-		ShapeConfig s_config;
-		cPolygon floorShape = GeomMakeBox(10.0f, 1.0f);
-		pWorld->CreateShape(staticID, s_config, &floorShape);
-
-
-		int baseCount = 4;
-		float overlap = 0.25f;
-		float extent = 0.5f;
-		float fraction = 1.0f - overlap;
-		float y = 0.3f;
-
-		a_config.type = cActorType::DYNAMIC;
-		cPolygon box = GeomMakeBox(extent, extent);
-
-		for (int i = 0; i < baseCount; ++i)
-		{
-			float x = fraction * extent * (i - baseCount);
-			for (int j = i; j < baseCount; ++j)
-			{
-				a_config.position = { x, y };
-				int bodyId = pWorld->CreateActor(a_config);
-
-				pWorld->CreateShape(bodyId, s_config, &box);
-
-				x += 2.0f * fraction * extent;
-			}
-
-			y += 2.0f * fraction * extent;
-		}
+		BuildOverlapRecoveryScene(static_cast<cFractureWorld*>(world));
 	}
 };
 // Loads in a scene with a stack of 6 boxes on one side
@@ -295,49 +209,7 @@ public:
 
 	void Load() override
 	{
-		cFractureWorld* pWorld = static_cast<cFractureWorld*>(world);
-
-		// Create a floor
-		ActorConfig a_config;
-		a_config.position = { 0.0f, -1.0f };
-		a_config.type = cActorType::STATIC;
-		int staticID = pWorld->CreateActor(a_config);
-
-		ShapeConfig s_config;
-		cPolygon floorShape = GeomMakeBox(20.0f, 1.0f);
-		pWorld->CreateShape(staticID, s_config, &floorShape);
-
-		// Create the stack of 5 boxes on one side
-		cPolygon boxShape = GeomMakeBox(0.5f, 0.5f); // Box dimensions: 1x1
-		s_config.friction = 0.5f;
-		int boxCount = 6;
-		a_config.type = cActorType::DYNAMIC;
-		float xStack = -5.0f; // Position of the stack
-		float yStack = 1.0f;  // Start from the ground
-
-		for (int i = 0; i < boxCount; ++i)
-		{
-			a_config.position = { xStack, yStack };
-			int bodyId = pWorld->CreateActor(a_config);
-			pWorld->CreateShape(bodyId, s_config, &boxShape);
-
-			yStack += 1.0f; // Stack each box 1 unit higher
-		}
-
-		// Create the tower of Lire (block-stacking problem) on the other side
-		float xTower = 5.0f; // Position of the tower
-		float yTower = 0.0f + 1.0f * boxCount; // Start from the top
-
-		for (int i = 0; i < boxCount; ++i)
-		{
-			float offset = 1.0f / (2.0f * (i + 1)); // Offset for overhang, largest at the top
-
-			a_config.position = { xTower + offset, yTower };
-			int bodyId = pWorld->CreateActor(a_config);
-			pWorld->CreateShape(bodyId, s_config, &boxShape);
-
-			yTower -= 1.0f; // Raise the next box
-		}
+		BuildStackScene(static_cast<cFractureWorld*>(world));
 
 		// Configure the camera to view both setups
 		{
@@ -358,7 +230,7 @@ public:
 
 	void Load() override
 	{
-		cFractureWorld* pWorld = static_cast<cFractureWorld*>(world);
+		BuildArchScene(static_cast<cFractureWorld*>(world));
 
 		// Configure camera
 		{
@@ -366,84 +238,6 @@ public:
 			drawer->ChangeZoom(currentZoom);
 			drawer->SetCamera({ 0.0f, 8.0f });
 		}
-
-		// Define polygon points for the arch
-		cVec2 ps1[9] = { {16.0f, 0.0f},
-						{14.93803712795643f, 5.133601056842984f},
-						{13.79871746027416f, 10.24928069555078f},
-						{12.56252963284711f, 15.34107019122473f},
-						{11.20040987372525f, 20.39856541571217f},
-						{9.66521217819836f, 25.40369899225096f},
-						{7.87179930638133f, 30.3179337000085f},
-						{5.635199558196225f, 35.03820717801641f},
-						{2.405937953536585f, 39.09554102558315f} };
-
-		cVec2 ps2[9] = { {24.0f, 0.0f},
-						{22.33619528222415f, 6.02299846205841f},
-						{20.54936888969905f, 12.00964361211476f},
-						{18.60854610798073f, 17.9470321677465f},
-						{16.46769273811807f, 23.81367936585418f},
-						{14.05325025774858f, 29.57079353071012f},
-						{11.23551045834022f, 35.13775818285372f},
-						{7.752568160730571f, 40.30450679009583f},
-						{3.016931552701656f, 44.28891593799322f} };
-
-		// Scale the points
-		float scale = 0.25f;
-		for (int i = 0; i < 9; ++i)
-		{
-			ps1[i] = ps1[i] * scale;
-			ps2[i] = ps2[i] * scale;
-		}
-
-
-		// Create a floor
-		ActorConfig a_config;
-		a_config.position = { 0.0f, -2.0f };
-		a_config.type = cActorType::STATIC;
-		int staticID = pWorld->CreateActor(a_config);
-
-		ShapeConfig s_config;
-		s_config.friction = 0.6f;
-		cPolygon floorShape = GeomMakeBox(100.0f, 1.0f);
-		pWorld->CreateShape(staticID, s_config, &floorShape);
-
-		a_config.position = { 0.0f, 0.0f };
-		// Create left side of the arch
-		ActorConfig dynamicConfig;
-		dynamicConfig.type = cActorType::DYNAMIC;
-		for (int i = 0; i < 8; ++i)
-		{
-			cVec2 ps[4] = { ps1[i], ps2[i], ps2[i + 1], ps1[i + 1] };
-			cPolygon polygon{ ps, 4 };
-			dynamicConfig.position = { 0.0f, 0.0f };
-			int bodyID = pWorld->CreateActor(dynamicConfig);
-
-			pWorld->CreateShape(bodyID, s_config, &polygon);
-		}
-
-		// Create right side of the arch
-		for (int i = 0; i < 8; ++i)
-		{
-			cVec2 ps[4] = {
-				{-ps2[i].x, ps2[i].y}, {-ps1[i].x, ps1[i].y}, {-ps1[i + 1].x, ps1[i + 1].y}, {-ps2[i + 1].x, ps2[i + 1].y} };
-			cPolygon polygon{ ps, 4 };
-			dynamicConfig.position = { 0.0f, 0.0f };
-			int bodyID = pWorld->CreateActor(dynamicConfig);
-
-			pWorld->CreateShape(bodyID, s_config, &polygon);
-		}
-
-		// Create the top of the arch
-		{
-			cVec2 ps[4] = { ps1[8], ps2[8], {-ps2[8].x, ps2[8].y}, {-ps1[8].x, ps1[8].y} };
-			cPolygon polygon{ ps, 4 };
-			dynamicConfig.position = { 0.0f, 0.0f };
-			int bodyID = pWorld->CreateActor(dynamicConfig);
-
-			pWorld->CreateShape(bodyID, s_config, &polygon);
-		}
-
 	}
 };
 // Loads in a scene with a heap of polygons of varying sizes
@@ -456,42 +250,7 @@ public:
 
 	void Load() override
 	{
-		cFractureWorld* pWorld = static_cast<cFractureWorld*>(world);
-
-		// Create a confining box
-		ActorConfig a_config;
-		a_config.position = { 0.0f, -1.0f };
-		a_config.type = cActorType::STATIC;
-		int staticID = pWorld->CreateActor(a_config);
-
-		ShapeConfig s_config;
-		cPolygon wallShape = GeomMakeOffsetBox(15.0f, 0.25f, { 0.0f, 0.0f });
-		pWorld->CreateShape(staticID, s_config, &wallShape);
-
-		wallShape = GeomMakeOffsetBox(15.0f, 0.25f, { 0.0f, 30.0f });
-		pWorld->CreateShape(staticID, s_config, &wallShape);
-
-		wallShape = GeomMakeOffsetBox(0.25f, 15.0f, { 15.25f, 15.0f });
-		pWorld->CreateShape(staticID, s_config, &wallShape);
-
-		wallShape = GeomMakeOffsetBox(0.25f, 15.0f, { -15.25f, 15.0f });
-		pWorld->CreateShape(staticID, s_config, &wallShape);
-
-
-		a_config.type = cActorType::DYNAMIC;
-		// create a heap of polygons
-		for (int iy = 1; iy < 5; ++iy)
-		{
-			for (int i = 3; i < 8; ++i)
-			{
-				cPolygon poly = GeomMakeRegularPolygon(i);
-
-				a_config.position = { -5.0f + 1.0f * i, iy * 2.0f };
-
-				int bodyID = pWorld->CreateActor(a_config);
-				pWorld->CreateShape(bodyID, s_config, &poly);
-			}
-		}
+		BuildPolygonScene(static_cast<cFractureWorld*>(world));
 	}
 
 	void Update(float dt) override
@@ -502,12 +261,10 @@ public:
 		cFractureWorld* pWorld = static_cast<cFractureWorld*>(world);
 		if (CP_Input_KeyTriggered(KEY_R))
 		{
-			int bodyID = -1;
-			while (!pWorld->p_actors.isValid(bodyID))
-			{
-				bodyID = CP_Random_RangeInt(0, pWorld->p_actors.capacity() - 1);
-			}
-			cActor* actor = pWorld->p_actors[bodyID];
+			if (pWorld->p_actors.size() == 0)
+				return;
+			int denseIndex = CP_Random_RangeInt(0, static_cast<int>(pWorld->p_actors.size()) - 1);
+			cActor* actor = pWorld->p_actors.getDense(denseIndex);
 
 			float xforce = CP_Random_RangeFloat(-100.0f, 100.0f);
 			float yforce = CP_Random_RangeFloat(-100.0f, 100.0f);
@@ -521,7 +278,7 @@ public:
 
 class SelfBalancingBoxScene : public PhysicsScene
 {
-	int boxID{ -1 };
+	cActorHandle boxID;
 	const cManifoldPoint* mp = nullptr;
 public:
 	SelfBalancingBoxScene(DebugGraphics* drawer, void* world) : PhysicsScene(drawer, world) {}
@@ -533,7 +290,7 @@ public:
 		// Create a floor
 		ActorConfig a_config;
 		a_config.type = cActorType::STATIC;
-		int floorID = pWorld->CreateActor(a_config);
+		cActorHandle floorID = pWorld->CreateActor(a_config);
 
 		ShapeConfig s_config;
 		s_config.friction = 0.2f;
@@ -541,7 +298,7 @@ public:
 		pWorld->CreateShape(floorID, s_config, &floorShape);
 
 		// Create Walls
-		int wallID = pWorld->CreateActor(a_config);
+		cActorHandle wallID = pWorld->CreateActor(a_config);
 		cPolygon wallShape = GeomMakeOffsetBox(0.25f, 10.0f, { -7.0f, 0.0f });
 		pWorld->CreateShape(wallID, s_config, &wallShape);
 		wallShape = GeomMakeOffsetBox(0.25f, 10.0f, { 7.0f, 0.0f });
@@ -555,7 +312,7 @@ public:
 		boxID = pWorld->CreateActor(a_config);
 		cPolygon box = GeomMakeBox(0.5f, 0.5f);
 
-		int boxShapeIndex = pWorld->CreateShape(boxID, s_config, &box);
+		cShapeHandle boxShapeIndex = pWorld->CreateShape(boxID, s_config, &box);
 
 		// configure camera
 		{
@@ -571,7 +328,7 @@ public:
 
 		// Apply a force to the box to keep it balanced on its tip everytime it collides with the ground on one side
 		cFractureWorld* pWorld = static_cast<cFractureWorld*>(world);
-		cActor* boxActor = pWorld->p_actors[boxID];
+		cActor* boxActor = pWorld->GetActor(boxID);
 		if (boxActor)
 		{
 			cTransform xf = boxActor->getTransform();
@@ -623,41 +380,7 @@ public:
 
 	void Load() override
 	{
-		cFractureWorld* pWorld = static_cast<cFractureWorld*>(world);
-
-		// Create a floor
-		ActorConfig a_config;
-		a_config.type = cActorType::STATIC;
-		int floorID = pWorld->CreateActor(a_config);
-
-		ShapeConfig s_config;
-		s_config.friction = 0.2f;
-		cPolygon floorShape = GeomMakeBox(10.0f, 0.25f);
-		pWorld->CreateShape(floorID, s_config, &floorShape);
-
-		// Create Walls
-		int wallID = pWorld->CreateActor(a_config);
-		cPolygon wallShape = GeomMakeOffsetBox(0.25f, 10.0f, { -7.0f, 0.0f });
-		pWorld->CreateShape(wallID, s_config, &wallShape);
-		wallShape = GeomMakeOffsetBox(0.25f, 10.0f, { 7.0f, 0.0f });
-		pWorld->CreateShape(wallID, s_config, &wallShape);
-
-		// Create the ground box
-		a_config.type = cActorType::DYNAMIC;
-		a_config.position = { 0.0f, 3.0f };
-		a_config.angle = 45.1f * DEG2RAD;
-		a_config.angularDamping = 0.75f;
-		int boxID = pWorld->CreateActor(a_config);
-		cPolygon box = GeomMakeBox(0.5f, 0.5f);
-		int boxShapeIndex = pWorld->CreateShape(boxID, s_config, &box);
-		cFractureMaterial fmat;
-		fmat.k = 0.0f;
-		pWorld->MakeFracturable(boxID, fmat);
-
-		a_config.position = { 3.0f, 3.0f };
-		int box2ID = pWorld->CreateActor(a_config);
-		int boxShape2Index = pWorld->CreateShape(box2ID, s_config, &box);
-		pWorld->MakeFracturable(box2ID, fmat);
+		BuildFractureTestScene(static_cast<cFractureWorld*>(world));
 
 		// configure camera
 		{
@@ -0,0 +1,388 @@
+#include "pch.h"
+#include "scenes.h"
+#include "fractureWorld.h"
+
+using namespace chiori;
+
+// 2 stacked boxes and a floor
+// Shows basic physics simulation with collision and gravity
+void BuildDefaultScene(cFractureWorld* pWorld)
+{
+	// Create a floor
+	ActorConfig a_config;
+	a_config.type = cActorType::STATIC;
+	cActorHandle floorID = pWorld->CreateActor(a_config);
+
+	ShapeConfig s_config;
+	s_config.friction = 0.2f;
+	cPolygon floorShape = GeomMakeBox(10.0f, 0.25f);
+	pWorld->CreateShape(floorID, s_config, &floorShape);
+
+	// Create the ground box
+	a_config.type = cActorType::DYNAMIC;
+	a_config.position = { 0.0f, 1.0f };
+	cActorHandle boxID = pWorld->CreateActor(a_config);
+	cPolygon box = GeomMakeBox(1.0f, 1.0f);
+	pWorld->CreateShape(boxID, s_config, &box);
+
+	// Create the top box
+	a_config.position = { 0.25f, 3.5f };
+	cActorHandle boxID2 = pWorld->CreateActor(a_config);
+	pWorld->CreateShape(boxID2, s_config, &box);
+}
+
+// A row of 17 dominos, with the first one set to fall
+// The dominos should knock each other over, then at the end,
+// the last domino should fall in a way to push all the previous dominos flat (double-domino effect)
+void BuildDominoScene(cFractureWorld* pWorld)
+{
+	// Create a floor
+	ActorConfig a_config;
+	a_config.position = { 0.0f, -1.0f };
+	a_config.type = cActorType::STATIC;
+	cActorHandle staticID = pWorld->CreateActor(a_config);
+
+	ShapeConfig s_config;
+	cPolygon floorShape = GeomMakeBox(20.0f, 1.0f);
+	pWorld->CreateShape(staticID, s_config, &floorShape);
+
+	// Create row of dominos
+	cPolygon box = GeomMakeBox(0.125f, 0.5f);
+	s_config.friction = 0.6f;
+	a_config.type = cActorType::DYNAMIC;
+
+	int count = 17;
+	float x = -0.5f * count;
+	for (int i = 0; i < count; ++i)
+	{
+		a_config.position = { x, 0.5f };
+		cActorHandle bodyId = pWorld->CreateActor(a_config);
+		pWorld->CreateShape(bodyId, s_config, &box);
+		if (i == 0)
+		{
+			cActor* actor = pWorld->p_actors[bodyId];
+			actor->applyImpulse({ 0.2f, 0.0f }, { x, 1.0f });
+		}
+
+		x += 1.0f;
+	}
+}
+
+// A pyramid of boxes that are intially overlapping
+// The scene should recover from the overlap and stabilize
+void BuildOverlapRecoveryScene(cFractureWorld* pWorld)
+{
+	// Create a floor
+	ActorConfig a_config;
+	a_config.position = { 0.0f, -1.0f };
+	a_config.type = cActorType::STATIC;
+	cActorHandle staticID = pWorld->CreateActor(a_config);
+	ShapeConfig s_config;
+	cPolygon floorShape = GeomMakeBox(10.0f, 1.0f);
+	pWorld->CreateShape(staticID, s_config, &floorShape);
+
+	int baseCount = 4;
+	float overlap = 0.25f;
+	float extent = 0.5f;
+	float fraction = 1.0f - overlap;
+	float y = 0.3f;
+
+	a_config.type = cActorType::DYNAMIC;
+	cPolygon box = GeomMakeBox(extent, extent);
+
+	for (int i = 0; i < baseCount; ++i)
+	{
+		float x = fraction * extent * (i - baseCount);
+		for (int j = i; j < baseCount; ++j)
+		{
+			a_config.position = { x, y };
+			cActorHandle bodyId = pWorld->CreateActor(a_config);
+
+			pWorld->CreateShape(bodyId, s_config, &box);
+
+			x += 2.0f * fraction * extent;
+		}
+
+		y += 2.0f * fraction * extent;
+	}
+}
+
+// A stack of 6 boxes on one side and a Tower of Lire of 6 boxes on the other
+// The scene should demonstrate the stability of the physics simulation
+void BuildStackScene(cFractureWorld* pWorld)
+{
+	// Create a floor
+	ActorConfig a_config;
+	a_config.position = { 0.0f, -1.0f };
+	a_config.type = cActorType::STATIC;
+	cActorHandle staticID = pWorld->CreateActor(a_config);
+
+	ShapeConfig s_config;
+	cPolygon floorShape = GeomMakeBox(20.0f, 1.0f);
+	pWorld->CreateShape(staticID, s_config, &floorShape);
+
+	// Create the stack of 5 boxes on one side
+	cPolygon boxShape = GeomMakeBox(0.5f, 0.5f); // Box dimensions: 1x1
+	s_config.friction = 0.5f;
+	int boxCount = 6;
+	a_config.type = cActorType::DYNAMIC;
+	float xStack = -5.0f; // Position of the stack
+	float yStack = 1.0f;  // Start from the ground
+
+	for (int i = 0; i < boxCount; ++i)
+	{
+		a_config.position = { xStack, yStack };
+		cActorHandle bodyId = pWorld->CreateActor(a_config);
+		pWorld->CreateShape(bodyId, s_config, &boxShape);
+
+		yStack += 1.0f; // Stack each box 1 unit higher
+	}
+
+	// Create the tower of Lire (block-stacking problem) on the other side
+	float xTower = 5.0f; // Position of the tower
+	float yTower = 0.0f + 1.0f * boxCount; // Start from the top
+
+	for (int i = 0; i < boxCount; ++i)
+	{
+		float offset = 1.0f / (2.0f * (i + 1)); // Offset for overhang, largest at the top
+
+		a_config.position = { xTower + offset, yTower };
+		cActorHandle bodyId = pWorld->CreateActor(a_config);
+		pWorld->CreateShape(bodyId, s_config, &boxShape);
+
+		yTower -= 1.0f; // Raise the next box
+	}
+}
+
+// An arch held up by friction and their contact points
+// The scene should further demonstrate the stability of the physics simulation
+void BuildArchScene(cFractureWorld* pWorld)
+{
+	// Define polygon points for the arch
+	cVec2 ps1[9] = { {16.0f, 0.0f},
+					{14.93803712795643f, 5.133601056842984f},
+					{13.79871746027416f, 10.24928069555078f},
+					{12.56252963284711f, 15.34107019122473f},
+					{11.20040987372525f, 20.39856541571217f},
+					{9.66521217819836f, 25.40369899225096f},
+					{7.87179930638133f, 30.3179337000085f},
+					{5.635199558196225f, 35.03820717801641f},
+					{2.405937953536585f, 39.09554102558315f} };
+
+	cVec2 ps2[9] = { {24.0f, 0.0f},
+					{22.33619528222415f, 6.02299846205841f},
+					{20.54936888969905f, 12.00964361211476f},
+					{18.60854610798073f, 17.9470321677465f},
+					{16.46769273811807f, 23.81367936585418f},
+					{14.05325025774858f, 29.57079353071012f},
+					{11.23551045834022f, 35.13775818285372f},
+					{7.752568160730571f, 40.30450679009583f},
+					{3.016931552701656f, 44.28891593799322f} };
+
+	// Scale the points
+	float scale = 0.25f;
+	for (int i = 0; i < 9; ++i)
+	{
+		ps1[i] = ps1[i] * scale;
+		ps2[i] = ps2[i] * scale;
+	}
+
+	// Create a floor
+	ActorConfig a_config;
+	a_config.position = { 0.0f, -2.0f };
+	a_config.type = cActorType::STATIC;
+	cActorHandle staticID = pWorld->CreateActor(a_config);
+
+	ShapeConfig s_config;
+	s_config.friction = 0.6f;
+	cPolygon floorShape = GeomMakeBox(100.0f, 1.0f);
+	pWorld->CreateShape(staticID, s_config, &floorShape);
+
+	a_config.position = { 0.0f, 0.0f };
+	// Create left side of the arch
+	ActorConfig dynamicConfig;
+	dynamicConfig.type = cActorType::DYNAMIC;
+	for (int i = 0; i < 8; ++i)
+	{
+		cVec2 ps[4] = { ps1[i], ps2[i], ps2[i + 1], ps1[i + 1] };
+		cPolygon polygon{ ps, 4 };
+		dynamicConfig.position = { 0.0f, 0.0f };
+		cActorHandle bodyID = pWorld->CreateActor(dynamicConfig);
+
+		pWorld->CreateShape(bodyID, s_config, &polygon);
+	}
+
+	// Create right side of the arch
+	for (int i = 0; i < 8; ++i)
+	{
+		cVec2 ps[4] = {
+			{-ps2[i].x, ps2[i].y}, {-ps1[i].x, ps1[i].y}, {-ps1[i + 1].x, ps1[i + 1].y}, {-ps2[i + 1].x, ps2[i + 1].y} };
+		cPolygon polygon{ ps, 4 };
+		dynamicConfig.position = { 0.0f, 0.0f };
+		cActorHandle bodyID = pWorld->CreateActor(dynamicConfig);
+
+		pWorld->CreateShape(bodyID, s_config, &polygon);
+	}
+
+	// Create the top of the arch
+	{
+		cVec2 ps[4] = { ps1[8], ps2[8], {-ps2[8].x, ps2[8].y}, {-ps1[8].x, ps1[8].y} };
+		cPolygon polygon{ ps, 4 };
+		dynamicConfig.position = { 0.0f, 0.0f };
+		cActorHandle bodyID = pWorld->CreateActor(dynamicConfig);
+
+		pWorld->CreateShape(bodyID, s_config, &polygon);
+	}
+}
+
+// A heap of polygons of varying sizes in a confining box
+// This showcases the engine can support more complex shapes
+void BuildPolygonScene(cFractureWorld* pWorld)
+{
+	// Create a confining box
+	ActorConfig a_config;
+	a_config.position = { 0.0f, -1.0f };
+	a_config.type = cActorType::STATIC;
+	cActorHandle staticID = pWorld->CreateActor(a_config);
+
+	ShapeConfig s_config;
+	cPolygon wallShape = GeomMakeOffsetBox(15.0f, 0.25f, { 0.0f, 0.0f });
+	pWorld->CreateShape(staticID, s_config, &wallShape);
+
+	wallShape = GeomMakeOffsetBox(15.0f, 0.25f, { 0.0f, 30.0f });
+	pWorld->CreateShape(staticID, s_config, &wallShape);
+
+	wallShape = GeomMakeOffsetBox(0.25f, 15.0f, { 15.25f, 15.0f });
+	pWorld->CreateShape(staticID, s_config, &wallShape);
+
+	wallShape = GeomMakeOffsetBox(0.25f, 15.0f, { -15.25f, 15.0f });
+	pWorld->CreateShape(staticID, s_config, &wallShape);
+
+	a_config.type = cActorType::DYNAMIC;
+	// create a heap of polygons
+	for (int iy = 1; iy < 5; ++iy)
+	{
+		for (int i = 3; i < 8; ++i)
+		{
+			cPolygon poly = GeomMakeRegularPolygon(i);
+
+			a_config.position = { -5.0f + 1.0f * i, iy * 2.0f };
+
+			cActorHandle bodyID = pWorld->CreateActor(a_config);
+			pWorld->CreateShape(bodyID, s_config, &poly);
+		}
+	}
+}
+
+// Two fracturable boxes dropped between two walls, they shatter on first impact
+void BuildFractureTestScene(cFractureWorld* pWorld)
+{
+	// Create a floor
+	ActorConfig a_config;
+	a_config.type = cActorType::STATIC;
+	cActorHandle floorID = pWorld->CreateActor(a_config);
+
+	ShapeConfig s_config;
+	s_config.friction = 0.2f;
+	cPolygon floorShape = GeomMakeBox(10.0f, 0.25f);
+	pWorld->CreateShape(floorID, s_config, &floorShape);
+
+	// Create Walls
+	cActorHandle wallID = pWorld->CreateActor(a_config);
+	cPolygon wallShape = GeomMakeOffsetBox(0.25f, 10.0f, { -7.0f, 0.0f });
+	pWorld->CreateShape(wallID, s_config, &wallShape);
+	wallShape = GeomMakeOffsetBox(0.25f, 10.0f, { 7.0f, 0.0f });
+	pWorld->CreateShape(wallID, s_config, &wallShape);
+
+	// Create the ground box
+	a_config.type = cActorType::DYNAMIC;
+	a_config.position = { 0.0f, 3.0f };
+	a_config.angle = 45.1f * DEG2RAD;
+	a_config.angularDamping = 0.75f;
+	cActorHandle boxID = pWorld->CreateActor(a_config);
+	cPolygon box = GeomMakeBox(0.5f, 0.5f);
+	pWorld->CreateShape(boxID, s_config, &box);
+	cFractureMaterial fmat;
+	fmat.k = 0.0f;
+	pWorld->MakeFracturable(boxID, fmat);
+
+	a_config.position = { 3.0f, 3.0f };
+	cActorHandle box2ID = pWorld->CreateActor(a_config);
+	pWorld->CreateShape(box2ID, s_config, &box);
+	pWorld->MakeFracturable(box2ID, fmat);
+}
+
+// 600 fracturable boxes in rows thrown down and sideways, they shatter into about 1800 fragments.
+// The fragments of each row fly apart together, a stress test for the broadphase. The boxes and their fragments get inDebrisFilter
+static void BuildDebris(cFractureWorld* pWorld, const cFilter& inDebrisFilter)
+{
+	ActorConfig a_config;
+	a_config.type = cActorType::STATIC;
+	cActorHandle floorID = pWorld->CreateActor(a_config);
+
+	ShapeConfig s_config;
+	cPolygon floorShape = GeomMakeBox(100.0f, 0.5f);
+	pWorld->CreateShape(floorID, s_config, &floorShape);
+
+	// walls keep the fragments in, a fragment falling forever keeps its island awake
+	cPolygon wallShape = GeomMakeOffsetBox(0.5f, 40.0f, { -100.0f, 40.0f });
+	pWorld->CreateShape(floorID, s_config, &wallShape);
+	wallShape = GeomMakeOffsetBox(0.5f, 40.0f, { 100.0f, 40.0f });
+	pWorld->CreateShape(floorID, s_config, &wallShape);
+
+	a_config.type = cActorType::DYNAMIC;
+	s_config.filter = inDebrisFilter;
+	cPolygon box = GeomMakeBox(0.5f, 0.5f);
+	cFractureMaterial fmat;
+	fmat.k = 0.0f;
+	for (int row = 0; row < 12; ++row)
+	{
+		for (int column = 0; column < 50; ++column)
+		{
+			a_config.position = { -75.0f + column * 3.0f, 3.0f + row * 2.5f };
+			a_config.linearVelocity = { (row % 2 == 0) ? 8.0f : -8.0f, -20.0f };
+			cActorHandle boxID = pWorld->CreateActor(a_config);
+			pWorld->CreateShape(boxID, s_config, &box);
+			pWorld->MakeFracturable(boxID, fmat);
+		}
+	}
+}
+
+void BuildDebrisScene(cFractureWorld* pWorld)
+{
+	BuildDebris(pWorld, cFilter{});
+}
+
+// the debris scene where the debris only collides with the floor and the walls
+void BuildDebrisFilterScene(cFractureWorld* pWorld)
+{
+	const uint32_t worldCategory = 0x0001;
+	const uint32_t debrisCategory = 0x0002;
+	BuildDebris(pWorld, cFilter{ debrisCategory, worldCategory, 0 });
+}
+
+const std::vector<SceneEntry>& GetSceneEntries()
+{
+	static const std::vector<SceneEntry> entries = {
+		{ "DefaultScene", BuildDefaultScene },
+		{ "StackScene", BuildStackScene },
+		{ "ArchScene", BuildArchScene },
+		{ "DominoScene", BuildDominoScene },
+		{ "PolygonScene", BuildPolygonScene },
+		{ "FractureTestScene", BuildFractureTestScene },
+		{ "OverlapRecoveryScene", BuildOverlapRecoveryScene },
+		{ "DebrisScene", BuildDebrisScene },
+		{ "DebrisFilterScene", BuildDebrisFilterScene },
+	};
+	return entries;
+}
+
+SceneBuilder FindSceneBuilder(const char* name)
+{
+	for (const SceneEntry& entry : GetSceneEntries())
+	{
+		if (strcmp(entry.name, name) == 0)
+			return entry.build;
+	}
+	return nullptr;
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <vector>
+
+namespace chiori
+{
+	class cFractureWorld;
+}
+
+// World-only scene builders. These only populate the world and leave the camera
+// and UI to the caller, so the same scenes can be loaded by the GUI or headless
+void BuildDefaultScene(chiori::cFractureWorld* world);
+void BuildDominoScene(chiori::cFractureWorld* world);
+void BuildOverlapRecoveryScene(chiori::cFractureWorld* world);
+void BuildStackScene(chiori::cFractureWorld* world);
+void BuildArchScene(chiori::cFractureWorld* world);
+void BuildPolygonScene(chiori::cFractureWorld* world);
+void BuildFractureTestScene(chiori::cFractureWorld* world);
+void BuildDebrisScene(chiori::cFractureWorld* world);
+void BuildDebrisFilterScene(chiori::cFractureWorld* world);
+
+using SceneBuilder = void (*)(chiori::cFractureWorld*);
+
+struct SceneEntry
+{
+	const char* name;	// the scene class name, e.g. "StackScene"
+	SceneBuilder build;
+};
+
+// All the scenes that can be built without a renderer
+const std::vector<SceneEntry>& GetSceneEntries();
+
+// Finds a scene builder by name, returns nullptr if there is no such scene
+SceneBuilder FindSceneBuilder(const char* name);
@@ -10,16 +10,28 @@ namespace chiori
 {
 	#define MaxBaumgarteVelocity 4.0f
 
-	static void PGSSoftContactSolver(cPhysicsWorld* world, ContactConstraint* constraints, int constraintCount, float inv_h, bool useBias)
+#if CHIORI_PROFILE
+	void RecordSolverPass(cStepProfile& profile, const cTimer& timer)
 	{
-		auto& actors = world->p_actors;
+		if (profile.solverPassCount < MAX_PROFILED_SOLVER_PASSES)
+		{
+			profile.solverPasses[profile.solverPassCount] = timer.getMilliseconds();
+			profile.solverPassCount += 1;
+		}
+	}
+#endif
+
+	static void PGSSoftContactSolver(cSolverBodySet* set, ContactConstraint* constraints, int constraintCount, float inv_h, bool useBias)
+	{
+		cSolverBody* bodies = set->bodies;
+		int dynamicCount = set->dynamicCount;
 
 		for (int i = 0; i < constraintCount; ++i)
 		{
 			ContactConstraint* constraint = constraints + i;
 
-			cActor* bodyA = actors[constraint->indexA];
-			cActor* bodyB = actors[constraint->indexB];
+			cSolverBody* bodyA = bodies + constraint->indexA;
+			cSolverBody* bodyB = bodies + constraint->indexB;
 
 			float mA = bodyA->invMass;
 			float iA = bodyA->invInertia;
@@ -116,35 +128,119 @@ namespace chiori
 				wB += iB * cross(rB, P);
 			}
 
-			bodyA->linearVelocity = vA;
-			bodyA->angularVelocity = wA;
-			bodyB->linearVelocity = vB;
-			bodyB->angularVelocity = wB;
+			// only dynamic bodies are written, static and kinematic bodies can be shared by the constraints of a color
+			if (constraint->indexA < dynamicCount)
+			{
+				bodyA->linearVelocity = vA;
+				bodyA->angularVelocity = wA;
+			}
+			if (constraint->indexB < dynamicCount)
+			{
+				bodyB->linearVelocity = vB;
+				bodyB->angularVelocity = wB;
+			}
 		}
 	}
 
-	void PGSSoftSolver(cPhysicsWorld* world, SolverContext* context)
+	int GatherColoredContacts(cPhysicsWorld* world, cContact** outContacts, int* colorStart)
 	{
 		auto& contacts = world->p_contacts;
-		int contactCapacity = static_cast<int>(contacts.capacity());
+		auto& actors = world->p_actors;
+		cAllocator* allocator = world->allocator.get();
+
+		int contactCount = static_cast<int>(contacts.size());
+		size_t wordCount = (actors.capacity() + 63) / 64;
+		size_t bitsetSize = sizeof(uint64_t) * wordCount * MAX_SOLVER_COLORS;
+		uint64_t* colorBodies = static_cast<uint64_t*>(allocator->allocate(bitsetSize));
+		std::memset(colorBodies, 0, bitsetSize);
+		cContact** gathered = static_cast<cContact**>(allocator->allocate(sizeof(cContact*) * contactCount));
+		int* gatheredColor = static_cast<int*>(allocator->allocate(sizeof(int) * contactCount));
+
+		int colorCounts[MAX_SOLVER_COLORS + 1] = {};
+		int gatheredCount = 0;
+		for (cContact* contact : contacts)
+		{
+			if (contact->manifold.pointCount == 0 || !world->IsContactAwake(contact))
+				continue;
 
-		ContactConstraint* constraints = static_cast<ContactConstraint*>(world->allocator->allocate(sizeof(ContactConstraint) * contactCapacity));
-		int constraintCount = 0;
+			int indexA = contact->edges[0].bodyIndex;
+			int indexB = contact->edges[1].bodyIndex;
+			bool dynamicA = actors.getUnchecked(indexA)->type == cActorType::DYNAMIC;
+			bool dynamicB = actors.getUnchecked(indexB)->type == cActorType::DYNAMIC;
+			uint64_t maskA = 1ull << (indexA & 63);
+			uint64_t maskB = 1ull << (indexB & 63);
 
-		for (int i = 0; i < contactCapacity; ++i)
+			int color = MAX_SOLVER_COLORS; // overflow
+			for (int c = 0; c < MAX_SOLVER_COLORS; ++c)
+			{
+				uint64_t* bodies = colorBodies + c * wordCount;
+				if ((dynamicA && (bodies[indexA >> 6] & maskA)) || (dynamicB && (bodies[indexB >> 6] & maskB)))
+					continue;
+
+				if (dynamicA)
+					bodies[indexA >> 6] |= maskA;
+				if (dynamicB)
+					bodies[indexB >> 6] |= maskB;
+				color = c;
+				break;
+			}
+
+			gathered[gatheredCount] = contact;
+			gatheredColor[gatheredCount] = color;
+			colorCounts[color] += 1;
+			gatheredCount += 1;
+		}
+
+		colorStart[0] = 0;
+		for (int c = 0; c <= MAX_SOLVER_COLORS; ++c)
 		{
-			if (!contacts.isValid(i))
-				continue;
-			
-			cContact* contact = contacts[i];
-			if (contact->manifold.pointCount == 0)
-				continue;
+			colorStart[c + 1] = colorStart[c] + colorCounts[c];
+		}
 
-			new (constraints + constraintCount) ContactConstraint(); //placement new construct to not cause errors
-			constraints[constraintCount].contact = contact;
-			constraints[constraintCount].contact->manifold.constraintIndex = constraintCount;
-			constraintCount += 1;
+		int colorOffset[MAX_SOLVER_COLORS + 1];
+		std::memcpy(colorOffset, colorStart, sizeof(colorOffset));
+		for (int i = 0; i < gatheredCount; ++i)
+		{
+			outContacts[colorOffset[gatheredColor[i]]++] = gathered[i];
+		}
+
+		allocator->deallocate(gatheredColor, sizeof(int) * contactCount);
+		allocator->deallocate(gathered, sizeof(cContact*) * contactCount);
+		allocator->deallocate(colorBodies, bitsetSize);
+		return gatheredCount;
+	}
+
+	void PGSSoftSolver(cPhysicsWorld* world, SolverContext* context)
+	{
+		C_PROFILE(cStepProfile& profile = world->m_profile);
+		C_PROFILE_BEGIN(timer);
+
+		auto& contacts = world->p_contacts;
+		int contactCount = static_cast<int>(contacts.size());
+
+		// The constraints are always colored, even without a task system,
+		// so the result does not depend on the number of workers
+		cContact** coloredContacts = static_cast<cContact**>(world->allocator->allocate(sizeof(cContact*) * contactCount));
+		int colorStart[MAX_SOLVER_COLORS + 2];
+		int constraintCount = GatherColoredContacts(world, coloredContacts, colorStart);
+
+		ContactConstraint* constraints = static_cast<ContactConstraint*>(world->allocator->allocate(sizeof(ContactConstraint) * contactCount));
+		for (int i = 0; i < constraintCount; ++i)
+		{
+			new (constraints + i) ContactConstraint(); //placement new construct to not cause errors
+			constraints[i].contact = coloredContacts[i];
+			constraints[i].contact->manifold.constraintIndex = i;
 		}
+		world->allocator->deallocate(coloredContacts, sizeof(cContact*) * contactCount);
+
+#if CHIORI_PROFILE
+		for (int c = 0; c < MAX_SOLVER_COLORS && colorStart[c + 1] > colorStart[c]; ++c)
+			profile.solverColors += 1;
+		profile.overflowConstraints += colorStart[MAX_SOLVER_COLORS + 1] - colorStart[MAX_SOLVER_COLORS];
+#endif
+
+		cSolverBodySet set;
+		BuildSolverBodies(world, &set);
 
 		int velocityIterations = context->iterations;
 		int positionIterations = context->extraIterations;
@@ -154,66 +250,174 @@ namespace chiori
 		float contactHertz = c_min(30.0f, 0.333f * inv_h);
 		// Loops: body 3, constraint 2 + vel iter + pos iter
 
-		IntegrateVelocities(world, h);
+		C_PROFILE_END(timer, profile.prepareConstraints);
+		C_PROFILE(timer.reset());
+
+		IntegrateVelocities(world, &set, h);
+
+		C_PROFILE_END(timer, profile.integrateVelocities);
+		C_PROFILE(timer.reset());
+
+		ForEachRange(world->taskSystem, constraints, constraintCount,
+			[&](ContactConstraint* range, int count) { PrepareSoftContacts(world, &set, context, range, count, h, contactHertz); });
 
-		PrepareSoftContacts(world, context, constraints, constraintCount, h, contactHertz);
+		C_PROFILE_END(timer, profile.prepareContacts);
+		C_PROFILE(timer.reset());
 
 		if (context->warmStart)
 		{
-			WarmStartContacts(world, constraints, constraintCount);
+			SolveColors(world->taskSystem, constraints, colorStart,
+				[&](ContactConstraint* range, int count) { WarmStartContacts(&set, range, count); });
 		}
 
+		C_PROFILE_END(timer, profile.warmStart);
+
 		// constraint loop * velocityIterations
 		bool useBias = true;
+		auto solve = [&](ContactConstraint* range, int count) { PGSSoftContactSolver(&set, range, count, inv_h, useBias); };
 		for (int iter = 0; iter < velocityIterations; ++iter)
 		{
-			PGSSoftContactSolver(world, constraints, constraintCount, inv_h, useBias);
+			C_PROFILE(timer.reset());
+			SolveColors(world->taskSystem, constraints, colorStart, solve);
+			C_PROFILE(RecordSolverPass(profile, timer));
 		}
 
+		C_PROFILE(timer.reset());
+
 		// Update positions from velocity
 		// body loop
-		IntegratePositions(world, h);
+		IntegratePositions(&set, h);
+
+		C_PROFILE_END(timer, profile.integratePositions);
 
 		// Relax
 		// constraint loop * positionIterations
 		useBias = false;
 		for (int iter = 0; iter < positionIterations; ++iter)
 		{
-			PGSSoftContactSolver(world, constraints, constraintCount, inv_h, useBias);
+			C_PROFILE(timer.reset());
+			SolveColors(world->taskSystem, constraints, colorStart, solve);
+			C_PROFILE(RecordSolverPass(profile, timer));
 		}
 
-		// Update positions from velocity
+		C_PROFILE(timer.reset());
+
 		// body loop
-		SolvePositions(world);
+		WriteBackSolverBodies(&set);
+
+		C_PROFILE_END(timer, profile.integratePositions);
+		C_PROFILE(timer.reset());
 
 		// constraint loop
-		StoreContactImpluses(constraints, constraintCount);
+		ForEachRange(world->taskSystem, constraints, constraintCount,
+			[](ContactConstraint* range, int count) { StoreContactImpluses(range, count); });
+
+		C_PROFILE_END(timer, profile.storeImpulses);
 
 		// free the constraints
-		world->allocator->deallocate(constraints, sizeof(ContactConstraint) * contactCapacity);
+		world->allocator->deallocate(constraints, sizeof(ContactConstraint) * contactCount);
+		DestroySolverBodies(world, &set);
 	}
 
-	void IntegrateVelocities(cPhysicsWorld* world, float h)
+	static void AddSolverBody(cSolverBodySet* set, cActor* actor)
+	{
+		int index = set->count;
+		cSolverBody* body = set->bodies + index;
+		body->linearVelocity = actor->linearVelocity;
+		body->angularVelocity = actor->angularVelocity;
+		body->invMass = actor->invMass;
+		body->invInertia = actor->invInertia;
+		body->deltaPosition = cVec2::zero;
+		body->rot = actor->rot;
+
+		set->actors[index] = actor;
+		set->actorToBody[actor->header.index] = index;
+		set->count += 1;
+	}
+
+	void BuildSolverBodies(cPhysicsWorld* world, cSolverBodySet* set)
 	{
 		auto& actors = world->p_actors;
-		int actorCapacity = static_cast<int>(actors.capacity());
-		cVec2 gravity = world->gravity;
+		cAllocator* allocator = world->allocator.get();
+		int actorCount = static_cast<int>(actors.size());
+
+		set->actorCapacity = static_cast<int>(actors.capacity());
+		set->bodies = static_cast<cSolverBody*>(allocator->allocate(sizeof(cSolverBody) * (actorCount + 1)));
+		set->actors = static_cast<cActor**>(allocator->allocate(sizeof(cActor*) * actorCount));
+		set->actorToBody = static_cast<int*>(allocator->allocate(sizeof(int) * set->actorCapacity));
+		set->count = 0;
+
+		// awake dynamic actors first, kinematic actors are never put to sleep
+		int kinematicCount = 0;
+		for (cActor* actor : actors)
+		{
+			if (actor->type == cActorType::DYNAMIC && actor->awake)
+				AddSolverBody(set, actor);
+			else if (actor->type == cActorType::KINEMATIC && actor->awake)
+				kinematicCount += 1;
+		}
+		set->dynamicCount = set->count;
 
-		int i = actorCapacity - 1;
-		for (; i >= 0; --i)
+		int staticBody = set->dynamicCount + kinematicCount;
+		for (cActor* actor : actors)
 		{
-			if (!actors.isValid(i))
-				continue;
+			if (actor->type == cActorType::KINEMATIC && actor->awake)
+				AddSolverBody(set, actor);
+			else if (actor->type != cActorType::DYNAMIC || !actor->awake)
+				set->actorToBody[actor->header.index] = staticBody;
+		}
+		cassert(set->count == staticBody);
+
+		cSolverBody* body = set->bodies + staticBody;
+		body->linearVelocity = cVec2::zero;
+		body->angularVelocity = 0.0f;
+		body->invMass = 0.0f;
+		body->invInertia = 0.0f;
+		body->deltaPosition = cVec2::zero;
+		body->rot = cRot::iden;
+	}
 
-			cActor* actor = actors[i];
-			if (!actor->type == cActorType::DYNAMIC)
-				continue;
+	void WriteBackSolverBodies(cSolverBodySet* set)
+	{
+		for (int i = 0; i < set->count; ++i)
+		{
+			const cSolverBody* body = set->bodies + i;
+			cActor* actor = set->actors[i];
 
-			float invMass = actor->invMass;
-			float invI = actor->invInertia;
+			actor->linearVelocity = body->linearVelocity;
+			actor->angularVelocity = body->angularVelocity;
+			actor->position += body->deltaPosition;
+			actor->rot = body->rot;
+		}
+	}
+
+	void DestroySolverBodies(cPhysicsWorld* world, cSolverBodySet* set)
+	{
+		cAllocator* allocator = world->allocator.get();
+		int actorCount = static_cast<int>(world->p_actors.size());
+
+		allocator->deallocate(set->actorToBody, sizeof(int) * set->actorCapacity);
+		allocator->deallocate(set->actors, sizeof(cActor*) * actorCount);
+		allocator->deallocate(set->bodies, sizeof(cSolverBody) * (actorCount + 1));
+		set->bodies = nullptr;
+		set->actors = nullptr;
+		set->actorToBody = nullptr;
+	}
+
+	void IntegrateVelocities(cPhysicsWorld* world, cSolverBodySet* set, float h)
+	{
+		cVec2 gravity = world->gravity;
+
+		for (int i = 0; i < set->count; ++i)
+		{
+			cSolverBody* body = set->bodies + i;
+			cActor* actor = set->actors[i];
 
-			cVec2 v = actor->linearVelocity;
-			float w = actor->angularVelocity;
+			float invMass = body->invMass;
+			float invI = body->invInertia;
+
+			cVec2 v = body->linearVelocity;
+			float w = body->angularVelocity;
 
 			cVec2 f = actor->forces;
 			if (actor->_flags.isSet(cActor::USE_GRAVITY))
@@ -227,54 +431,22 @@ namespace chiori
 			v *= 1.0f / (1.0f + h * actor->linearDamping);
 			w *= 1.0f / (1.0f + h * actor->angularDamping);
 
-			actor->linearVelocity = v;
-			actor->angularVelocity = w;
-		}
-	}
-
-	void IntegratePositions(cPhysicsWorld* world, float h)
-	{
-		auto& actors = world->p_actors;
-		int actorCapacity = static_cast<int>(actors.capacity());
-		cVec2 gravity = world->gravity;
-
-		int i = actorCapacity - 1;
-		for (; i >= 0; --i)
-		{
-			if (!actors.isValid(i))
-				continue;
-
-			cActor* actor = actors[i];
-			if (actor->type == cActorType::STATIC)
-				continue;
-
-			actor->deltaPosition = actor->deltaPosition + h * actor->linearVelocity;
-			actor->rot = actor->rot.intergrated(h * actor->angularVelocity);
+			body->linearVelocity = v;
+			body->angularVelocity = w;
 		}
 	}
 
-	void SolvePositions(cPhysicsWorld* world)
+	void IntegratePositions(cSolverBodySet* set, float h)
 	{
-		auto& actors = world->p_actors;
-		int actorCapacity = static_cast<int>(actors.capacity());
-		cVec2 gravity = world->gravity;
-
-		int i = actorCapacity - 1;
-		for (; i >= 0; --i)
+		for (int i = 0; i < set->count; ++i)
 		{
-			if (!actors.isValid(i))
-				continue;
-
-			cActor* actor = actors[i];
-			if (actor->type == cActorType::STATIC)
-				continue;
-
-			actor->position += actor->deltaPosition;
-			actor->deltaPosition = cVec2::zero;
+			cSolverBody* body = set->bodies + i;
+			body->deltaPosition = body->deltaPosition + h * body->linearVelocity;
+			body->rot = body->rot.intergrated(h * body->angularVelocity);
 		}
 	}
 	
-	void PrepareSoftContacts(cPhysicsWorld* world, SolverContext* context, ContactConstraint* constraints, int constraintCount, float h, float hertz)
+	void PrepareSoftContacts(cPhysicsWorld* world, const cSolverBodySet* set, SolverContext* context, ContactConstraint* constraints, int constraintCount, float h, float hertz)
 	{
 		auto& actors = world->p_actors;
 		bool warmStart = context->warmStart;
@@ -287,26 +459,29 @@ namespace chiori
 			const cManifold& manifold = contact->manifold;
 			int pointCount = manifold.pointCount;
 			cassert(0 < pointCount && pointCount <= 2);
-			int indexA = contact->edges[0].bodyIndex;
-			int indexB = contact->edges[1].bodyIndex;
+			int actorIndexA = contact->edges[0].bodyIndex;
+			int actorIndexB = contact->edges[1].bodyIndex;
 
-			constraint->indexA = indexA;
-			constraint->indexB = indexB;
+			constraint->indexA = set->actorToBody[actorIndexA];
+			constraint->indexB = set->actorToBody[actorIndexB];
 			constraint->normal = manifold.normal;
 			constraint->friction = contact->friction;
 			constraint->pointCount = pointCount;
 
-			cActor* actorA = actors[indexA];
-			cActor* actorB = actors[indexB];
+			// the actors are only needed for the local centers
+			const cActor* actorA = actors.getUnchecked(actorIndexA);
+			const cActor* actorB = actors.getUnchecked(actorIndexB);
+			const cSolverBody* bodyA = set->bodies + constraint->indexA;
+			const cSolverBody* bodyB = set->bodies + constraint->indexB;
 
-			float mA = actorA->invMass; float iA = actorA->invInertia;
-			float mB = actorB->invMass; float iB = actorB->invInertia;
+			float mA = bodyA->invMass; float iA = bodyA->invInertia;
+			float mB = bodyB->invMass; float iB = bodyB->invInertia;
 
 			// Stiffer for dynamic vs static
 			float contactHertz = (mA == 0.0f || mB == 0.0f) ? 2.0f * hertz : hertz;
 
-			cRot qA = actorA->rot;
-			cRot qB = actorB->rot;
+			cRot qA = bodyA->rot;
+			cRot qB = bodyB->rot;
 
 			cVec2 normal = constraint->normal;
 			cVec2 tangent = { normal.y, -normal.x };
@@ -360,9 +535,10 @@ namespace chiori
 		}
 	}
 	
-	void WarmStartContacts(cPhysicsWorld* world, ContactConstraint* constraints, int constraintCount)
+	void WarmStartContacts(cSolverBodySet* set, ContactConstraint* constraints, int constraintCount)
 	{
-		auto& actors = world->p_actors;
+		cSolverBody* bodies = set->bodies;
+		int dynamicCount = set->dynamicCount;
 
 		for (int i = 0; i < constraintCount; ++i)
 		{
@@ -371,21 +547,21 @@ namespace chiori
 			int pointCount = constraint->pointCount;
 			cassert(0 < pointCount && pointCount <= 2);
 
-			cActor* actorA = actors[constraint->indexA];
-			cActor* actorB = actors[constraint->indexB];
+			cSolverBody* bodyA = bodies + constraint->indexA;
+			cSolverBody* bodyB = bodies + constraint->indexB;
 
-			float mA = actorA->invMass;
-			float iA = actorA->invInertia;
-			float mB = actorB->invMass;
-			float iB = actorB->invInertia;
+			float mA = bodyA->invMass;
+			float iA = bodyA->invInertia;
+			float mB = bodyB->invMass;
+			float iB = bodyB->invInertia;
 
-			cVec2 vA = actorA->linearVelocity;
-			float wA = actorA->angularVelocity;
-			cVec2 vB = actorB->linearVelocity;
-			float wB = actorB->angularVelocity;
+			cVec2 vA = bodyA->linearVelocity;
+			float wA = bodyA->angularVelocity;
+			cVec2 vB = bodyB->linearVelocity;
+			float wB = bodyB->angularVelocity;
 
-			cRot qA = actorA->rot;
-			cRot qB = actorB->rot;
+			cRot qA = bodyA->rot;
+			cRot qB = bodyB->rot;
 
 			cVec2 normal = constraint->normal;
 			cVec2 tangent = { normal.y, -normal.x };
@@ -404,10 +580,16 @@ namespace chiori
 				vB = vB + (mB * P);
 			}
 
-			actorA->linearVelocity = vA;
-			actorA->angularVelocity = wA;
-			actorB->linearVelocity = vB;
-			actorB->angularVelocity = wB;
+			if (constraint->indexA < dynamicCount)
+			{
+				bodyA->linearVelocity = vA;
+				bodyA->angularVelocity = wA;
+			}
+			if (constraint->indexB < dynamicCount)
+			{
+				bodyB->linearVelocity = vB;
+				bodyB->angularVelocity = wB;
+			}
 		}
 	}
 
@@ -429,16 +611,17 @@ namespace chiori
 	}
 
 
-	static void PGSBaumgarteContactSolver(cPhysicsWorld* world, ContactConstraint* constraints, int constraintCount, float inv_h)
+	static void PGSBaumgarteContactSolver(cSolverBodySet* set, ContactConstraint* constraints, int constraintCount, float inv_h)
 	{
-		auto& actors = world->p_actors;
+		cSolverBody* bodies = set->bodies;
+		int dynamicCount = set->dynamicCount;
 
 		for (int i = 0; i < constraintCount; ++i)
 		{
 			ContactConstraint* constraint = constraints + i;
 			
-			cActor* bodyA = actors[constraint->indexA];
-			cActor* bodyB = actors[constraint->indexB];
+			cSolverBody* bodyA = bodies + constraint->indexA;
+			cSolverBody* bodyB = bodies + constraint->indexB;
 
 			float mA = bodyA->invMass;
 			float iA = bodyA->invInertia;
@@ -529,14 +712,20 @@ namespace chiori
 				wB += iB * cross(rB, P);
 			}
 
-			bodyA->linearVelocity = vA;
-			bodyA->angularVelocity = wA;
-			bodyB->linearVelocity = vB;
-			bodyB->angularVelocity = wB;
+			if (constraint->indexA < dynamicCount)
+			{
+				bodyA->linearVelocity = vA;
+				bodyA->angularVelocity = wA;
+			}
+			if (constraint->indexB < dynamicCount)
+			{
+				bodyB->linearVelocity = vB;
+				bodyB->angularVelocity = wB;
+			}
 		}
 	}
 
-	static void PrepareContacts(cPhysicsWorld* world, ContactConstraint* constraints, int constraintCount, bool warmStart)
+	static void PrepareContacts(cPhysicsWorld* world, const cSolverBodySet* set, ContactConstraint* constraints, int constraintCount, bool warmStart)
 	{
 		auto& actors = world->p_actors;
 
@@ -548,17 +737,20 @@ namespace chiori
 			const cManifold* manifold = &contact->manifold;
 			int pointCount = manifold->pointCount;
 			cassert(0 < pointCount && pointCount <= 2);
-			int indexA = contact->edges[0].bodyIndex;
-			int indexB = contact->edges[1].bodyIndex;
+			int actorIndexA = contact->edges[0].bodyIndex;
+			int actorIndexB = contact->edges[1].bodyIndex;
 
-			constraint->indexA = indexA;
-			constraint->indexB = indexB;
+			constraint->indexA = set->actorToBody[actorIndexA];
+			constraint->indexB = set->actorToBody[actorIndexB];
 			constraint->normal = manifold->normal;
 			constraint->friction = contact->friction;
 			constraint->pointCount = pointCount;
 
-			cActor* bodyA = actors[constraint->indexA];
-			cActor* bodyB = actors[constraint->indexB];
+			// the actors are only needed for the local centers
+			const cActor* actorA = actors.getUnchecked(actorIndexA);
+			const cActor* actorB = actors.getUnchecked(actorIndexB);
+			const cSolverBody* bodyA = set->bodies + constraint->indexA;
+			const cSolverBody* bodyB = set->bodies + constraint->indexB;
 
 			float mA = bodyA->invMass;
 			float iA = bodyA->invInertia;
@@ -587,8 +779,8 @@ namespace chiori
 					cp->tangentImpulse = 0.0f;
 				}
 
-				cp->localAnchorA = (mp->localAnchorA - bodyA->localCenter);
-				cp->localAnchorB = (mp->localAnchorB - bodyB->localCenter);
+				cp->localAnchorA = (mp->localAnchorA - actorA->localCenter);
+				cp->localAnchorB = (mp->localAnchorB - actorB->localCenter);
 
 				cVec2 rA = (cp->localAnchorA.rotated(qA));
 				cVec2 rB = (qB, cp->localAnchorB.rotated(qB));
@@ -617,20 +809,18 @@ namespace chiori
 	// not particularly stable, but effective for most cases.
 	void PGSSolver(cPhysicsWorld* world, SolverContext* context)
 	{
+		C_PROFILE(cStepProfile& profile = world->m_profile);
+		C_PROFILE_BEGIN(timer);
+
 		auto& contacts = world->p_contacts;
-		int contactCapacity = static_cast<int>(contacts.capacity());
+		int contactCount = static_cast<int>(contacts.size());
 		
-		ContactConstraint* constraints = static_cast<ContactConstraint*>(world->allocator->allocate(sizeof(ContactConstraint) * contactCapacity));
+		ContactConstraint* constraints = static_cast<ContactConstraint*>(world->allocator->allocate(sizeof(ContactConstraint) * contactCount));
 		int constraintCount = 0;
 
-		for (int i = 0; i < contactCapacity; ++i)
+		for (cContact* contact : contacts)
 		{
-			if (!world->p_contacts.isValid(i))
-				continue;
-			
-			cContact* contact = contacts[i];
-
-			if (contact->manifold.pointCount == 0)
+			if (contact->manifold.pointCount == 0 || !world->IsContactAwake(contact))
 			{
 				continue;
 			}
@@ -640,37 +830,61 @@ namespace chiori
 			constraintCount += 1;
 		}
 
+		cSolverBodySet set;
+		BuildSolverBodies(world, &set);
+
 		int iterations = context->iterations;
 		float h = context->dt;
 		float inv_h = context->inv_dt;
 
 		// Loops: body 2, constraint 2 + iterations
 
+		C_PROFILE_END(timer, profile.prepareConstraints);
+		C_PROFILE(timer.reset());
+
 		// body loop
-		IntegrateVelocities(world, h);
+		IntegrateVelocities(world, &set, h);
+
+		C_PROFILE_END(timer, profile.integrateVelocities);
+		C_PROFILE(timer.reset());
 
 		// constraint loop
-		PrepareContacts(world, constraints, constraintCount, context->warmStart);
+		PrepareContacts(world, &set, constraints, constraintCount, context->warmStart);
+
+		C_PROFILE_END(timer, profile.prepareContacts);
+		C_PROFILE(timer.reset());
 
 		if (context->warmStart)
 		{
-			WarmStartContacts(world, constraints, constraintCount);
+			WarmStartContacts(&set, constraints, constraintCount);
 		}
+
+		C_PROFILE_END(timer, profile.warmStart);
 		
 		for (int iter = 0; iter < iterations; ++iter)
 		{
-			PGSBaumgarteContactSolver(world, constraints, constraintCount, inv_h);
+			C_PROFILE(timer.reset());
+			PGSBaumgarteContactSolver(&set, constraints, constraintCount, inv_h);
+			C_PROFILE(RecordSolverPass(profile, timer));
 		}
 
+		C_PROFILE(timer.reset());
+
 		// body loop
 		// Update positions from velocity
-		IntegratePositions(world, h);
-		SolvePositions(world);
+		IntegratePositions(&set, h);
+		WriteBackSolverBodies(&set);
+
+		C_PROFILE_END(timer, profile.integratePositions);
+		C_PROFILE(timer.reset());
 
 		// constraint loop
 		StoreContactImpluses(constraints, constraintCount);
+
+		C_PROFILE_END(timer, profile.storeImpulses);
 		
 		// free the constraints
-		world->allocator->deallocate(constraints, sizeof(ContactConstraint) * contactCapacity);
+		world->allocator->deallocate(constraints, sizeof(ContactConstraint) * contactCount);
+		DestroySolverBodies(world, &set);
 	}
 }
\ No newline at end of file
@@ -1,11 +1,17 @@
 #pragma once
 #include "chioriMath.h"
+#include "chioriTasks.h"
+#include "chioriProfiler.h"
 
 namespace chiori
 {
+	#define MAX_SOLVER_COLORS 16 // constraint graph colors of the soft solver, constraints that do not fit are solved serially
+	#define CONSTRAINTS_PER_TASK 32 // the minimum number of constraints solved by one solver task
+
 	// forward declaration
 	class cPhysicsWorld;
 	struct cContact;
+	class cActor;
 
 	struct SolverContext
 	{
@@ -37,7 +43,7 @@ namespace chiori
 	struct ContactConstraint
 	{
 		cContact* contact;
-		int indexA;
+		int indexA; // solver body indices
 		int indexB;
 		ContactConstraintPoint points[2];
 		cVec2 normal;
@@ -45,14 +51,90 @@ namespace chiori
 		int pointCount;
 	};
 
+	// The part of an actor the solver works on. The solve gathers the awake actors into a dense array of
+	// solver bodies once, every solver stage indexes that array, and the actors are written back at the end
+	struct cSolverBody
+	{
+		cVec2 linearVelocity;
+		float angularVelocity;
+		float invMass;
+		float invInertia;
+		cVec2 deltaPosition; // delta position for the whole time step
+		cRot rot;
+	};
+
+	// The solver bodies of a step. The awake dynamic actors come first and are the only bodies the contact solvers write,
+	// then the kinematic actors. All static (and sleeping) actors share the static body at index count, which never moves
+	struct cSolverBodySet
+	{
+		cSolverBody* bodies;	// count + 1 bodies
+		cActor** actors;		// the actor of every body but the static body
+		int* actorToBody;		// the solver body index of every actor, by actor pool index
+		int actorCapacity;
+		int dynamicCount;
+		int count;
+	};
+
 	void PGSSoftSolver(cPhysicsWorld* world, SolverContext* context);
 	void PGSSolver(cPhysicsWorld* world, SolverContext* context);
+	// PGSSoftSolver on SIMD_WIDTH constraints of a color at once, see chioriSIMD.h. Same math, the results
+	// only differ from PGSSoftSolver by the order the constraints are solved in
+	void PGSSoftSolverWide(cPhysicsWorld* world, SolverContext* context);
+
+#if CHIORI_PROFILE
+	// records the time of a single contact solver pass, passes past MAX_PROFILED_SOLVER_PASSES are dropped
+	void RecordSolverPass(cStepProfile& profile, const cTimer& timer);
+#endif
 
-	void IntegrateVelocities(cPhysicsWorld* world, float h);
-	void IntegratePositions(cPhysicsWorld* world, float h);
-	void SolvePositions(cPhysicsWorld* world);
+	void BuildSolverBodies(cPhysicsWorld* world, cSolverBodySet* set);
+	// copies the velocities and rotations back to the actors and moves them by their delta position
+	void WriteBackSolverBodies(cSolverBodySet* set);
+	void DestroySolverBodies(cPhysicsWorld* world, cSolverBodySet* set);
+
+	void IntegrateVelocities(cPhysicsWorld* world, cSolverBodySet* set, float h);
+	void IntegratePositions(cSolverBodySet* set, float h);
+
+	// Gathers the awake touching contacts sorted by color. Greedy graph coloring makes sure no two contacts of
+	// a color share a dynamic actor, so the constraints of one color can be solved in parallel. Contacts that do
+	// not fit any of the MAX_SOLVER_COLORS colors go to the overflow bucket, which has to be solved serially.
+	// Color c is [colorStart[c], colorStart[c + 1]), the overflow bucket is the last range at colorStart[MAX_SOLVER_COLORS].
+	// outContacts must hold p_contacts.size() contacts, colorStart MAX_SOLVER_COLORS + 2 ints. Returns the number of contacts
+	int GatherColoredContacts(cPhysicsWorld* world, cContact** outContacts, int* colorStart);
+
+	// runs solve(items, count) over the items of every color, in parallel when there is a task system,
+	// then over the overflow bucket on the calling thread
+	template <typename T, typename SolveFunction>
+	void SolveColors(cTaskSystem* taskSystem, T* items, const int* colorStart, SolveFunction&& solve)
+	{
+		for (int c = 0; c < MAX_SOLVER_COLORS; ++c)
+		{
+			int count = colorStart[c + 1] - colorStart[c];
+			if (count == 0)
+				break; // greedy coloring fills the colors in order
+
+			T* colorItems = items + colorStart[c];
+			if (taskSystem)
+				taskSystem->parallelFor(count, CONSTRAINTS_PER_TASK, [&](int begin, int end, int) { solve(colorItems + begin, end - begin); });
+			else
+				solve(colorItems, count);
+		}
+
+		int overflowCount = colorStart[MAX_SOLVER_COLORS + 1] - colorStart[MAX_SOLVER_COLORS];
+		if (overflowCount > 0)
+			solve(items + colorStart[MAX_SOLVER_COLORS], overflowCount);
+	}
+
+	// runs task(items, count) over all items, in parallel when there is a task system. The items must be independent of each other
+	template <typename T, typename TaskFunction>
+	void ForEachRange(cTaskSystem* taskSystem, T* items, int count, TaskFunction&& task)
+	{
+		if (taskSystem)
+			taskSystem->parallelFor(count, CONSTRAINTS_PER_TASK, [&](int begin, int end, int) { task(items + begin, end - begin); });
+		else
+			task(items, count);
+	}
 
-	void PrepareSoftContacts(cPhysicsWorld* world, SolverContext* context, ContactConstraint* constraints, int constraintCount, float h, float hertz);
-	void WarmStartContacts(cPhysicsWorld* world, ContactConstraint* constraints, int constraintCount);
+	void PrepareSoftContacts(cPhysicsWorld* world, const cSolverBodySet* set, SolverContext* context, ContactConstraint* constraints, int constraintCount, float h, float hertz);
+	void WarmStartContacts(cSolverBodySet* set, ContactConstraint* constraints, int constraintCount);
 	void StoreContactImpluses(ContactConstraint* constraints, int constraintCount);
 }
\ No newline at end of file
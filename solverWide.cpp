@@ -0,0 +1,484 @@
+#include "pch.h"
+#include "solver.h"
+#include "contact.h"
+#include "physicsWorld.h"
+#include "chioriPool.h"
+#include "cActor.h"
+#include "chioriSIMD.h"
+
+namespace chiori
+{
+	#define MaxBaumgarteVelocity 4.0f
+
+	// One point of SIMD_WIDTH contact constraints, one lane per constraint.
+	// Lanes of constraints with a single point, and empty lanes, are all zeros which makes them a no-op in the solver
+	struct alignas(SIMD_ALIGNMENT) ContactConstraintPointWide
+	{
+		float rAX[SIMD_WIDTH], rAY[SIMD_WIDTH];	// static anchors
+		float rBX[SIMD_WIDTH], rBY[SIMD_WIDTH];
+		float separation[SIMD_WIDTH];
+		float normalMass[SIMD_WIDTH];
+		float tangentMass[SIMD_WIDTH];
+		float massCoefficient[SIMD_WIDTH];
+		float biasCoefficient[SIMD_WIDTH];
+		float impulseCoefficient[SIMD_WIDTH];
+		float normalImpulse[SIMD_WIDTH];
+		float tangentImpulse[SIMD_WIDTH];
+	};
+
+	// SIMD_WIDTH contact constraints of the same color in SoA layout, no two lanes share a dynamic actor
+	struct alignas(SIMD_ALIGNMENT) ContactConstraintWide
+	{
+		ContactConstraintPointWide points[2];
+		float normalX[SIMD_WIDTH], normalY[SIMD_WIDTH];
+		float friction[SIMD_WIDTH];
+		float invMassA[SIMD_WIDTH], invIA[SIMD_WIDTH];
+		float invMassB[SIMD_WIDTH], invIB[SIMD_WIDTH];
+		int indexA[SIMD_WIDTH];			// solver body index, empty lanes use the static body
+		int indexB[SIMD_WIDTH];
+		cContact* contacts[SIMD_WIDTH];	// nullptr for empty lanes
+	};
+
+	// body velocities of one bundle side, loaded as vectors
+	struct BodyVelocitiesWide
+	{
+		cFloatW vX, vY, w;
+	};
+
+	// the allocator only guarantees new alignment, AVX needs 32 bytes
+	static void* AllocateAligned(cAllocator* allocator, size_t size)
+	{
+		void* raw = allocator->allocate(size + SIMD_ALIGNMENT + sizeof(void*));
+		uintptr_t aligned = (reinterpret_cast<uintptr_t>(raw) + sizeof(void*) + SIMD_ALIGNMENT - 1) & ~static_cast<uintptr_t>(SIMD_ALIGNMENT - 1);
+		reinterpret_cast<void**>(aligned)[-1] = raw;
+		return reinterpret_cast<void*>(aligned);
+	}
+
+	static void DeallocateAligned(cAllocator* allocator, void* ptr, size_t size)
+	{
+		allocator->deallocate(reinterpret_cast<void**>(ptr)[-1], size + SIMD_ALIGNMENT + sizeof(void*));
+	}
+
+	static BodyVelocitiesWide GatherVelocities(const cSolverBody* bodies, const int* indices)
+	{
+		alignas(SIMD_ALIGNMENT) float vX[SIMD_WIDTH], vY[SIMD_WIDTH], w[SIMD_WIDTH];
+		for (int i = 0; i < SIMD_WIDTH; ++i)
+		{
+			const cSolverBody& body = bodies[indices[i]];
+			vX[i] = body.linearVelocity.x;
+			vY[i] = body.linearVelocity.y;
+			w[i] = body.angularVelocity;
+		}
+		return { wLoad(vX), wLoad(vY), wLoad(w) };
+	}
+
+	static void ScatterVelocities(cSolverBody* bodies, int dynamicCount, const int* indices, const BodyVelocitiesWide& v)
+	{
+		alignas(SIMD_ALIGNMENT) float vX[SIMD_WIDTH], vY[SIMD_WIDTH], w[SIMD_WIDTH];
+		wStore(vX, v.vX);
+		wStore(vY, v.vY);
+		wStore(w, v.w);
+		for (int i = 0; i < SIMD_WIDTH; ++i)
+		{
+			int index = indices[i];
+			if (index >= dynamicCount)
+				continue; // static, kinematic or an empty lane
+			bodies[index].linearVelocity = { vX[i], vY[i] };
+			bodies[index].angularVelocity = w[i];
+		}
+	}
+
+	// The lane math is the same as PrepareSoftContacts, done once per constraint
+	static void PrepareSoftContactsWide(cPhysicsWorld* world, const cSolverBodySet* set, SolverContext* context, ContactConstraintWide* constraints, int constraintCount,
+		float h, float hertz)
+	{
+		auto& actors = world->p_actors;
+		bool warmStart = context->warmStart;
+
+		for (int i = 0; i < constraintCount; ++i)
+		{
+			ContactConstraintWide* constraint = constraints + i;
+
+			for (int lane = 0; lane < SIMD_WIDTH; ++lane)
+			{
+				cContact* contact = constraint->contacts[lane];
+				if (contact == nullptr)
+					continue; // empty lanes were zeroed when the bundles were built
+
+				const cManifold& manifold = contact->manifold;
+				int pointCount = manifold.pointCount;
+				cassert(0 < pointCount && pointCount <= 2);
+
+				int actorIndexA = contact->edges[0].bodyIndex;
+				int actorIndexB = contact->edges[1].bodyIndex;
+				int indexA = set->actorToBody[actorIndexA];
+				int indexB = set->actorToBody[actorIndexB];
+
+				// the actors are only needed for the local centers
+				const cActor* actorA = actors.getUnchecked(actorIndexA);
+				const cActor* actorB = actors.getUnchecked(actorIndexB);
+				const cSolverBody* bodyA = set->bodies + indexA;
+				const cSolverBody* bodyB = set->bodies + indexB;
+
+				float mA = bodyA->invMass; float iA = bodyA->invInertia;
+				float mB = bodyB->invMass; float iB = bodyB->invInertia;
+
+				constraint->indexA[lane] = indexA;
+				constraint->indexB[lane] = indexB;
+				constraint->normalX[lane] = manifold.normal.x;
+				constraint->normalY[lane] = manifold.normal.y;
+				constraint->friction[lane] = contact->friction;
+				constraint->invMassA[lane] = mA;
+				constraint->invIA[lane] = iA;
+				constraint->invMassB[lane] = mB;
+				constraint->invIB[lane] = iB;
+
+				// Stiffer for dynamic vs static
+				float contactHertz = (mA == 0.0f || mB == 0.0f) ? 2.0f * hertz : hertz;
+
+				cRot qA = bodyA->rot;
+				cRot qB = bodyB->rot;
+
+				cVec2 normal = manifold.normal;
+				cVec2 tangent = { normal.y, -normal.x };
+
+				for (int j = 0; j < pointCount; ++j)
+				{
+					const cManifoldPoint* mp = manifold.points + j;
+					ContactConstraintPointWide* cp = constraint->points + j;
+
+					cp->normalImpulse[lane] = warmStart ? mp->normalImpulse : 0.0f;
+					cp->tangentImpulse[lane] = warmStart ? mp->tangentImpulse : 0.0f;
+
+					cVec2 rA = (mp->localAnchorA - actorA->localCenter).rotated(qA);
+					cVec2 rB = (mp->localAnchorB - actorB->localCenter).rotated(qB);
+					cp->rAX[lane] = rA.x; cp->rAY[lane] = rA.y;
+					cp->rBX[lane] = rB.x; cp->rBY[lane] = rB.y;
+
+					cp->separation[lane] = mp->separation;
+
+					float rnA = rA.cross(normal);
+					float rnB = rB.cross(normal);
+					float kNormal = mA + mB + iA * rnA * rnA + iB * rnB * rnB;
+					cp->normalMass[lane] = kNormal > 0.0f ? 1.0f / kNormal : 0.0f;
+
+					float rtA = rA.cross(tangent);
+					float rtB = rB.cross(tangent);
+					float kTangent = mA + mB + iA * rtA * rtA + iB * rtB * rtB;
+					cp->tangentMass[lane] = kTangent > 0.0f ? 1.0f / kTangent : 0.0f;
+
+					// soft contact
+					const float zeta = 10.0f;
+					float omega = 2.0f * PI * contactHertz;
+					float c = h * omega * (2.0f * zeta + h * omega);
+					cp->biasCoefficient[lane] = omega / (2.0f * zeta + h * omega);
+					cp->impulseCoefficient[lane] = 1.0f / (1.0f + c);
+					cp->massCoefficient[lane] = c * cp->impulseCoefficient[lane];
+				}
+			}
+		}
+	}
+
+	static void WarmStartContactsWide(cSolverBodySet* set, ContactConstraintWide* constraints, int constraintCount)
+	{
+		for (int i = 0; i < constraintCount; ++i)
+		{
+			ContactConstraintWide* constraint = constraints + i;
+
+			BodyVelocitiesWide a = GatherVelocities(set->bodies, constraint->indexA);
+			BodyVelocitiesWide b = GatherVelocities(set->bodies, constraint->indexB);
+
+			cFloatW mA = wLoad(constraint->invMassA), iA = wLoad(constraint->invIA);
+			cFloatW mB = wLoad(constraint->invMassB), iB = wLoad(constraint->invIB);
+			cFloatW nX = wLoad(constraint->normalX), nY = wLoad(constraint->normalY);
+			cFloatW tX = nY, tY = wZero() - nX;
+
+			for (int j = 0; j < 2; ++j)
+			{
+				const ContactConstraintPointWide* cp = constraint->points + j;
+				cFloatW rAX = wLoad(cp->rAX), rAY = wLoad(cp->rAY);
+				cFloatW rBX = wLoad(cp->rBX), rBY = wLoad(cp->rBY);
+				cFloatW normalImpulse = wLoad(cp->normalImpulse);
+				cFloatW tangentImpulse = wLoad(cp->tangentImpulse);
+
+				cFloatW PX = normalImpulse * nX + tangentImpulse * tX;
+				cFloatW PY = normalImpulse * nY + tangentImpulse * tY;
+
+				a.w = a.w - iA * (rAX * PY - rAY * PX);
+				a.vX = a.vX - mA * PX;
+				a.vY = a.vY - mA * PY;
+				b.w = b.w + iB * (rBX * PY - rBY * PX);
+				b.vX = b.vX + mB * PX;
+				b.vY = b.vY + mB * PY;
+			}
+
+			ScatterVelocities(set->bodies, set->dynamicCount, constraint->indexA, a);
+			ScatterVelocities(set->bodies, set->dynamicCount, constraint->indexB, b);
+		}
+	}
+
+	// The same math as PGSSoftContactSolver, for SIMD_WIDTH constraints at once
+	static void PGSSoftContactSolverWide(cSolverBodySet* set, ContactConstraintWide* constraints, int constraintCount, float inv_h, bool useBias)
+	{
+		const cFloatW zero = wZero();
+		const cFloatW one = wSplat(1.0f);
+		const cFloatW invH = wSplat(inv_h);
+		const cFloatW maxBiasVelocity = wSplat(-MaxBaumgarteVelocity);
+
+		for (int i = 0; i < constraintCount; ++i)
+		{
+			ContactConstraintWide* constraint = constraints + i;
+
+			BodyVelocitiesWide a = GatherVelocities(set->bodies, constraint->indexA);
+			BodyVelocitiesWide b = GatherVelocities(set->bodies, constraint->indexB);
+
+			cFloatW mA = wLoad(constraint->invMassA), iA = wLoad(constraint->invIA);
+			cFloatW mB = wLoad(constraint->invMassB), iB = wLoad(constraint->invIB);
+			cFloatW nX = wLoad(constraint->normalX), nY = wLoad(constraint->normalY);
+			cFloatW tX = nY, tY = zero - nX;
+			cFloatW friction = wLoad(constraint->friction);
+
+			// calculate normal impulse
+			for (int j = 0; j < 2; ++j)
+			{
+				ContactConstraintPointWide* cp = constraint->points + j;
+
+				cFloatW separation = wLoad(cp->separation);
+				cFloatW speculative = wGreater(separation, zero);
+
+				// speculative: bias = separation * inv_h, massScale = 1, impulseScale = 0
+				cFloatW bias = separation * invH;
+				cFloatW massScale = one;
+				cFloatW impulseScale = zero;
+				if (useBias)
+				{
+					bias = wSelect(speculative, bias, wMax(wLoad(cp->biasCoefficient) * separation, maxBiasVelocity));
+					massScale = wSelect(speculative, one, wLoad(cp->massCoefficient));
+					impulseScale = wSelect(speculative, zero, wLoad(cp->impulseCoefficient));
+				}
+				else
+				{
+					bias = wSelect(speculative, bias, zero);
+				}
+
+				// static anchors
+				cFloatW rAX = wLoad(cp->rAX), rAY = wLoad(cp->rAY);
+				cFloatW rBX = wLoad(cp->rBX), rBY = wLoad(cp->rBY);
+
+				// Relative velocity at contact
+				cFloatW dvX = (b.vX - b.w * rBY) - (a.vX - a.w * rAY);
+				cFloatW dvY = (b.vY + b.w * rBX) - (a.vY + a.w * rAX);
+				cFloatW vn = dvX * nX + dvY * nY;
+
+				// Compute normal impulse
+				cFloatW normalImpulse = wLoad(cp->normalImpulse);
+				cFloatW impulse = zero - wLoad(cp->normalMass) * massScale * (vn + bias) - impulseScale * normalImpulse;
+
+				// Clamp the accumulated impulse
+				cFloatW newImpulse = wMax(normalImpulse + impulse, zero);
+				impulse = newImpulse - normalImpulse;
+				wStore(cp->normalImpulse, newImpulse);
+
+				// Apply contact impulse
+				cFloatW PX = impulse * nX, PY = impulse * nY;
+				a.vX = a.vX - mA * PX;
+				a.vY = a.vY - mA * PY;
+				a.w = a.w - iA * (rAX * PY - rAY * PX);
+
+				b.vX = b.vX + mB * PX;
+				b.vY = b.vY + mB * PY;
+				b.w = b.w + iB * (rBX * PY - rBY * PX);
+			}
+
+			// calculate friction/tangent impulses
+			for (int j = 0; j < 2; ++j)
+			{
+				ContactConstraintPointWide* cp = constraint->points + j;
+
+				// static anchors
+				cFloatW rAX = wLoad(cp->rAX), rAY = wLoad(cp->rAY);
+				cFloatW rBX = wLoad(cp->rBX), rBY = wLoad(cp->rBY);
+
+				// Relative velocity at contact
+				cFloatW dvX = (b.vX - b.w * rBY) - (a.vX - a.w * rAY);
+				cFloatW dvY = (b.vY + b.w * rBX) - (a.vY + a.w * rAX);
+
+				// Compute tangent force
+				cFloatW vt = dvX * tX + dvY * tY;
+				cFloatW lambda = wLoad(cp->tangentMass) * (zero - vt);
+
+				// Clamp the accumulated force
+				cFloatW tangentImpulse = wLoad(cp->tangentImpulse);
+				cFloatW maxFriction = friction * wLoad(cp->normalImpulse);
+				cFloatW newImpulse = wMin(wMax(tangentImpulse + lambda, zero - maxFriction), maxFriction);
+				lambda = newImpulse - tangentImpulse;
+				wStore(cp->tangentImpulse, newImpulse);
+
+				// Apply contact impulse
+				cFloatW PX = lambda * tX, PY = lambda * tY;
+				a.vX = a.vX - mA * PX;
+				a.vY = a.vY - mA * PY;
+				a.w = a.w - iA * (rAX * PY - rAY * PX);
+
+				b.vX = b.vX + mB * PX;
+				b.vY = b.vY + mB * PY;
+				b.w = b.w + iB * (rBX * PY - rBY * PX);
+			}
+
+			ScatterVelocities(set->bodies, set->dynamicCount, constraint->indexA, a);
+			ScatterVelocities(set->bodies, set->dynamicCount, constraint->indexB, b);
+		}
+	}
+
+	static void StoreContactImpulsesWide(ContactConstraintWide* constraints, int constraintCount)
+	{
+		for (int i = 0; i < constraintCount; ++i)
+		{
+			ContactConstraintWide* constraint = constraints + i;
+			for (int lane = 0; lane < SIMD_WIDTH; ++lane)
+			{
+				cContact* contact = constraint->contacts[lane];
+				if (contact == nullptr)
+					continue;
+
+				cManifold* manifold = &contact->manifold;
+				for (int j = 0; j < manifold->pointCount; ++j)
+				{
+					manifold->points[j].normalImpulse = constraint->points[j].normalImpulse[lane];
+					manifold->points[j].tangentImpulse = constraint->points[j].tangentImpulse[lane];
+				}
+			}
+		}
+	}
+
+	void PGSSoftSolverWide(cPhysicsWorld* world, SolverContext* context)
+	{
+		C_PROFILE(cStepProfile& profile = world->m_profile);
+		C_PROFILE_BEGIN(timer);
+
+		cAllocator* allocator = world->allocator.get();
+		cTaskSystem* taskSystem = world->taskSystem;
+		int contactCount = static_cast<int>(world->p_contacts.size());
+
+		cSolverBodySet set;
+		BuildSolverBodies(world, &set);
+
+		cContact** coloredContacts = static_cast<cContact**>(allocator->allocate(sizeof(cContact*) * contactCount));
+		int colorStart[MAX_SOLVER_COLORS + 2];
+		GatherColoredContacts(world, coloredContacts, colorStart);
+
+		// Pack every color into bundles of SIMD_WIDTH constraints. The overflow constraints
+		// get a bundle each, as they may share actors and have to be solved one after another
+		int bundleStart[MAX_SOLVER_COLORS + 2];
+		bundleStart[0] = 0;
+		for (int c = 0; c <= MAX_SOLVER_COLORS; ++c)
+		{
+			int count = colorStart[c + 1] - colorStart[c];
+			int bundles = (c == MAX_SOLVER_COLORS) ? count : (count + SIMD_WIDTH - 1) / SIMD_WIDTH;
+			bundleStart[c + 1] = bundleStart[c] + bundles;
+		}
+
+		int bundleCount = bundleStart[MAX_SOLVER_COLORS + 1];
+		size_t bundleSize = sizeof(ContactConstraintWide) * bundleCount;
+		ContactConstraintWide* bundles = static_cast<ContactConstraintWide*>(AllocateAligned(allocator, bundleSize));
+		std::memset(bundles, 0, bundleSize);
+
+		for (int c = 0; c <= MAX_SOLVER_COLORS; ++c)
+		{
+			int lanes = (c == MAX_SOLVER_COLORS) ? 1 : SIMD_WIDTH;
+			for (int i = colorStart[c]; i < colorStart[c + 1]; ++i)
+			{
+				int offset = i - colorStart[c];
+				ContactConstraintWide* bundle = bundles + bundleStart[c] + offset / lanes;
+				int lane = offset % lanes;
+				bundle->contacts[lane] = coloredContacts[i];
+				coloredContacts[i]->manifold.constraintIndex = i;
+			}
+			for (int b = bundleStart[c]; b < bundleStart[c + 1]; ++b)
+			{
+				for (int lane = 0; lane < SIMD_WIDTH; ++lane)
+				{
+					if (bundles[b].contacts[lane] == nullptr)
+					{
+						bundles[b].indexA[lane] = set.count; // the static body
+						bundles[b].indexB[lane] = set.count;
+					}
+				}
+			}
+		}
+		allocator->deallocate(coloredContacts, sizeof(cContact*) * contactCount);
+
+#if CHIORI_PROFILE
+		for (int c = 0; c < MAX_SOLVER_COLORS && colorStart[c + 1] > colorStart[c]; ++c)
+			profile.solverColors += 1;
+		profile.overflowConstraints += colorStart[MAX_SOLVER_COLORS + 1] - colorStart[MAX_SOLVER_COLORS];
+#endif
+
+		int velocityIterations = context->iterations;
+		int positionIterations = context->extraIterations;
+		float h = context->dt;
+		float inv_h = context->inv_dt;
+		float contactHertz = c_min(30.0f, 0.333f * inv_h);
+
+		C_PROFILE_END(timer, profile.prepareConstraints);
+		C_PROFILE(timer.reset());
+
+		IntegrateVelocities(world, &set, h);
+
+		C_PROFILE_END(timer, profile.integrateVelocities);
+		C_PROFILE(timer.reset());
+
+		ForEachRange(taskSystem, bundles, bundleCount,
+			[&](ContactConstraintWide* range, int count) { PrepareSoftContactsWide(world, &set, context, range, count, h, contactHertz); });
+
+		C_PROFILE_END(timer, profile.prepareContacts);
+		C_PROFILE(timer.reset());
+
+		if (context->warmStart)
+		{
+			SolveColors(taskSystem, bundles, bundleStart,
+				[&](ContactConstraintWide* range, int count) { WarmStartContactsWide(&set, range, count); });
+		}
+
+		C_PROFILE_END(timer, profile.warmStart);
+
+		bool useBias = true;
+		auto solve = [&](ContactConstraintWide* range, int count) { PGSSoftContactSolverWide(&set, range, count, inv_h, useBias); };
+		for (int iter = 0; iter < velocityIterations; ++iter)
+		{
+			C_PROFILE(timer.reset());
+			SolveColors(taskSystem, bundles, bundleStart, solve);
+			C_PROFILE(RecordSolverPass(profile, timer));
+		}
+
+		C_PROFILE(timer.reset());
+
+		IntegratePositions(&set, h);
+
+		C_PROFILE_END(timer, profile.integratePositions);
+
+		// Relax
+		useBias = false;
+		for (int iter = 0; iter < positionIterations; ++iter)
+		{
+			C_PROFILE(timer.reset());
+			SolveColors(taskSystem, bundles, bundleStart, solve);
+			C_PROFILE(RecordSolverPass(profile, timer));
+		}
+
+		C_PROFILE(timer.reset());
+
+		WriteBackSolverBodies(&set);
+
+		C_PROFILE_END(timer, profile.integratePositions);
+		C_PROFILE(timer.reset());
+
+		ForEachRange(taskSystem, bundles, bundleCount,
+			[](ContactConstraintWide* range, int count) { StoreContactImpulsesWide(range, count); });
+
+		C_PROFILE_END(timer, profile.storeImpulses);
+
+		DeallocateAligned(allocator, bundles, bundleSize);
+		DestroySolverBodies(world, &set);
+	}
+}
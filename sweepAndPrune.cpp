@@ -0,0 +1,221 @@
+#include "pch.h"
+#include "sweepAndPrune.h"
+
+namespace chiori
+{
+	cSweepAndPrune::cSweepAndPrune()
+	{
+		m_proxyCapacity = 16;
+		m_proxyCount = 0;
+		m_proxies = new cSAPProxy[m_proxyCapacity];
+
+		// Build a linked list for the free list.
+		for (int i = 0; i < m_proxyCapacity - 1; ++i)
+			m_proxies[i].next = i + 1;
+		m_proxies[m_proxyCapacity - 1].next = null_node;
+		m_freeList = 0;
+
+		m_entries = new cSAPEntry[m_proxyCapacity];
+		m_entryCount = 0;
+		m_removedCount = 0;
+
+		m_maxWidth = 0.0f;
+		m_aabbMargin = commons::AABB_FATTEN_FACTOR;
+		m_sorted = true;
+	}
+
+	cSweepAndPrune::~cSweepAndPrune()
+	{
+		delete[] m_entries;
+		delete[] m_proxies;
+	}
+
+	int cSweepAndPrune::InsertProxy(const cAABB& aabb, void* userData)
+	{
+		if (m_freeList == null_node)
+		{
+			// every proxy is in use, so there are no removed entries to copy
+			cassert(m_proxyCount == m_proxyCapacity && m_removedCount == 0);
+
+			cSAPProxy* oldProxies = m_proxies;
+			cSAPEntry* oldEntries = m_entries;
+			m_proxyCapacity *= 2;
+			m_proxies = new cSAPProxy[m_proxyCapacity];
+			m_entries = new cSAPEntry[m_proxyCapacity];
+			std::copy(oldProxies, oldProxies + m_proxyCount, m_proxies);
+			std::copy(oldEntries, oldEntries + m_entryCount, m_entries);
+			delete[] oldProxies;
+			delete[] oldEntries;
+
+			for (int i = m_proxyCount; i < m_proxyCapacity - 1; ++i)
+				m_proxies[i].next = i + 1;
+			m_proxies[m_proxyCapacity - 1].next = null_node;
+			m_freeList = m_proxyCount;
+		}
+
+		int proxyID = m_freeList;
+		cSAPProxy* proxy = m_proxies + proxyID;
+		m_freeList = proxy->next;
+		++m_proxyCount;
+
+		// The removed entries keep their slot until the next Sort, compact them when the array is full
+		if (m_entryCount == m_proxyCapacity)
+			Sort();
+
+		cVec2 fat{ m_aabbMargin, m_aabbMargin };
+		proxy->aabb.min = aabb.min - fat;
+		proxy->aabb.max = aabb.max + fat;
+		proxy->userData = userData;
+		proxy->entry = m_entryCount;
+
+		m_entries[m_entryCount] = { proxy->aabb, proxyID };
+		++m_entryCount;
+		m_maxWidth = c_max(m_maxWidth, proxy->aabb.max.x - proxy->aabb.min.x);
+		CheckOrder(proxy->entry);
+
+		return proxyID;
+	}
+
+	void cSweepAndPrune::DestroyProxy(int proxyID)
+	{
+		cassert(0 <= proxyID && proxyID < m_proxyCapacity);
+		cassert(0 < m_proxyCount);
+
+		// The entry keeps its place in the order until the next Sort removes it
+		cSAPProxy* proxy = m_proxies + proxyID;
+		m_entries[proxy->entry].proxyID = null_node;
+		++m_removedCount;
+
+		proxy->userData = nullptr;
+		proxy->next = m_freeList;
+		m_freeList = proxyID;
+		--m_proxyCount;
+	}
+
+	bool cSweepAndPrune::MoveProxy(int proxyID, const cAABB& aabb, const cVec2& disp)
+	{
+		cassert(0 <= proxyID && proxyID < m_proxyCapacity);
+
+		// The same fat AABB as cDynamicTree::MoveProxy, with the margin and the predicted displacement
+		cVec2 fat{ m_aabbMargin, m_aabbMargin };
+		cAABB b = aabb;
+		b.min = b.min - fat;
+		b.max = b.max + fat;
+
+		cVec2 pdisp = disp * CTREE_DISPLACEMENT_MULTIPLIER;
+
+		if (pdisp.x < 0.0f)
+		{
+			b.min.x += pdisp.x;
+		}
+		else
+		{
+			b.max.x += pdisp.x;
+		}
+
+		if (pdisp.y < 0.0f)
+		{
+			b.min.y += pdisp.y;
+		}
+		else
+		{
+			b.max.y += pdisp.y;
+		}
+
+		cSAPProxy* proxy = m_proxies + proxyID;
+		if (proxy->aabb.contains(aabb))
+		{
+			cVec2 huge = fat * CTREE_HUGE_MARGIN_MULTIPLIER;
+			cAABB hugeAABB;
+			hugeAABB.min = b.min - huge;
+			hugeAABB.max = b.max + huge;
+			if (hugeAABB.contains(proxy->aabb))
+			{
+				return false;
+			}
+		}
+
+		proxy->aabb = b;
+		m_entries[proxy->entry].aabb = b;
+		m_maxWidth = c_max(m_maxWidth, b.max.x - b.min.x);
+		CheckOrder(proxy->entry);
+		return true;
+	}
+
+	void cSweepAndPrune::CheckOrder(int entry)
+	{
+		if (!m_sorted)
+			return;
+
+		float minX = m_entries[entry].aabb.min.x;
+		if ((entry > 0 && m_entries[entry - 1].aabb.min.x > minX) ||
+			(entry + 1 < m_entryCount && minX > m_entries[entry + 1].aabb.min.x))
+		{
+			m_sorted = false;
+		}
+	}
+
+	void cSweepAndPrune::Sort()
+	{
+		if (m_sorted && m_removedCount == 0)
+			return;
+
+		// Remove the destroyed entries
+		if (m_removedCount > 0)
+		{
+			int count = 0;
+			for (int i = 0; i < m_entryCount; ++i)
+			{
+				if (m_entries[i].proxyID != null_node)
+					m_entries[count++] = m_entries[i];
+			}
+			m_entryCount = count;
+			m_removedCount = 0;
+		}
+
+		// Insertion sort, the entries are nearly sorted already so most of them do not move.
+		// The widest AABB is measured on the way, it only grows between sorts
+		m_maxWidth = 0.0f;
+		for (int i = 0; i < m_entryCount; ++i)
+		{
+			cSAPEntry entry = m_entries[i];
+			m_maxWidth = c_max(m_maxWidth, entry.aabb.max.x - entry.aabb.min.x);
+
+			int j = i - 1;
+			while (j >= 0 && m_entries[j].aabb.min.x > entry.aabb.min.x)
+			{
+				m_entries[j + 1] = m_entries[j];
+				--j;
+			}
+			m_entries[j + 1] = entry;
+		}
+
+		for (int i = 0; i < m_entryCount; ++i)
+			m_proxies[m_entries[i].proxyID].entry = i;
+
+		m_sorted = true;
+	}
+
+	int cSweepAndPrune::LowerBound(float minX) const
+	{
+		float start = minX - m_maxWidth;
+		const cSAPEntry* first = std::lower_bound(m_entries, m_entries + m_entryCount, start,
+			[](const cSAPEntry& entry, float x) { return entry.aabb.min.x < x; });
+		return static_cast<int>(first - m_entries);
+	}
+
+	void cSweepAndPrune::ShiftOrigin(const cVec2& newOrigin)
+	{
+		for (int i = 0; i < m_entryCount; ++i)
+		{
+			m_entries[i].aabb.min -= newOrigin;
+			m_entries[i].aabb.max -= newOrigin;
+		}
+
+		for (int i = 0; i < m_proxyCapacity; ++i)
+		{
+			m_proxies[i].aabb.min -= newOrigin;
+			m_proxies[i].aabb.max -= newOrigin;
+		}
+	}
+}
@@ -0,0 +1,224 @@
+#pragma once
+
+#include "aabbtree.h"
+
+namespace chiori
+{
+	// An entry of the sorted proxy array, the fat AABB is copied next to the proxy id so that sweeps read one contiguous array
+	struct cSAPEntry
+	{
+		cAABB aabb;
+		int proxyID; // null_node for an entry removed since the last Sort
+	};
+
+	struct cSAPProxy
+	{
+		cAABB aabb;					// the fat AABB
+		void* userData{ nullptr };
+		union
+		{
+			int entry;				// the index of the proxy in the sorted entries
+			int next;				// the next free proxy
+		};
+	};
+
+	/*
+	* Sweep and prune along the x axis. The proxies are kept in an array sorted by the min x of their fat AABB,
+	* the order persists between steps and Sort restores it with an insertion sort, which is close to linear when the
+	* proxies move coherently. Overlapping pairs are found by sweeping the sorted array instead of querying per proxy.
+	* It has the proxy interface of cDynamicTree (fat AABBs, MoveProxy, Query, casts) so that cBroadphase can use it
+	* in place of the dynamic tree
+	*/
+	class cSweepAndPrune
+	{
+	public:
+		cSweepAndPrune();
+		~cSweepAndPrune();
+
+		cSweepAndPrune(const cSweepAndPrune&) = delete;
+		cSweepAndPrune& operator=(const cSweepAndPrune&) = delete;
+
+		int InsertProxy(const cAABB& inAABB, void* inUserData);
+		void DestroyProxy(int inProxyID);
+		// see cDynamicTree::MoveProxy, returns true if the fat AABB was updated
+		bool MoveProxy(int inProxyID, const cAABB& inAABB, const cVec2& inDisplacement);
+
+		void SetAABBMargin(float inMargin) { m_aabbMargin = inMargin; }
+		float GetAABBMargin() const { return m_aabbMargin; }
+
+		void* GetUserData(int inProxyID) const;
+		const cAABB& GetFattenedAABB(int inProxyID) const;
+
+		int GetProxyCapacity() const { return m_proxyCapacity; } // every proxy id is below this
+		int GetProxyCount() const { return m_proxyCount; }
+
+		// Removes the destroyed entries and restores the order of the moved and inserted ones.
+		// Queries on an unsorted array fall back to testing every proxy
+		void Sort();
+		bool IsSorted() const { return m_sorted; }
+
+		int GetEntryCount() const { return m_entryCount; }
+		const cSAPEntry* GetEntries() const { return m_entries; }
+
+		// Calls callback(proxyIDA, proxyIDB) for every overlapping pair whose first proxy is in the sorted entries [begin, end),
+		// every pair is reported once over [0, GetEntryCount()). The array must be sorted
+		template <typename T>
+		void FindPairs(int begin, int end, T&& callback) const;
+
+		// see cDynamicTree::Query, cDynamicTree::RayCast, cDynamicTree::BoxCast and cDynamicTree::RayCastPacket.
+		// The casts test every proxy in the x range of the swept bounds, the packet casts its rays one at a time
+		template <typename T>
+		void Query(const cAABB& inAABB, T&& callback) const;
+		template <typename T>
+		void RayCast(const cRayCastInput& inInput, T&& callback) const;
+		template <typename T>
+		void BoxCast(const cAABB& inAABB, const cRayCastInput& inInput, T&& callback) const;
+		template <typename T>
+		void RayCastPacket(const cRayCastInput* inInputs, int inCount, T&& callback) const;
+
+		// The shift formula is: position -= newOrigin
+		void ShiftOrigin(const cVec2& newOrigin);
+
+	private:
+		// the first sorted entry that can overlap an AABB starting at inMinX
+		int LowerBound(float inMinX) const;
+
+		// updates m_sorted after the entry at inEntry changed its min x
+		void CheckOrder(int inEntry);
+
+		template <typename T>
+		void CastAABB(const cRayCastInput& inInput, const cVec2& inExtents, T&& callback) const;
+
+		cSAPProxy* m_proxies;
+		int m_proxyCapacity;
+		int m_proxyCount;
+		int m_freeList;
+
+		cSAPEntry* m_entries;		// m_proxyCapacity long, includes the removed entries until the next Sort
+		int m_entryCount;
+		int m_removedCount;
+
+		float m_maxWidth;			// the widest fat AABB along x, no entry before LowerBound(x) reaches past x
+		float m_aabbMargin;
+		bool m_sorted;
+	};
+
+	inline void* cSweepAndPrune::GetUserData(int proxyID) const
+	{
+		if (0 <= proxyID && proxyID < m_proxyCapacity)
+		{
+			return m_proxies[proxyID].userData;
+		}
+		throw std::out_of_range("Index out of range for sweep and prune");
+	}
+
+	inline const cAABB& cSweepAndPrune::GetFattenedAABB(int proxyID) const
+	{
+		if (0 <= proxyID && proxyID < m_proxyCapacity)
+		{
+			return m_proxies[proxyID].aabb;
+		}
+		throw std::out_of_range("Index out of range for sweep and prune");
+	}
+
+	template <typename T>
+	inline void cSweepAndPrune::FindPairs(int begin, int end, T&& callback) const
+	{
+		cassert(m_sorted);
+		for (int i = begin; i < end; ++i)
+		{
+			const cSAPEntry& entry = m_entries[i];
+			if (entry.proxyID == null_node)
+				continue;
+
+			// the entries after i start at or after entry, they stop overlapping it along x once they start past its max
+			for (int j = i + 1; j < m_entryCount && m_entries[j].aabb.min.x < entry.aabb.max.x; ++j)
+			{
+				const cSAPEntry& other = m_entries[j];
+				if (other.proxyID != null_node && entry.aabb.intersects(other.aabb))
+					callback(entry.proxyID, other.proxyID);
+			}
+		}
+	}
+
+	template <typename T>
+	inline void cSweepAndPrune::Query(const cAABB& inAABB, T&& callback) const
+	{
+		int first = m_sorted ? LowerBound(inAABB.min.x) : 0;
+		for (int i = first; i < m_entryCount; ++i)
+		{
+			const cSAPEntry& entry = m_entries[i];
+			if (m_sorted && entry.aabb.min.x >= inAABB.max.x)
+				return;
+
+			if (entry.proxyID != null_node && inAABB.intersects(entry.aabb))
+			{
+				if (!callback(entry.proxyID))
+					return;
+			}
+		}
+	}
+
+	template <typename T>
+	inline void cSweepAndPrune::RayCast(const cRayCastInput& inInput, T&& callback) const
+	{
+		CastAABB(inInput, cVec2::zero, callback);
+	}
+
+	template <typename T>
+	inline void cSweepAndPrune::BoxCast(const cAABB& inAABB, const cRayCastInput& inInput, T&& callback) const
+	{
+		cRayCastInput centerInput = inInput;
+		centerInput.origin = inAABB.getCenter();
+		CastAABB(centerInput, inAABB.getExtents(), callback);
+	}
+
+	template <typename T>
+	inline void cSweepAndPrune::CastAABB(const cRayCastInput& inInput, const cVec2& inExtents, T&& callback) const
+	{
+		if (inInput.maxFraction <= 0.0f)
+			return;
+
+		cRayCastInput subInput = inInput;
+		cVec2 invTranslation = RayInvTranslation(inInput.translation);
+
+		// the x range of the swept box, a clipped ray keeps scanning the range of its original length
+		cVec2 end = inInput.origin + inInput.maxFraction * inInput.translation;
+		float minX = c_min(inInput.origin.x, end.x) - inExtents.x;
+		float maxX = c_max(inInput.origin.x, end.x) + inExtents.x;
+
+		int first = m_sorted ? LowerBound(minX) : 0;
+		for (int i = first; i < m_entryCount; ++i)
+		{
+			const cSAPEntry& entry = m_entries[i];
+			if (m_sorted && entry.aabb.min.x > maxX)
+				return;
+
+			if (entry.proxyID == null_node)
+				continue;
+
+			cAABB entryAABB{ entry.aabb.min - inExtents, entry.aabb.max + inExtents };
+			if (!RayIntersectsAABB(subInput.origin, invTranslation, subInput.maxFraction, entryAABB))
+				continue;
+
+			float value = callback(static_cast<const cRayCastInput&>(subInput), entry.proxyID);
+			if (value == 0.0f)
+				return; // the client has terminated the ray cast
+
+			if (0.0f < value && value < subInput.maxFraction)
+				subInput.maxFraction = value; // the client found a closer hit, skip everything past it
+		}
+	}
+
+	template <typename T>
+	inline void cSweepAndPrune::RayCastPacket(const cRayCastInput* inInputs, int inCount, T&& callback) const
+	{
+		cassert(0 <= inCount && inCount <= CTREE_RAY_PACKET_SIZE);
+		for (int i = 0; i < inCount; ++i)
+		{
+			CastAABB(inInputs[i], cVec2::zero, [&callback, i](const cRayCastInput& subInput, int proxyID) -> float {
+				return callback(subInput, i, proxyID);
+				});
+		}
+	}
+}
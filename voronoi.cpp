@@ -480,7 +480,7 @@ namespace chiori
 		float extensionFactor = bounds.getExtents().sqrMagnitude() + 1; // we add 1 to avoid any `on the edge` issues for bounds with a sqrmag of 1 or 0
 		std::vector<std::vector<cVec2>> clippedPolys;
 
-		auto& cells = inPattern.getCells();
+		std::vector<cVCell> cells = inPattern.getCells();
 		std::vector<std::vector<cVec2>> polys;
 		for (auto& cell : cells)
 		{
@@ -0,0 +1,117 @@
+#include "pch.h"
+#include "wideTree.h"
+
+namespace chiori
+{
+	cWideTree::cWideTree()
+	{
+		m_nodes = nullptr;
+		m_nodeCount = 0;
+		m_nodeCapacity = 0;
+		m_root = null_node;
+		m_source = nullptr;
+		m_version = 0;
+	}
+
+	cWideTree::~cWideTree()
+	{
+		delete[] m_nodes;
+	}
+
+	void cWideTree::Build(const cDynamicTree& tree)
+	{
+		m_source = &tree;
+		m_version = tree.GetVersion();
+		m_nodeCount = 0;
+		m_root = null_node;
+
+		int treeRoot = tree.GetRoot();
+		if (treeRoot == null_node)
+			return;
+
+		// every wide node replaces at least one internal node, a single leaf gets a node of its own
+		if (m_nodeCapacity < tree.GetProxyCapacity())
+		{
+			delete[] m_nodes;
+			m_nodeCapacity = tree.GetProxyCapacity();
+			m_nodes = new cWideNode[m_nodeCapacity];
+		}
+
+		// every entry is a wide node to fill and the binary node it replaces
+		cTreeStack<2 * CTREE_STACK_SIZE> stack;
+
+		m_root = m_nodeCount++;
+		stack.push(treeRoot);
+		stack.push(m_root);
+		while (!stack.empty())
+		{
+			int wideNodeID = stack.pop();
+			int treeNodeID = stack.pop();
+
+			// Collapse the binary nodes below: open the internal child with the largest perimeter until the node is full
+			int children[CWIDE_TREE_WIDTH];
+			int childCount = 0;
+			const cTreeNode& treeNode = tree.GetNode(treeNodeID);
+			if (treeNode.IsLeaf())
+			{
+				children[childCount++] = treeNodeID;
+			}
+			else
+			{
+				children[childCount++] = treeNode.child1;
+				children[childCount++] = treeNode.child2;
+			}
+
+			while (childCount < CWIDE_TREE_WIDTH)
+			{
+				int best = -1;
+				float bestPerimeter = -1.0f;
+				for (int i = 0; i < childCount; ++i)
+				{
+					const cTreeNode& child = tree.GetNode(children[i]);
+					if (!child.IsLeaf() && child.aabb.perimeter() > bestPerimeter)
+					{
+						best = i;
+						bestPerimeter = child.aabb.perimeter();
+					}
+				}
+				if (best < 0)
+					break;
+
+				const cTreeNode& opened = tree.GetNode(children[best]);
+				children[best] = opened.child1;
+				children[childCount++] = opened.child2;
+			}
+
+			cWideNode* node = m_nodes + wideNodeID;
+			node->childCount = childCount;
+			for (int i = 0; i < CWIDE_TREE_WIDTH; ++i)
+			{
+				if (i >= childCount)
+				{
+					// unused lanes are masked out by childCount, they only need to hold valid floats
+					node->minX[i] = node->minY[i] = node->maxX[i] = node->maxY[i] = 0.0f;
+					node->children[i] = null_node;
+					continue;
+				}
+
+				const cTreeNode& child = tree.GetNode(children[i]);
+				node->minX[i] = child.aabb.min.x;
+				node->minY[i] = child.aabb.min.y;
+				node->maxX[i] = child.aabb.max.x;
+				node->maxY[i] = child.aabb.max.y;
+				if (child.IsLeaf())
+				{
+					node->children[i] = EncodeLeaf(children[i]);
+				}
+				else
+				{
+					cassert(m_nodeCount < m_nodeCapacity);
+					node->children[i] = m_nodeCount++;
+					stack.push(children[i]);
+					stack.push(node->children[i]);
+				}
+			}
+		}
+	}
+}
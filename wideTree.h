@@ -0,0 +1,172 @@
+#pragma once
+
+#include "aabbtree.h"
+
+namespace chiori
+{
+	#define CWIDE_TREE_WIDTH SIMD_WIDTH // children per node, a quad tree with SSE2 and an 8-wide tree with AVX2
+
+	// The child AABBs of a wide node in SoA form, one SIMD compare tests all of them. The children fill the lanes [0, childCount)
+	struct alignas(SIMD_ALIGNMENT) cWideNode
+	{
+		float minX[CWIDE_TREE_WIDTH];
+		float minY[CWIDE_TREE_WIDTH];
+		float maxX[CWIDE_TREE_WIDTH];
+		float maxY[CWIDE_TREE_WIDTH];
+		int children[CWIDE_TREE_WIDTH];	// a wide node index, or a leaf encoded by EncodeLeaf
+		int childCount;
+	};
+
+	/*
+	* A read-only copy of a cDynamicTree collapsed into CWIDE_TREE_WIDTH-wide nodes. Every wide node takes the place of
+	* a binary node and the binary nodes below it, down to CWIDE_TREE_WIDTH children, so a traversal visits fewer nodes
+	* and tests all the children of a node at once. Build copies the tree, the copy is stale as soon as the tree changes.
+	* The queries call back with the proxy ids of the binary tree, in a different order than cDynamicTree
+	*/
+	class cWideTree
+	{
+	public:
+		cWideTree();
+		~cWideTree();
+
+		cWideTree(const cWideTree&) = delete;
+		cWideTree& operator=(const cWideTree&) = delete;
+
+		void Build(const cDynamicTree& inTree);
+		// true if the tree has not changed since it was built into this
+		bool IsBuiltFrom(const cDynamicTree& inTree) const { return m_source == &inTree && m_version == inTree.GetVersion(); }
+
+		int GetNodeCount() const { return m_nodeCount; }
+
+		// see cDynamicTree::Query, cDynamicTree::RayCast and cDynamicTree::BoxCast
+		template <typename T>
+		void Query(const cAABB& inAABB, T&& callback) const;
+		template <typename T>
+		void RayCast(const cRayCastInput& inInput, T&& callback) const;
+		template <typename T>
+		void BoxCast(const cAABB& inAABB, const cRayCastInput& inInput, T&& callback) const;
+
+	private:
+		// leaves are stored as negative children, null_node (-1) is left out
+		static int EncodeLeaf(int inProxyID) { return -inProxyID - 2; }
+		static int DecodeLeaf(int inChild) { return -inChild - 2; }
+		static bool IsLeafChild(int inChild) { return inChild < null_node; }
+
+		template <typename T>
+		void CastAABB(const cRayCastInput& inInput, const cVec2& inExtents, T&& callback) const;
+
+		cWideNode* m_nodes;
+		int m_nodeCount;
+		int m_nodeCapacity;
+		int m_root;
+
+		const cDynamicTree* m_source;
+		unsigned m_version;			// the version of m_source when it was built
+	};
+
+	template <typename T>
+	inline void cWideTree::Query(const cAABB& inAABB, T&& callback) const
+	{
+		if (m_root == null_node)
+			return;
+
+		cFloatW queryMinX = wSplat(inAABB.min.x), queryMinY = wSplat(inAABB.min.y);
+		cFloatW queryMaxX = wSplat(inAABB.max.x), queryMaxY = wSplat(inAABB.max.y);
+		cFloatW zero = wZero();
+
+		cTreeStack<CTREE_STACK_SIZE> stack;
+		stack.push(m_root);
+		while (!stack.empty())
+		{
+			const cWideNode* node = m_nodes + stack.pop();
+
+			// the largest gap between the boxes along either axis, they overlap when it is negative like cAABB::intersects
+			cFloatW gapX = wMax(wLoad(node->minX) - queryMaxX, queryMinX - wLoad(node->maxX));
+			cFloatW gapY = wMax(wLoad(node->minY) - queryMaxY, queryMinY - wLoad(node->maxY));
+			unsigned hits = static_cast<unsigned>(wMoveMask(wGreater(zero, wMax(gapX, gapY))));
+			hits &= (1u << node->childCount) - 1u;
+
+			for (int i = 0; hits != 0; ++i, hits >>= 1)
+			{
+				if ((hits & 1u) == 0)
+					continue;
+
+				int child = node->children[i];
+				if (IsLeafChild(child))
+				{
+					if (!callback(DecodeLeaf(child)))
+						return;
+				}
+				else
+				{
+					stack.push(child);
+				}
+			}
+		}
+	}
+
+	template <typename T>
+	inline void cWideTree::RayCast(const cRayCastInput& inInput, T&& callback) const
+	{
+		CastAABB(inInput, cVec2::zero, callback);
+	}
+
+	template <typename T>
+	inline void cWideTree::BoxCast(const cAABB& inAABB, const cRayCastInput& inInput, T&& callback) const
+	{
+		cRayCastInput centerInput = inInput;
+		centerInput.origin = inAABB.getCenter();
+		CastAABB(centerInput, inAABB.getExtents(), callback);
+	}
+
+	template <typename T>
+	inline void cWideTree::CastAABB(const cRayCastInput& inInput, const cVec2& inExtents, T&& callback) const
+	{
+		if (m_root == null_node)
+			return;
+
+		cRayCastInput subInput = inInput;
+		cVec2 invTranslation = RayInvTranslation(inInput.translation);
+
+		// the slab test of RayIntersectsAABB on all the children of a node
+		cFloatW originX = wSplat(inInput.origin.x), originY = wSplat(inInput.origin.y);
+		cFloatW invX = wSplat(invTranslation.x), invY = wSplat(invTranslation.y);
+		cFloatW extentX = wSplat(inExtents.x), extentY = wSplat(inExtents.y);
+		cFloatW zero = wZero();
+
+		cTreeStack<CTREE_STACK_SIZE> stack;
+		stack.push(m_root);
+		while (!stack.empty())
+		{
+			const cWideNode* node = m_nodes + stack.pop();
+
+			cFloatW t1x = (wLoad(node->minX) - extentX - originX) * invX, t2x = (wLoad(node->maxX) + extentX - originX) * invX;
+			cFloatW t1y = (wLoad(node->minY) - extentY - originY) * invY, t2y = (wLoad(node->maxY) + extentY - originY) * invY;
+			cFloatW tNear = wMax(wMax(wMin(t1x, t2x), wMin(t1y, t2y)), zero);
+			cFloatW tFar = wMin(wMin(wMax(t1x, t2x), wMax(t1y, t2y)), wSplat(subInput.maxFraction));
+			unsigned hits = ~static_cast<unsigned>(wMoveMask(wGreater(tNear, tFar)));
+			hits &= (1u << node->childCount) - 1u;
+
+			// the children are pushed last to first so that they are visited in lane order
+			for (int i = node->childCount - 1; i >= 0; --i)
+			{
+				if ((hits & (1u << i)) == 0)
+					continue;
+
+				int child = node->children[i];
+				if (!IsLeafChild(child))
+				{
+					stack.push(child);
+					continue;
+				}
+
+				float value = callback(static_cast<const cRayCastInput&>(subInput), DecodeLeaf(child));
+				if (value == 0.0f)
+					return; // the client has terminated the ray cast
+
+				if (0.0f < value && value < subInput.maxFraction)
+					subInput.maxFraction = value; // the client found a closer hit, skip everything past it
+			}
+		}
+	}
+}